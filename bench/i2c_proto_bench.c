@@ -0,0 +1,329 @@
+#include "i2c_proto_bench.h"
+#include "module_i2c_proto.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+
+static inline uint64_t bench_now(void)
+{
+    return esp_cpu_get_cycle_count(); // Only differences are used, 32-bit wrap is fine for short cases
+}
+#else
+#include <time.h>
+
+static inline uint64_t bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#define BENCH_BATCH_PARAMS I2C_PROTO_BATCH_MAX_PARAMS
+
+// Keeps results observable so the timed loops are not optimized away
+static volatile uint32_t s_sink;
+
+// Makes the compiler assume s_frame changed, so work on it is not hoisted out
+// of a loop once the helpers are inlined (CONFIG_I2C_PROTO_INLINE_HELPERS)
+#define BENCH_CLOBBER() __asm__ volatile("" ::: "memory")
+
+static uint8_t s_frame[I2C_PROTO_MAX_FRAME_LEN];
+static size_t s_frame_len;
+static SetParamPayload_t s_params[BENCH_BATCH_PARAMS];
+
+// Values valid for every parameter in the table
+static inline ParamValue_t bench_value(uint32_t i)
+{
+    ParamValue_t v = {.u32 = i & 0x7F};
+    return v;
+}
+
+static void fill_params(uint32_t seed)
+{
+    for (size_t i = 0; i < BENCH_BATCH_PARAMS; i++)
+    {
+        s_params[i].param_id = i2c_proto_param_descriptors[i % I2C_PROTO_PARAM_COUNT].id;
+        s_params[i].param_value = bench_value(seed + (uint32_t)i);
+    }
+}
+
+static uint32_t run_pack_set_param(uint32_t n)
+{
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        acc += (uint32_t)i2c_proto_pack_set_param_msg(s_frame, sizeof(s_frame), PARAM_OSC_LEVEL_U16, bench_value(i));
+    }
+    s_sink = acc;
+    return 1 + sizeof(SetParamPayload_t);
+}
+
+static uint32_t run_unpack_set_param(uint32_t n)
+{
+    i2c_proto_pack_set_param_msg(s_frame, sizeof(s_frame), PARAM_OSC_LEVEL_U16, bench_value(1));
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        ParamId_t id;
+        ParamValue_t v;
+        BENCH_CLOBBER();
+        i2c_proto_unpack_set_param_payload(s_frame + 1, sizeof(SetParamPayload_t), &id, &v);
+        acc += id + v.u32;
+    }
+    s_sink = acc;
+    return sizeof(SetParamPayload_t);
+}
+
+static uint32_t run_pack_i2s_config(uint32_t n)
+{
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const I2sConfig_t config = {.tdm_slot_in = (uint8_t)i, .tdm_slot_out = (uint8_t)(i + 1)};
+        acc += (uint32_t)i2c_proto_pack_i2s_config_msg(s_frame, sizeof(s_frame), &config);
+    }
+    s_sink = acc;
+    return 1 + sizeof(I2sConfig_t);
+}
+
+static uint32_t run_unpack_i2s_config(uint32_t n)
+{
+    const I2sConfig_t src = {.tdm_slot_in = 2, .tdm_slot_out = 3};
+    i2c_proto_pack_i2s_config_msg(s_frame, sizeof(s_frame), &src);
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        I2sConfig_t config;
+        BENCH_CLOBBER();
+        i2c_proto_unpack_i2s_config_payload(s_frame + 1, sizeof(I2sConfig_t), &config);
+        acc += config.tdm_slot_in + config.tdm_slot_out;
+    }
+    s_sink = acc;
+    return sizeof(I2sConfig_t);
+}
+
+static uint32_t run_pack_batch(uint32_t n)
+{
+    fill_params(0);
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        acc += (uint32_t)i2c_proto_pack_set_param_batch(s_frame, sizeof(s_frame), s_params, BENCH_BATCH_PARAMS);
+    }
+    s_sink = acc;
+    return 2 + BENCH_BATCH_PARAMS * I2C_PROTO_BATCH_ENTRY_LEN;
+}
+
+static uint32_t run_iter_batch(uint32_t n)
+{
+    fill_params(0);
+    s_frame_len = i2c_proto_pack_set_param_batch(s_frame, sizeof(s_frame), s_params, BENCH_BATCH_PARAMS);
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        i2c_proto_batch_iter_t iter;
+        ParamId_t id;
+        ParamValue_t v;
+        BENCH_CLOBBER();
+        i2c_proto_batch_iter_init(&iter, s_frame + 1, s_frame_len - 1);
+        while (i2c_proto_batch_iter_next(&iter, &id, &v))
+        {
+            acc += id + v.u32;
+        }
+    }
+    s_sink = acc;
+    return (uint32_t)s_frame_len - 1;
+}
+
+static uint32_t run_pack_compact(uint32_t n)
+{
+    fill_params(0);
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        acc += (uint32_t)i2c_proto_pack_set_param_compact(s_frame, sizeof(s_frame), s_params, BENCH_BATCH_PARAMS);
+    }
+    s_sink = acc;
+    return (uint32_t)i2c_proto_pack_set_param_compact(s_frame, sizeof(s_frame), s_params, BENCH_BATCH_PARAMS);
+}
+
+static uint32_t run_iter_compact(uint32_t n)
+{
+    fill_params(0);
+    s_frame_len = i2c_proto_pack_set_param_compact(s_frame, sizeof(s_frame), s_params, BENCH_BATCH_PARAMS);
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        i2c_proto_batch_iter_t iter;
+        ParamId_t id;
+        ParamValue_t v;
+        BENCH_CLOBBER();
+        i2c_proto_compact_iter_init(&iter, s_frame + 1, s_frame_len - 1);
+        while (i2c_proto_compact_iter_next(&iter, &id, &v))
+        {
+            acc += id + v.u32;
+        }
+    }
+    s_sink = acc;
+    return (uint32_t)s_frame_len - 1;
+}
+
+// Time process_command on whatever is in s_frame
+static uint32_t run_process_frame(uint32_t n, bool deferred)
+{
+    module_i2c_proto_config_t config = MODULE_I2C_PROTO_CONFIG_DEFAULT(MODULE_TYPE_OSCILLATOR, 0x20);
+    config.deferred_apply = deferred;
+    module_i2c_proto_init_with_config(&config);
+
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        acc += (uint32_t)module_i2c_proto_process_command(s_frame, s_frame_len, NULL, NULL);
+        if (deferred)
+        {
+            acc += (uint32_t)module_i2c_proto_apply_pending();
+        }
+    }
+    s_sink = acc;
+    return (uint32_t)s_frame_len;
+}
+
+static uint32_t run_process_set_param(uint32_t n)
+{
+    s_frame_len = i2c_proto_pack_set_param_msg(s_frame, sizeof(s_frame), PARAM_OSC_LEVEL_U16, bench_value(9));
+    return run_process_frame(n, false);
+}
+
+static uint32_t run_process_batch(uint32_t n)
+{
+    fill_params(0);
+    s_frame_len = i2c_proto_pack_set_param_batch(s_frame, sizeof(s_frame), s_params, BENCH_BATCH_PARAMS);
+    return run_process_frame(n, false);
+}
+
+static uint32_t run_process_compact(uint32_t n)
+{
+    fill_params(0);
+    s_frame_len = i2c_proto_pack_set_param_compact(s_frame, sizeof(s_frame), s_params, BENCH_BATCH_PARAMS);
+    return run_process_frame(n, false);
+}
+
+static uint32_t run_process_batch_deferred(uint32_t n)
+{
+    fill_params(0);
+    s_frame_len = i2c_proto_pack_set_param_batch(s_frame, sizeof(s_frame), s_params, BENCH_BATCH_PARAMS);
+    return run_process_frame(n, true);
+}
+
+typedef struct {
+    const char *name;
+    uint32_t msgs_per_iter;
+    uint32_t (*run)(uint32_t iterations); // Returns wire bytes per call
+} bench_case_t;
+
+static const bench_case_t s_cases[] = {
+    {"pack_set_param", 1, run_pack_set_param},
+    {"unpack_set_param", 1, run_unpack_set_param},
+    {"pack_i2s_config", 1, run_pack_i2s_config},
+    {"unpack_i2s_config", 1, run_unpack_i2s_config},
+    {"pack_batch", BENCH_BATCH_PARAMS, run_pack_batch},
+    {"iter_batch", BENCH_BATCH_PARAMS, run_iter_batch},
+    {"pack_compact", BENCH_BATCH_PARAMS, run_pack_compact},
+    {"iter_compact", BENCH_BATCH_PARAMS, run_iter_compact},
+    {"process_set_param", 1, run_process_set_param},
+    {"process_batch", BENCH_BATCH_PARAMS, run_process_batch},
+    {"process_compact", BENCH_BATCH_PARAMS, run_process_compact},
+    {"process_batch_deferred", BENCH_BATCH_PARAMS, run_process_batch_deferred},
+};
+
+_Static_assert(sizeof(s_cases) / sizeof(s_cases[0]) <= I2C_PROTO_BENCH_MAX_RESULTS, "Raise I2C_PROTO_BENCH_MAX_RESULTS");
+
+size_t i2c_proto_bench_run(i2c_proto_bench_result_t *results, size_t max_results, uint32_t iterations)
+{
+    if (!results || iterations == 0)
+    {
+        return 0;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]) && count < max_results; i++)
+    {
+        const bench_case_t *c = &s_cases[i];
+        c->run(iterations / 16 + 1); // Warm caches and branch predictors
+
+        const uint64_t start = bench_now();
+        const uint32_t bytes = c->run(iterations);
+        const uint64_t end = bench_now();
+
+        results[count++] = (i2c_proto_bench_result_t){
+            .name = c->name,
+            .iterations = iterations,
+            .msgs_per_iter = c->msgs_per_iter,
+            .bytes_per_iter = bytes,
+#ifdef ESP_PLATFORM
+            .ticks = (uint32_t)(end - start), // Cycle counter is 32 bits wide
+#else
+            .ticks = end - start,
+#endif
+        };
+    }
+    return count;
+}
+
+void i2c_proto_bench_print(const i2c_proto_bench_result_t *results, size_t count)
+{
+    const char *unit = i2c_proto_bench_tick_unit();
+    const double tps = (double)i2c_proto_bench_ticks_per_second();
+
+    char per_call_hdr[16];
+    char per_msg_hdr[16];
+    snprintf(per_call_hdr, sizeof(per_call_hdr), "%s/call", unit);
+    snprintf(per_msg_hdr, sizeof(per_msg_hdr), "%s/msg", unit);
+
+    printf("%-24s %12s %12s %14s %14s\n", "case", per_call_hdr, per_msg_hdr, "msgs/s", "bytes/s");
+    for (size_t i = 0; i < count; i++)
+    {
+        const i2c_proto_bench_result_t *r = &results[i];
+        const double per_call = (double)r->ticks / r->iterations;
+        const double seconds = (double)r->ticks / tps;
+        const double msgs = (double)r->iterations * r->msgs_per_iter;
+        const double bytes = (double)r->iterations * r->bytes_per_iter;
+        printf("%-24s %12.1f %12.2f %14.0f %14.0f\n", r->name, per_call, per_call / r->msgs_per_iter,
+               seconds > 0 ? msgs / seconds : 0.0, seconds > 0 ? bytes / seconds : 0.0);
+    }
+}
+
+const char *i2c_proto_bench_tick_unit(void)
+{
+#ifdef ESP_PLATFORM
+    return "cycles";
+#else
+    return "ns";
+#endif
+}
+
+uint64_t i2c_proto_bench_ticks_per_second(void)
+{
+#ifdef ESP_PLATFORM
+    return (uint64_t)esp_rom_get_cpu_ticks_per_us() * 1000000ULL;
+#else
+    return 1000000000ULL;
+#endif
+}
+
+#ifndef ESP_PLATFORM
+#include <stdlib.h>
+
+int main(int argc, char **argv)
+{
+    const uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 100000;
+    i2c_proto_bench_result_t results[I2C_PROTO_BENCH_MAX_RESULTS];
+    const size_t count = i2c_proto_bench_run(results, I2C_PROTO_BENCH_MAX_RESULTS, iterations);
+    i2c_proto_bench_print(results, count);
+    return 0;
+}
+#endif
@@ -0,0 +1,57 @@
+#ifndef I2C_PROTO_BENCH_H
+#define I2C_PROTO_BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file i2c_proto_bench.h
+ * @brief Micro-benchmarks for the protocol pack/unpack helpers and process_command
+ *
+ * Builds as an ESP-IDF component (times in CPU cycles from
+ * esp_cpu_get_cycle_count()) or as a host executable (times in
+ * nanoseconds). Running the benchmarks re-initializes the slave runtime.
+ */
+
+#define I2C_PROTO_BENCH_MAX_RESULTS   16 /**< Number of benchmark cases */
+
+/**
+ * @brief Outcome of one benchmark case
+ */
+typedef struct {
+    const char *name;           /**< Case name */
+    uint32_t iterations;        /**< Calls timed */
+    uint32_t msgs_per_iter;     /**< Parameter writes (or messages) handled per call */
+    uint32_t bytes_per_iter;    /**< Wire bytes produced or consumed per call */
+    uint64_t ticks;             /**< Total time, see i2c_proto_bench_tick_unit() */
+} i2c_proto_bench_result_t;
+
+/**
+ * @brief Run every benchmark case
+ *
+ * @param[out] results Receives one entry per case
+ * @param max_results Capacity of results (I2C_PROTO_BENCH_MAX_RESULTS covers all cases)
+ * @param iterations Calls to time per case
+ * @return Number of results written
+ */
+size_t i2c_proto_bench_run(i2c_proto_bench_result_t *results, size_t max_results, uint32_t iterations);
+
+/**
+ * @brief Print results as a table of time per message and throughput
+ *
+ * @param results Results from i2c_proto_bench_run()
+ * @param count Number of results
+ */
+void i2c_proto_bench_print(const i2c_proto_bench_result_t *results, size_t count);
+
+/**
+ * @brief Unit of i2c_proto_bench_result_t::ticks ("cycles" on target, "ns" on host)
+ */
+const char *i2c_proto_bench_tick_unit(void);
+
+/**
+ * @brief Number of ticks per second
+ */
+uint64_t i2c_proto_bench_ticks_per_second(void);
+
+#endif /* I2C_PROTO_BENCH_H */
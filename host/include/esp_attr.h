@@ -0,0 +1,16 @@
+#ifndef ESP_ATTR_H
+#define ESP_ATTR_H
+
+/**
+ * @file esp_attr.h
+ * @brief Host stand-in for ESP-IDF's esp_attr.h
+ *
+ * The host has no separate instruction and data RAM, so the placement
+ * attributes expand to nothing.
+ */
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define DMA_ATTR
+
+#endif /* ESP_ATTR_H */
@@ -0,0 +1,29 @@
+#ifndef ESP_ERR_H
+#define ESP_ERR_H
+
+/**
+ * @file esp_err.h
+ * @brief Host stand-in for ESP-IDF's esp_err.h
+ *
+ * Only the error codes the protocol component uses, with the same values as
+ * ESP-IDF so logs read the same on both.
+ */
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK                  0
+#define ESP_FAIL                -1
+
+#define ESP_ERR_NO_MEM          0x101
+#define ESP_ERR_INVALID_ARG     0x102
+#define ESP_ERR_INVALID_STATE   0x103
+#define ESP_ERR_INVALID_SIZE    0x104
+#define ESP_ERR_NOT_FOUND       0x105
+#define ESP_ERR_NOT_SUPPORTED   0x106
+#define ESP_ERR_TIMEOUT         0x107
+#define ESP_ERR_INVALID_RESPONSE 0x108
+#define ESP_ERR_INVALID_CRC     0x109
+
+#endif /* ESP_ERR_H */
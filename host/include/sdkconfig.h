@@ -0,0 +1,12 @@
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+/**
+ * @file sdkconfig.h
+ * @brief Host stand-in for the sdkconfig.h ESP-IDF generates from Kconfig
+ *
+ * Host builds set the component's CONFIG_I2C_PROTO_* options as compile
+ * definitions from host/CMakeLists.txt instead.
+ */
+
+#endif /* SDKCONFIG_H */
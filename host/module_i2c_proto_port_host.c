@@ -0,0 +1,165 @@
+#include "module_i2c_proto_port.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+// Host builds have no GPIO; the attention line is a no-op
+
+esp_err_t i2c_proto_port_attention_init(int gpio)
+{
+    (void)gpio;
+    return ESP_OK;
+}
+
+void i2c_proto_port_attention_set(int gpio, bool asserted)
+{
+    (void)gpio;
+    (void)asserted;
+}
+
+// In-memory stand-in for NVS: staged writes become visible to reads right
+// away, as with nvs_set_blob(), and are kept for the life of the process
+
+#define HOST_NVS_ENTRIES 64
+
+static struct {
+    bool used;
+    uint16_t param_id;
+    uint8_t len;
+    uint8_t value[4];
+} s_nvs[HOST_NVS_ENTRIES];
+
+esp_err_t i2c_proto_port_nvs_write(uint16_t param_id, const void *value, size_t len)
+{
+    if (len > sizeof(s_nvs[0].value))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    for (size_t i = 0; i < HOST_NVS_ENTRIES; i++)
+    {
+        if (!s_nvs[i].used || s_nvs[i].param_id == param_id)
+        {
+            s_nvs[i].used = true;
+            s_nvs[i].param_id = param_id;
+            s_nvs[i].len = (uint8_t)len;
+            memcpy(s_nvs[i].value, value, len);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t i2c_proto_port_nvs_read(uint16_t param_id, void *value, size_t len)
+{
+    for (size_t i = 0; i < HOST_NVS_ENTRIES && s_nvs[i].used; i++)
+    {
+        if (s_nvs[i].param_id == param_id)
+        {
+            if (s_nvs[i].len != len)
+            {
+                return ESP_ERR_NOT_FOUND;
+            }
+            memcpy(value, s_nvs[i].value, len);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t i2c_proto_port_nvs_commit(void)
+{
+    return ESP_OK;
+}
+
+// Worker and dispatch task: detached threads woken through a condition
+// variable. Host threads are not pinned; the dispatch core is only checked.
+
+#define HOST_CORES 2
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool started;
+    unsigned notified;
+    void (*job)(void);
+} host_task_t;
+
+static host_task_t s_worker = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, false, 0, NULL};
+static host_task_t s_dispatch = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, false, 0, NULL};
+
+static void *task_thread(void *arg)
+{
+    host_task_t *task = arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&task->lock);
+        while (task->notified == 0)
+        {
+            pthread_cond_wait(&task->cond, &task->lock);
+        }
+        task->notified = 0;
+        pthread_mutex_unlock(&task->lock);
+        task->job();
+    }
+    return NULL;
+}
+
+static esp_err_t task_start(host_task_t *task, void (*job)(void))
+{
+    if (task->started)
+    {
+        return ESP_OK;
+    }
+    task->job = job;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, task_thread, task) != 0)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_detach(thread);
+    task->started = true;
+    return ESP_OK;
+}
+
+static void task_notify(host_task_t *task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notified++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+}
+
+esp_err_t i2c_proto_port_worker_start(void (*job)(void))
+{
+    return task_start(&s_worker, job);
+}
+
+void i2c_proto_port_worker_notify(void)
+{
+    task_notify(&s_worker);
+}
+
+esp_err_t i2c_proto_port_dispatch_start(int core, void (*job)(void))
+{
+    if (core < 0 || core >= HOST_CORES)
+    {
+        return ESP_ERR_INVALID_ARG; // Error: No such core
+    }
+    return task_start(&s_dispatch, job);
+}
+
+void i2c_proto_port_dispatch_notify(void)
+{
+    if (s_dispatch.started)
+    {
+        task_notify(&s_dispatch);
+    }
+}
+
+// No cycle counter to read portably: count nanoseconds instead
+uint32_t i2c_proto_port_cycles(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
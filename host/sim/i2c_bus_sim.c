@@ -0,0 +1,1406 @@
+/*
+ * Host-side simulation of a shared I2C bus carrying the ESPSynth protocol.
+ *
+ * Every simulated slave is a separate process running the real slave runtime
+ * (module_i2c_proto_process_command), since that runtime keeps its state in
+ * file-scope statics. The parent plays the Central Controller: it replays a
+ * control trace (or a synthetic one), models bus timing at the chosen clock
+ * rate including mux switches and clock stretching, and reports achieved
+ * parameter updates per second and per-module worst-case latency. A fuzz
+ * mode throws random and mutated frames at every slave, and a scheduler mode
+ * enumerates the slaves and drives the master's bus scheduler against them.
+ *
+ * Trace format, one update per line ('#' starts a comment):
+ *     <time_us> <module> <param_id> <value>
+ */
+#include "module_i2c_proto_sched.h"
+
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SIM_MAX_SLAVES       I2C_PROTO_COALESCE_MAX_MODULES
+#define SIM_BASE_ADDRESS     0x20
+#define SIM_MUX_ADDRESS      0x70
+#define SIM_MUX_CHANNELS     8
+#define SIM_MUX_BURST        4  // Frames in a row on one mux channel before others get a turn
+#define SIM_MAX_RESP_LEN     I2C_PROTO_MAX_FRAME_LEN
+#define SIM_RT_PARAM         I2C_PROTO_PARAM_IDX_PARAM_OSC_PITCH_MIDI // Scheduler mode: realtime stream; bulk writes carry the rest
+#define SIM_RT_EVERY         3  // Scheduler mode: bulk segments between realtime updates
+
+typedef enum {
+    SIM_MODE_SINGLE, // One SET_PARAM per trace entry, in order
+    SIM_MODE_BATCH,  // Coalesce per module, flush as batch frames
+} sim_mode_t;
+
+typedef struct {
+    uint64_t time_us;
+    uint8_t module;
+    ParamId_t param_id;
+    ParamValue_t value;
+} sim_event_t;
+
+typedef struct {
+    pid_t pid;
+    int to_slave;
+    int from_slave;
+    // Statistics
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t updates;       // Parameter writes received
+    uint64_t superseded;    // Trace entries overwritten before they were sent
+    uint64_t latency_sum_us;
+    uint64_t latency_max_us;
+    uint64_t decode_ns;     // Host time spent inside process_command
+} sim_slave_t;
+
+typedef struct {
+    uint32_t bus_hz;
+    uint32_t stretch_us;    // Clock stretch per transaction
+    bool mux;               // Spread slaves over mux channels
+    sim_mode_t mode;
+    size_t slaves;
+} sim_config_t;
+
+static sim_slave_t s_slaves[SIM_MAX_SLAVES];
+
+// ---------------------------------------------------------------------------
+// Slave processes
+// ---------------------------------------------------------------------------
+
+static bool write_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    while (len)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    while (len)
+    {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Request:  uint16 len, uint16 resp_cap, len bytes
+// Response: int32 err, uint16 resp_len, uint64 decode_ns, resp_len bytes
+static void slave_main(int in, int out, uint8_t module_type, uint8_t address)
+{
+    module_i2c_proto_config_t config = MODULE_I2C_PROTO_CONFIG_DEFAULT(module_type, address);
+    config.deferred_apply = true;
+    module_i2c_proto_init_with_config(&config);
+
+    uint32_t frame = 0;
+    for (;;)
+    {
+        // Receive straight into the slave's arena, as the I2C driver would
+        uint16_t hdr[2];
+        uint8_t resp[SIM_MAX_RESP_LEN];
+        size_t buf_len;
+        uint8_t *buf = module_i2c_proto_rx_acquire(&buf_len);
+        if (!buf || !read_all(in, hdr, sizeof(hdr)) || hdr[0] > buf_len || !read_all(in, buf, hdr[0]))
+        {
+            _exit(0); // Master went away
+        }
+        module_i2c_proto_rx_commit(hdr[0]);
+
+        size_t resp_len = hdr[1] < sizeof(resp) ? hdr[1] : sizeof(resp);
+        const uint64_t start = now_ns();
+        const int32_t err = module_i2c_proto_rx_process(resp, &resp_len);
+        const uint64_t spent = now_ns() - start;
+
+        // Stand-in for the audio task: drain once per "block"
+        module_i2c_proto_timed_event_t event;
+        module_i2c_proto_apply_pending();
+        while (module_i2c_proto_next_timed_event(frame, 64, &event))
+        {
+        }
+        module_i2c_proto_ramp_process(64);
+        frame += 64;
+
+        const uint16_t rlen = (uint16_t)resp_len;
+        if (!write_all(out, &err, sizeof(err)) || !write_all(out, &rlen, sizeof(rlen)) ||
+            !write_all(out, &spent, sizeof(spent)) || !write_all(out, resp, rlen))
+        {
+            _exit(0);
+        }
+    }
+}
+
+static uint8_t slave_type(size_t index)
+{
+    return (index % 2) ? MODULE_TYPE_FILTER : MODULE_TYPE_OSCILLATOR;
+}
+
+static bool slave_start(size_t index)
+{
+    int down[2];
+    int up[2];
+    if (pipe(down) || pipe(up))
+    {
+        return false;
+    }
+
+    const uint8_t type = slave_type(index);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        return false;
+    }
+    if (pid == 0)
+    {
+        close(down[1]);
+        close(up[0]);
+        for (size_t i = 0; i < index; i++)
+        {
+            // Otherwise earlier slaves never see EOF when the master closes their pipes
+            close(s_slaves[i].to_slave);
+            close(s_slaves[i].from_slave);
+        }
+        slave_main(down[0], up[1], type, (uint8_t)(SIM_BASE_ADDRESS + index));
+    }
+
+    close(down[0]);
+    close(up[1]);
+    s_slaves[index] = (sim_slave_t){.pid = pid, .to_slave = down[1], .from_slave = up[0]};
+    return true;
+}
+
+static void slaves_stop(size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        close(s_slaves[i].to_slave);
+        close(s_slaves[i].from_slave);
+        waitpid(s_slaves[i].pid, NULL, 0);
+    }
+}
+
+// Run one write (and optional read) on a slave. Returns false if the slave died.
+static bool slave_transfer(size_t index, const uint8_t *frame, size_t len, uint8_t *resp, size_t *resp_len, esp_err_t *err)
+{
+    sim_slave_t *slave = &s_slaves[index];
+    const uint16_t hdr[2] = {(uint16_t)len, (uint16_t)(resp_len ? *resp_len : 0)};
+    int32_t status;
+    uint16_t rlen;
+    uint64_t spent;
+    uint8_t scratch[SIM_MAX_RESP_LEN];
+
+    if (!write_all(slave->to_slave, hdr, sizeof(hdr)) || !write_all(slave->to_slave, frame, len) ||
+        !read_all(slave->from_slave, &status, sizeof(status)) || !read_all(slave->from_slave, &rlen, sizeof(rlen)) ||
+        !read_all(slave->from_slave, &spent, sizeof(spent)) || !read_all(slave->from_slave, resp ? resp : scratch, rlen))
+    {
+        return false;
+    }
+
+    slave->decode_ns += spent;
+    if (resp_len)
+    {
+        *resp_len = rlen;
+    }
+    if (err)
+    {
+        *err = status;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Bus timing
+// ---------------------------------------------------------------------------
+
+// START + address byte + data bytes (each 8 bits + ACK) + STOP
+static uint64_t bus_time_ns(const sim_config_t *config, size_t data_bytes)
+{
+    const uint64_t bits = 1 + 9 * (1 + data_bytes) + 1;
+    return bits * 1000000000ULL / config->bus_hz;
+}
+
+typedef struct {
+    uint64_t now_ns;
+    uint64_t busy_ns;
+    int mux_channel;
+    uint64_t mux_switches;
+} sim_bus_t;
+
+// Account for one write transaction to a slave, switching the mux first if needed
+static void bus_transaction(const sim_config_t *config, sim_bus_t *bus, size_t slave, size_t len)
+{
+    uint64_t t = 0;
+    if (config->mux && bus->mux_channel != (int)(slave % SIM_MUX_CHANNELS))
+    {
+        t += bus_time_ns(config, 1); // Control byte to the mux at SIM_MUX_ADDRESS
+        bus->mux_channel = (int)(slave % SIM_MUX_CHANNELS);
+        bus->mux_switches++;
+    }
+    t += bus_time_ns(config, len) + (uint64_t)config->stretch_us * 1000;
+    bus->now_ns += t;
+    bus->busy_ns += t;
+}
+
+// ---------------------------------------------------------------------------
+// Traces
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    sim_event_t *events;
+    size_t count;
+    size_t cap;
+} sim_trace_t;
+
+static bool trace_push(sim_trace_t *trace, const sim_event_t *event)
+{
+    if (trace->count == trace->cap)
+    {
+        const size_t cap = trace->cap ? trace->cap * 2 : 1024;
+        sim_event_t *events = realloc(trace->events, cap * sizeof(sim_event_t));
+        if (!events)
+        {
+            return false;
+        }
+        trace->events = events;
+        trace->cap = cap;
+    }
+    trace->events[trace->count++] = *event;
+    return true;
+}
+
+static int event_cmp(const void *a, const void *b)
+{
+    const sim_event_t *ea = a;
+    const sim_event_t *eb = b;
+    return (ea->time_us > eb->time_us) - (ea->time_us < eb->time_us);
+}
+
+static bool trace_load(sim_trace_t *trace, const char *path, size_t slaves)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        return false;
+    }
+
+    char line[256];
+    unsigned lineno = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash)
+        {
+            *hash = '\0';
+        }
+
+        unsigned long long t;
+        unsigned long module, id;
+        long long value;
+        const int n = sscanf(line, "%llu %lu %li %lli", &t, &module, &id, &value);
+        if (n <= 0)
+        {
+            continue; // Blank or comment line
+        }
+        if (n != 4 || module >= slaves || !i2c_proto_param_find((ParamId_t)id))
+        {
+            fprintf(stderr, "%s:%u: bad entry (module must be < %zu, param must be known)\n", path, lineno, slaves);
+            fclose(f);
+            return false;
+        }
+
+        sim_event_t event = {.time_us = t, .module = (uint8_t)module, .param_id = (ParamId_t)id};
+        event.value.u32 = (uint32_t)value;
+        if (!trace_push(trace, &event))
+        {
+            fclose(f);
+            return false;
+        }
+    }
+    fclose(f);
+
+    qsort(trace->events, trace->count, sizeof(sim_event_t), event_cmp);
+    return true;
+}
+
+// Sine sweeps over `params` parameters per slave, `rate_hz` updates each
+static bool trace_synth(sim_trace_t *trace, size_t slaves, size_t params, double rate_hz, double seconds)
+{
+    if (params > I2C_PROTO_PARAM_COUNT)
+    {
+        params = I2C_PROTO_PARAM_COUNT;
+    }
+
+    const uint64_t period_us = (uint64_t)(1e6 / rate_hz);
+    const uint64_t end_us = (uint64_t)(seconds * 1e6);
+    for (size_t m = 0; m < slaves; m++)
+    {
+        for (size_t p = 0; p < params; p++)
+        {
+            const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[p];
+            const double lo = (double)desc->min;
+            const double span = (double)(desc->max - desc->min);
+            const uint64_t phase_us = (m * 37 + p * 101) % period_us; // Stagger the streams
+            for (uint64_t t = phase_us; t < end_us; t += period_us)
+            {
+                const double x = 0.5 + 0.5 * sin(2.0 * M_PI * 0.5 * (double)t / 1e6 + (double)p);
+                sim_event_t event = {.time_us = t, .module = (uint8_t)m, .param_id = desc->id};
+                if (desc->type == PARAM_TYPE_S16)
+                {
+                    event.value.s32 = (int32_t)(lo + x * span);
+                }
+                else
+                {
+                    event.value.u32 = (uint32_t)(lo + x * span);
+                }
+                if (!trace_push(trace, &event))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    qsort(trace->events, trace->count, sizeof(sim_event_t), event_cmp);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Replay
+// ---------------------------------------------------------------------------
+
+static void record_latency(sim_slave_t *slave, uint64_t latency_us)
+{
+    slave->updates++;
+    slave->latency_sum_us += latency_us;
+    if (latency_us > slave->latency_max_us)
+    {
+        slave->latency_max_us = latency_us;
+    }
+}
+
+// Oldest not-yet-sent trace time per (slave, parameter index), for the batch mode
+static uint64_t s_dirty_since_us[SIM_MAX_SLAVES][I2C_PROTO_PARAM_COUNT];
+
+static uint16_t slave_key(const sim_config_t *config, size_t slave)
+{
+    return I2C_PROTO_MODULE_KEY(config->mux ? slave % SIM_MUX_CHANNELS : 0, SIM_BASE_ADDRESS + slave);
+}
+
+static const i2c_proto_coalesce_entry_t *coalescer_entry(const i2c_proto_coalescer_t *coalescer, const sim_config_t *config, size_t slave)
+{
+    const uint16_t key = slave_key(config, slave);
+    for (size_t s = 0; s < I2C_PROTO_COALESCE_MAX_MODULES; s++)
+    {
+        if (coalescer->modules[s].in_use && coalescer->modules[s].module_key == key)
+        {
+            return &coalescer->modules[s];
+        }
+    }
+    return NULL;
+}
+
+static bool entry_pending(const i2c_proto_coalesce_entry_t *entry)
+{
+    for (size_t w = 0; entry && w < I2C_PROTO_PARAM_BITMAP_WORDS; w++)
+    {
+        if (entry->dirty[w])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool replay(const sim_config_t *config, const sim_trace_t *trace, sim_bus_t *bus)
+{
+    static i2c_proto_coalescer_t coalescer;
+    i2c_proto_coalescer_init(&coalescer);
+
+    uint8_t frame[I2C_PROTO_MAX_FRAME_LEN];
+    size_t next = 0;
+    size_t rr = 0;    // Round-robin start for fairness between modules
+    size_t burst = 0; // Consecutive frames on the current mux channel
+
+    while (next < trace->count || (config->mode == SIM_MODE_BATCH && i2c_proto_coalescer_next_pending(&coalescer, &(uint16_t){0})))
+    {
+        const uint64_t now_us = bus->now_ns / 1000;
+
+        if (config->mode == SIM_MODE_SINGLE)
+        {
+            const sim_event_t *e = &trace->events[next++];
+            if (e->time_us * 1000 > bus->now_ns)
+            {
+                bus->now_ns = e->time_us * 1000; // Bus idle until the next update
+            }
+            const size_t len = i2c_proto_pack_set_param_msg(frame, sizeof(frame), e->param_id, e->value);
+            if (!slave_transfer(e->module, frame, len, NULL, NULL, NULL))
+            {
+                fprintf(stderr, "slave %u died\n", e->module);
+                return false;
+            }
+            bus_transaction(config, bus, e->module, len);
+            s_slaves[e->module].frames++;
+            s_slaves[e->module].bytes += len;
+            record_latency(&s_slaves[e->module], bus->now_ns / 1000 - e->time_us);
+            continue;
+        }
+
+        // Batch mode: feed everything that has happened by now into the coalescer
+        while (next < trace->count && trace->events[next].time_us <= now_us)
+        {
+            const sim_event_t *e = &trace->events[next++];
+            const size_t index = (size_t)(i2c_proto_param_find(e->param_id) - i2c_proto_param_descriptors);
+            const uint16_t key = slave_key(config, e->module);
+            if (s_dirty_since_us[e->module][index])
+            {
+                s_slaves[e->module].superseded++;
+            }
+            else
+            {
+                s_dirty_since_us[e->module][index] = e->time_us + 1; // +1 so that t = 0 reads as dirty
+            }
+            i2c_proto_coalescer_set(&coalescer, key, e->param_id, e->value);
+        }
+
+        // Pick the next module with pending updates, preferring the current mux channel
+        size_t target = SIZE_MAX;
+        for (size_t k = 0; k < config->slaves; k++)
+        {
+            const size_t m = (rr + k) % config->slaves;
+            if (!entry_pending(coalescer_entry(&coalescer, config, m)))
+            {
+                continue;
+            }
+            if (target == SIZE_MAX)
+            {
+                target = m;
+            }
+            if (!config->mux || ((int)(m % SIM_MUX_CHANNELS) == bus->mux_channel && burst < SIM_MUX_BURST))
+            {
+                target = m;
+                break;
+            }
+        }
+        if (target == SIZE_MAX)
+        {
+            if (next < trace->count)
+            {
+                bus->now_ns = trace->events[next].time_us * 1000; // Bus idle until the next update
+            }
+            continue;
+        }
+        rr = target + 1;
+        burst = (int)(target % SIM_MUX_CHANNELS) == bus->mux_channel ? burst + 1 : 1;
+
+        // Note which parameters go out so their latency can be recorded
+        const i2c_proto_coalesce_entry_t *entry = coalescer_entry(&coalescer, config, target);
+        uint32_t before[I2C_PROTO_PARAM_BITMAP_WORDS];
+        memcpy(before, entry->dirty, sizeof(before));
+        const size_t len = i2c_proto_coalescer_flush(&coalescer, entry->module_key, frame, sizeof(frame));
+        const uint32_t *after = entry->dirty;
+
+        if (!slave_transfer(target, frame, len, NULL, NULL, NULL))
+        {
+            fprintf(stderr, "slave %zu died\n", target);
+            return false;
+        }
+        bus_transaction(config, bus, target, len);
+        s_slaves[target].frames++;
+        s_slaves[target].bytes += len;
+
+        for (size_t index = 0; index < I2C_PROTO_PARAM_COUNT; index++)
+        {
+            const uint32_t bit = 1UL << (index % 32);
+            if ((before[index / 32] & bit) && !(after[index / 32] & bit))
+            {
+                record_latency(&s_slaves[target], bus->now_ns / 1000 - (s_dirty_since_us[target][index] - 1));
+                s_dirty_since_us[target][index] = 0;
+            }
+        }
+    }
+    return true;
+}
+
+// Read every parameter back and compare with the last value the trace set
+static size_t verify(const sim_config_t *config, const sim_trace_t *trace)
+{
+    static ParamValue_t expected[SIM_MAX_SLAVES][I2C_PROTO_PARAM_COUNT];
+    static bool written[SIM_MAX_SLAVES][I2C_PROTO_PARAM_COUNT];
+    memset(written, 0, sizeof(written));
+    for (size_t i = 0; i < trace->count; i++)
+    {
+        const sim_event_t *e = &trace->events[i];
+        const size_t index = (size_t)(i2c_proto_param_find(e->param_id) - i2c_proto_param_descriptors);
+        expected[e->module][index] = e->value;
+        written[e->module][index] = true;
+    }
+
+    size_t mismatches = 0;
+    for (size_t m = 0; m < config->slaves; m++)
+    {
+        i2c_proto_param_snapshot_t snapshot;
+        i2c_proto_param_snapshot_clear(&snapshot);
+
+        ParamId_t first = 0;
+        bool more = true;
+        while (more)
+        {
+            uint8_t cmd[8];
+            uint8_t resp[64];
+            size_t resp_len = sizeof(resp);
+            const size_t len = i2c_proto_pack_get_param_range_msg(cmd, sizeof(cmd), first, 0xFFFF);
+            if (!slave_transfer(m, cmd, len, resp, &resp_len, NULL) ||
+                i2c_proto_param_snapshot_unpack(&snapshot, resp, resp_len, &first, &more) != ESP_OK)
+            {
+                return SIZE_MAX;
+            }
+        }
+
+        for (size_t index = 0; index < I2C_PROTO_PARAM_COUNT; index++)
+        {
+            ParamValue_t got;
+            const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[index];
+            if (!written[m][index] || !i2c_proto_param_snapshot_get(&snapshot, desc->id, &got))
+            {
+                continue;
+            }
+            const uint32_t mask = desc->width == 4 ? UINT32_MAX : (1UL << (8 * desc->width)) - 1;
+            if ((got.u32 & mask) != (expected[m][index].u32 & mask))
+            {
+                fprintf(stderr, "module %zu param 0x%02x: expected %u got %u\n", m, desc->id,
+                        (unsigned)(expected[m][index].u32 & mask), (unsigned)(got.u32 & mask));
+                mismatches++;
+            }
+        }
+    }
+    return mismatches;
+}
+
+static void report(const sim_config_t *config, const sim_trace_t *trace, const sim_bus_t *bus)
+{
+    const double seconds = trace->count ? (double)bus->now_ns / 1e9 : 0;
+    uint64_t total_updates = 0;
+    uint64_t total_superseded = 0;
+
+    printf("bus %u Hz, %s mode, %zu slaves%s, stretch %u us\n", config->bus_hz,
+           config->mode == SIM_MODE_BATCH ? "batch" : "single", config->slaves, config->mux ? " behind a mux" : "",
+           config->stretch_us);
+    printf("%-6s %8s %10s %10s %10s %12s %12s %12s\n", "module", "frames", "bytes", "updates", "superseded",
+           "avg lat us", "max lat us", "decode ns");
+    for (size_t m = 0; m < config->slaves; m++)
+    {
+        const sim_slave_t *s = &s_slaves[m];
+        printf("%-6zu %8llu %10llu %10llu %10llu %12.1f %12llu %12.1f\n", m, (unsigned long long)s->frames,
+               (unsigned long long)s->bytes, (unsigned long long)s->updates, (unsigned long long)s->superseded,
+               s->updates ? (double)s->latency_sum_us / s->updates : 0.0, (unsigned long long)s->latency_max_us,
+               s->frames ? (double)s->decode_ns / s->frames : 0.0);
+        total_updates += s->updates;
+        total_superseded += s->superseded;
+    }
+
+    printf("trace entries %zu, delivered %llu, superseded %llu\n", trace->count, (unsigned long long)total_updates,
+           (unsigned long long)total_superseded);
+    printf("simulated time %.3f s, bus busy %.1f %%, mux switches %llu\n", seconds,
+           bus->now_ns ? 100.0 * (double)bus->busy_ns / (double)bus->now_ns : 0.0, (unsigned long long)bus->mux_switches);
+    const double trace_seconds = trace->count ? (double)(trace->events[trace->count - 1].time_us + 1) / 1e6 : 0;
+    printf("achieved updates/s %.0f (trace offered %.0f/s)\n", seconds > 0 ? (double)total_updates / seconds : 0.0,
+           trace_seconds > 0 ? (double)trace->count / trace_seconds : 0.0);
+}
+
+// ---------------------------------------------------------------------------
+// Scheduler and enumerator
+// ---------------------------------------------------------------------------
+
+// Synchronous stand-in for the asynchronous transport: every operation runs on
+// the slave processes, is charged to the modelled bus and has completed (with
+// i2c_proto_*_io_done()) by the time it returns
+typedef struct {
+    const sim_config_t *config;
+    sim_bus_t *bus;
+    uint8_t open_channels;                 // Mux channels currently open
+    i2c_proto_enum_t *en;                  // Client to complete: the enumerator if set,
+    i2c_proto_sched_t *sched;              // otherwise the scheduler
+    bool failed;                           // A slave died
+    // Scheduler traffic, for the interleaving check
+    uint64_t bulk_transfers;
+    uint64_t bulk_segments[SIM_MAX_SLAVES];
+    bool bulk_open[SIM_MAX_SLAVES];        // Some segments of the slave's bulk write sent, not all
+    bool rt_waiting[SIM_MAX_SLAVES];       // Realtime update set and not sent yet
+    uint64_t rt_issued_at[SIM_MAX_SLAVES]; // bulk_transfers when it was set
+    uint64_t rt_frames;
+    uint64_t rt_interleaved;               // Realtime frames sent while a bulk write was half done
+    uint64_t rt_max_lag;                   // Most bulk segments sent between setting and sending an update
+} sim_port_t;
+
+typedef struct {
+    unsigned completions; // Done callbacks run; must end at exactly one
+    esp_err_t err;
+} sim_bulk_t;
+
+typedef struct {
+    bool done;
+    esp_err_t err;
+    size_t resp_len;
+} sim_read_t;
+
+static void port_charge(sim_port_t *port, uint64_t t)
+{
+    port->bus->now_ns += t;
+    port->bus->busy_ns += t;
+}
+
+static void port_done(sim_port_t *port, esp_err_t err, size_t resp_len)
+{
+    if (port->en)
+    {
+        i2c_proto_enum_io_done(port->en, err, resp_len);
+    }
+    else
+    {
+        i2c_proto_sched_io_done(port->sched, err, resp_len);
+    }
+}
+
+// Slave answering at address through the open mux channels, or -1 for a NACK
+static int port_slave(const sim_port_t *port, uint8_t address)
+{
+    if (address < SIM_BASE_ADDRESS || address >= SIM_BASE_ADDRESS + port->config->slaves)
+    {
+        return -1;
+    }
+    const size_t slave = address - SIM_BASE_ADDRESS;
+    if (port->config->mux && !(port->open_channels & (1U << (slave % SIM_MUX_CHANNELS))))
+    {
+        return -1;
+    }
+    return (int)slave;
+}
+
+// Classify the scheduler's active frame on its way to a slave
+static void port_account(sim_port_t *port, size_t slave)
+{
+    const i2c_proto_sched_frame_t *frame = &port->sched->frames[port->sched->active];
+    if (frame->prio == I2C_PROTO_SCHED_BULK)
+    {
+        port->bulk_transfers++;
+        port->bulk_segments[slave]++;
+        port->bulk_open[slave] = frame->more;
+        return;
+    }
+    if (frame->prio != I2C_PROTO_SCHED_REALTIME)
+    {
+        return;
+    }
+
+    port->rt_frames++;
+    if (port->rt_waiting[slave])
+    {
+        const uint64_t lag = port->bulk_transfers - port->rt_issued_at[slave];
+        if (lag > port->rt_max_lag)
+        {
+            port->rt_max_lag = lag;
+        }
+        port->rt_waiting[slave] = false;
+    }
+    for (size_t m = 0; m < port->config->slaves; m++)
+    {
+        if (port->bulk_open[m])
+        {
+            port->rt_interleaved++;
+            break;
+        }
+    }
+}
+
+static esp_err_t port_transfer(sim_port_t *port, uint8_t address, const uint8_t *data, size_t len, uint8_t *resp, size_t resp_cap)
+{
+    const int slave = port_slave(port, address);
+    if (slave < 0)
+    {
+        port_charge(port, bus_time_ns(port->config, 0)); // Address byte not acknowledged, then STOP
+        return ESP_FAIL;
+    }
+    if (port->sched)
+    {
+        port_account(port, (size_t)slave);
+    }
+
+    // The slave's decode result never reaches the master on a real bus; readback catches bad writes
+    size_t resp_len = resp_cap;
+    if (!slave_transfer((size_t)slave, data, len, resp, resp ? &resp_len : NULL, NULL))
+    {
+        fprintf(stderr, "slave %d died\n", slave);
+        port->failed = true;
+        return ESP_FAIL;
+    }
+    port_charge(port, bus_time_ns(port->config, len) + (resp ? bus_time_ns(port->config, resp_cap) : 0) +
+                          (uint64_t)port->config->stretch_us * 1000);
+    port_done(port, ESP_OK, resp ? resp_len : 0);
+    return ESP_OK;
+}
+
+static esp_err_t port_select_channel(void *ctx, uint8_t channel_mask)
+{
+    sim_port_t *port = ctx;
+    port_charge(port, bus_time_ns(port->config, 1)); // Control byte to the mux at SIM_MUX_ADDRESS
+    port->open_channels = channel_mask;
+    port->bus->mux_switches++;
+    port_done(port, ESP_OK, 0);
+    return ESP_OK;
+}
+
+static esp_err_t port_write(void *ctx, uint8_t address, const uint8_t *data, size_t len)
+{
+    return port_transfer(ctx, address, data, len, NULL, 0);
+}
+
+static esp_err_t port_write_read(void *ctx, uint8_t address, const uint8_t *data, size_t len, uint8_t *resp, size_t resp_cap)
+{
+    return port_transfer(ctx, address, data, len, resp, resp_cap);
+}
+
+// Scan every address below the mux on every channel and check that exactly the simulated slaves answer
+static bool sched_enumerate(sim_port_t *port, const i2c_proto_sched_transport_t *transport,
+                            i2c_proto_enum_result_t *results, size_t *count)
+{
+    static i2c_proto_enum_t en;
+    const sim_config_t *config = port->config;
+    const uint64_t start_ns = port->bus->now_ns;
+    if (i2c_proto_enum_start(&en, transport, 0xFF, 0x08, SIM_MUX_ADDRESS - 1, results, SIM_MAX_SLAVES) != ESP_OK)
+    {
+        return false;
+    }
+    port->en = &en;
+    while (i2c_proto_enum_poll(&en))
+    {
+    }
+    port->en = NULL;
+    if (port->failed)
+    {
+        return false;
+    }
+    printf("enumerate: %zu modules in %.2f ms of bus time, %u operations\n", en.count,
+           (double)(port->bus->now_ns - start_ns) / 1e6, (unsigned)en.transfers);
+
+    bool ok = en.count == config->slaves;
+    if (!ok)
+    {
+        fprintf(stderr, "enumerate: found %zu modules, expected %zu\n", en.count, config->slaves);
+    }
+    *count = en.count < SIM_MAX_SLAVES ? en.count : SIM_MAX_SLAVES;
+    for (size_t m = 0; m < config->slaves; m++)
+    {
+        const i2c_proto_enum_result_t *found = NULL;
+        for (size_t i = 0; i < *count; i++)
+        {
+            if (results[i].module_key == slave_key(config, m))
+            {
+                found = &results[i];
+            }
+        }
+        if (!found || found->identity.module_type != slave_type(m) ||
+            found->identity.version_major != I2C_PROTO_VERSION_MAJOR ||
+            found->identity.version_minor != I2C_PROTO_VERSION_MINOR || found->identity.param_count != I2C_PROTO_PARAM_COUNT)
+        {
+            fprintf(stderr, "enumerate: module %zu missing or misidentified\n", m);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Value of a parameter in the pass-th copy of a slave's bulk write
+static ParamValue_t bulk_value(const ParamDescriptor_t *desc, size_t slave, size_t pass)
+{
+    const int64_t v = desc->min + (desc->max - desc->min) / 8 * (int64_t)((slave + pass) % 7 + 1);
+    ParamValue_t value;
+    if (desc->type == PARAM_TYPE_S16)
+    {
+        value.s32 = (int32_t)v;
+    }
+    else
+    {
+        value.u32 = (uint32_t)v;
+    }
+    return value;
+}
+
+// As many passes of SET_PARAM over every non-realtime parameter as fit, each
+// with other values, so that a lost or reordered segment changes the result
+static size_t bulk_frame(uint8_t *buf, size_t cap, size_t slave, size_t *passes)
+{
+    size_t len = 0;
+    for (*passes = 0;; (*passes)++)
+    {
+        uint8_t pass_buf[I2C_PROTO_MAX_FRAME_LEN];
+        size_t pass_len = 0;
+        for (size_t index = 0; index < I2C_PROTO_PARAM_COUNT; index++)
+        {
+            const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[index];
+            if (index != SIM_RT_PARAM)
+            {
+                pass_len += i2c_proto_pack_set_param_msg(pass_buf + pass_len, sizeof(pass_buf) - pass_len, desc->id,
+                                                         bulk_value(desc, slave, *passes));
+            }
+        }
+        if (len + pass_len > cap)
+        {
+            return len;
+        }
+        memcpy(buf + len, pass_buf, pass_len);
+        len += pass_len;
+    }
+}
+
+static void bulk_done(void *user_data, esp_err_t err, uint8_t *resp, size_t resp_len)
+{
+    sim_bulk_t *bulk = user_data;
+    (void)resp;
+    (void)resp_len;
+    bulk->completions++;
+    bulk->err = err;
+}
+
+static void read_done(void *user_data, esp_err_t err, uint8_t *resp, size_t resp_len)
+{
+    sim_read_t *read = user_data;
+    (void)resp;
+    read->done = true;
+    read->err = err;
+    read->resp_len = resp_len;
+}
+
+static void count_done(void *user_data, esp_err_t err, uint8_t *resp, size_t resp_len)
+{
+    (void)resp;
+    (void)resp_len;
+    if (err == ESP_OK)
+    {
+        (*(unsigned *)user_data)++;
+    }
+}
+
+// Fill the frame pool with writes to one module, then set a realtime update
+// for it: the queued writes must still go out and free a frame for the flush
+static bool sched_pool_check(const sim_config_t *config, sim_port_t *port, i2c_proto_sched_t *sched, size_t passes,
+                             ParamValue_t *rt_value, bool *rt_written)
+{
+    const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[(SIM_RT_PARAM + 1) % I2C_PROTO_PARAM_COUNT];
+    uint8_t frame[16];
+    const size_t len = i2c_proto_pack_set_param_msg(frame, sizeof(frame), desc->id, bulk_value(desc, 0, passes - 1));
+    unsigned completions = 0;
+    size_t queued = 0;
+    while (i2c_proto_sched_enqueue(sched, slave_key(config, 0), frame, len, count_done, &completions) == ESP_OK)
+    {
+        queued++;
+    }
+    const ParamValue_t value = {.u32 = 127};
+    if (queued != I2C_PROTO_SCHED_FRAMES || i2c_proto_sched_set_param(sched, slave_key(config, 0), i2c_proto_param_descriptors[SIM_RT_PARAM].id, value) != ESP_OK)
+    {
+        fprintf(stderr, "sched: could not fill the frame pool (%zu frames)\n", queued);
+        return false;
+    }
+    rt_value[0] = value;
+    rt_written[0] = true;
+
+    const uint64_t rt_before = port->rt_frames;
+    for (unsigned polls = 0; i2c_proto_sched_poll(sched); polls++)
+    {
+        if (polls > 4 * I2C_PROTO_SCHED_FRAMES)
+        {
+            fprintf(stderr, "sched: stalled with a full frame pool and a coalesced update pending\n");
+            return false;
+        }
+    }
+    if (port->failed || completions != queued || port->rt_frames != rt_before + 1)
+    {
+        fprintf(stderr, "sched: full pool: %u of %zu writes and %llu realtime frames sent\n", completions, queued,
+                (unsigned long long)(port->rt_frames - rt_before));
+        return false;
+    }
+    printf("sched: full frame pool drained, %zu queued writes and the realtime update sent\n", queued);
+    return true;
+}
+
+// Read every parameter of a module through the scheduler
+static bool sched_readback(i2c_proto_sched_t *sched, uint16_t module_key, i2c_proto_param_snapshot_t *snapshot)
+{
+    i2c_proto_param_snapshot_clear(snapshot);
+    ParamId_t first = 0;
+    bool more = true;
+    while (more)
+    {
+        uint8_t cmd[8];
+        uint8_t resp[64];
+        sim_read_t read = {0};
+        const size_t len = i2c_proto_pack_get_param_range_msg(cmd, sizeof(cmd), first, 0xFFFF);
+        if (i2c_proto_sched_enqueue_read(sched, module_key, cmd, len, resp, sizeof(resp), read_done, &read) != ESP_OK)
+        {
+            return false;
+        }
+        while (i2c_proto_sched_poll(sched))
+        {
+        }
+        if (!read.done || read.err != ESP_OK ||
+            i2c_proto_param_snapshot_unpack(snapshot, resp, read.resp_len, &first, &more) != ESP_OK)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Enumerate, negotiate, then send every slave a segmented bulk write while a
+// realtime stream runs, and check that the realtime frames cut in between
+// segments and that every bulk write arrived whole and in order
+static bool sched_check(const sim_config_t *config, sim_bus_t *bus)
+{
+    static sim_port_t port;
+    port = (sim_port_t){.config = config, .bus = bus};
+    const i2c_proto_sched_transport_t transport = {
+        .select_channel = config->mux ? port_select_channel : NULL,
+        .write_async = port_write,
+        .write_read_async = port_write_read,
+        .ctx = &port,
+    };
+
+    static i2c_proto_enum_result_t results[SIM_MAX_SLAVES];
+    size_t count;
+    if (!sched_enumerate(&port, &transport, results, &count))
+    {
+        return false;
+    }
+
+    static i2c_proto_sched_t sched;
+    if (i2c_proto_sched_init(&sched, &transport) != ESP_OK || i2c_proto_sched_negotiate(&sched, results, count) != ESP_OK)
+    {
+        fprintf(stderr, "sched: setup failed\n");
+        return false;
+    }
+    port.sched = &sched;
+
+    static uint8_t frames[SIM_MAX_SLAVES][I2C_PROTO_MAX_FRAME_LEN];
+    size_t lens[SIM_MAX_SLAVES];
+    size_t passes = 0;
+    for (size_t m = 0; m < config->slaves; m++)
+    {
+        lens[m] = bulk_frame(frames[m], sizeof(frames[m]), m, &passes);
+    }
+
+    sim_bulk_t bulk[SIM_MAX_SLAVES] = {0};
+    ParamValue_t rt_value[SIM_MAX_SLAVES];
+    bool rt_written[SIM_MAX_SLAVES] = {0};
+    const ParamDescriptor_t *rt_desc = &i2c_proto_param_descriptors[SIM_RT_PARAM];
+    const uint64_t start_ns = bus->now_ns;
+    const uint64_t start_switches = bus->mux_switches;
+    size_t queued = 0;
+    uint32_t rt_next = 0;
+    uint64_t rt_last = 0; // port.bulk_transfers when the last realtime update was set
+    for (;;)
+    {
+        // Queue bulk writes as the frame pool frees up
+        while (queued < config->slaves)
+        {
+            const esp_err_t err = i2c_proto_sched_enqueue_prio(&sched, slave_key(config, queued), I2C_PROTO_SCHED_BULK,
+                                                               frames[queued], lens[queued], NULL, 0, bulk_done, &bulk[queued]);
+            if (err == ESP_ERR_NO_MEM)
+            {
+                break;
+            }
+            if (err != ESP_OK)
+            {
+                fprintf(stderr, "sched: bulk write to module %zu refused (0x%x)\n", queued, err);
+                return false;
+            }
+            queued++;
+        }
+
+        // A realtime update every few bulk segments while bulk data is moving
+        bool bulk_busy = queued < config->slaves;
+        for (size_t m = 0; m < queued && !bulk_busy; m++)
+        {
+            bulk_busy = bulk[m].completions == 0;
+        }
+        if (bulk_busy && port.bulk_transfers >= rt_last + SIM_RT_EVERY)
+        {
+            const size_t m = rt_next % config->slaves;
+            const ParamValue_t value = {.u32 = rt_next % 128};
+            if (i2c_proto_sched_set_param(&sched, slave_key(config, m), rt_desc->id, value) != ESP_OK)
+            {
+                fprintf(stderr, "sched: realtime update to module %zu refused\n", m);
+                return false;
+            }
+            rt_value[m] = value;
+            rt_written[m] = true;
+            if (!port.rt_waiting[m])
+            {
+                port.rt_waiting[m] = true;
+                port.rt_issued_at[m] = port.bulk_transfers;
+            }
+            rt_next++;
+            rt_last = port.bulk_transfers;
+        }
+
+        if (!i2c_proto_sched_poll(&sched) && queued == config->slaves)
+        {
+            break;
+        }
+        if (port.failed)
+        {
+            return false;
+        }
+    }
+
+    uint64_t segments = 0;
+    bool ok = true;
+    for (size_t m = 0; m < config->slaves; m++)
+    {
+        segments += port.bulk_segments[m];
+        if (bulk[m].completions != 1 || bulk[m].err != ESP_OK || port.bulk_segments[m] < 2 || port.rt_waiting[m])
+        {
+            fprintf(stderr, "sched: module %zu: %u bulk completions (0x%x) over %llu segments%s\n", m,
+                    bulk[m].completions, bulk[m].err, (unsigned long long)port.bulk_segments[m],
+                    port.rt_waiting[m] ? ", realtime update never sent" : "");
+            ok = false;
+        }
+    }
+    printf("sched: %zu bulk writes of %zu bytes in %llu segments, %u realtime updates in %llu frames\n", config->slaves,
+           lens[0], (unsigned long long)segments, (unsigned)rt_next, (unsigned long long)port.rt_frames);
+    printf("sched: %llu realtime frames between bulk segments, at most %llu segment(s) of delay\n",
+           (unsigned long long)port.rt_interleaved, (unsigned long long)port.rt_max_lag);
+    printf("sched: %.2f ms of bus time, mux switches %llu\n", (double)(bus->now_ns - start_ns) / 1e6,
+           (unsigned long long)(bus->mux_switches - start_switches));
+    if (port.rt_interleaved == 0 || port.rt_max_lag > 1)
+    {
+        fprintf(stderr, "sched: realtime traffic did not overtake the bulk writes\n");
+        ok = false;
+    }
+
+    if (!sched_pool_check(config, &port, &sched, passes, rt_value, rt_written))
+    {
+        return false;
+    }
+
+    // Each slave must hold the last pass of its bulk write and its last realtime value
+    for (size_t m = 0; m < config->slaves; m++)
+    {
+        i2c_proto_param_snapshot_t snapshot;
+        if (!sched_readback(&sched, slave_key(config, m), &snapshot))
+        {
+            fprintf(stderr, "sched: readback of module %zu failed\n", m);
+            return false;
+        }
+        for (size_t index = 0; index < I2C_PROTO_PARAM_COUNT; index++)
+        {
+            const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[index];
+            if (index == SIM_RT_PARAM && !rt_written[m])
+            {
+                continue;
+            }
+            const ParamValue_t expected = index == SIM_RT_PARAM ? rt_value[m] : bulk_value(desc, m, passes - 1);
+            const uint32_t mask = desc->width == 4 ? UINT32_MAX : (1UL << (8 * desc->width)) - 1;
+            ParamValue_t got;
+            if (!i2c_proto_param_snapshot_get(&snapshot, desc->id, &got) || (got.u32 & mask) != (expected.u32 & mask))
+            {
+                fprintf(stderr, "sched: module %zu param 0x%02x: expected %u got %u\n", m, desc->id,
+                        (unsigned)(expected.u32 & mask), (unsigned)(got.u32 & mask));
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Fuzzing
+// ---------------------------------------------------------------------------
+
+static bool fuzz_err_ok(esp_err_t err)
+{
+    return err == ESP_OK || err == ESP_ERR_INVALID_ARG || err == ESP_ERR_INVALID_SIZE || err == ESP_ERR_NOT_FOUND ||
+           err == ESP_ERR_NOT_SUPPORTED || err == ESP_ERR_NO_MEM || err == ESP_ERR_INVALID_CRC;
+}
+
+static size_t fuzz_frame(uint8_t *frame, size_t cap)
+{
+    // Half the time start from a valid frame and corrupt it
+    if (rand() % 2)
+    {
+        i2c_proto_frame_builder_t builder;
+        i2c_proto_frame_builder_begin(&builder, frame, cap);
+        const int n = 1 + rand() % 12;
+        for (int i = 0; i < n; i++)
+        {
+            ParamValue_t v = {.u32 = (uint32_t)rand()};
+            i2c_proto_frame_builder_append_param(&builder, i2c_proto_param_descriptors[rand() % I2C_PROTO_PARAM_COUNT].id, v);
+        }
+        size_t len = i2c_proto_frame_builder_finish(&builder);
+        if (len && rand() % 2)
+        {
+            len = i2c_proto_pack_crc_frame(frame, cap, frame, len);
+        }
+        const int flips = rand() % 4;
+        for (int i = 0; i < flips && len; i++)
+        {
+            frame[rand() % len] ^= (uint8_t)(1 << (rand() % 8));
+        }
+        if (len && rand() % 4 == 0)
+        {
+            len = (size_t)(rand() % (int)len) + 1; // Truncate
+        }
+        return len;
+    }
+
+    const size_t len = 1 + (size_t)rand() % 64;
+    for (size_t i = 0; i < len; i++)
+    {
+        frame[i] = (uint8_t)rand();
+    }
+    if (rand() % 2)
+    {
+        frame[0] = (uint8_t)(rand() % 0x10); // Bias towards real commands
+    }
+    return len;
+}
+
+static bool fuzz(const sim_config_t *config, unsigned iterations)
+{
+    for (size_t m = 0; m < config->slaves; m++)
+    {
+        for (unsigned i = 0; i < iterations; i++)
+        {
+            uint8_t frame[I2C_PROTO_MAX_FRAME_LEN];
+            uint8_t resp[SIM_MAX_RESP_LEN];
+            size_t resp_len = (size_t)rand() % sizeof(resp);
+            esp_err_t err;
+            const size_t len = fuzz_frame(frame, sizeof(frame));
+            if (!slave_transfer(m, frame, len, resp, &resp_len, &err))
+            {
+                fprintf(stderr, "fuzz: slave %zu died on frame:", m);
+                for (size_t b = 0; b < len; b++)
+                {
+                    fprintf(stderr, " %02x", frame[b]);
+                }
+                fprintf(stderr, "\n");
+                return false;
+            }
+            if (!fuzz_err_ok(err))
+            {
+                fprintf(stderr, "fuzz: slave %zu returned unexpected 0x%x\n", m, err);
+                return false;
+            }
+        }
+
+        // The slave must still answer normally
+        const uint8_t cmd = REG_COMMON_MODULE_TYPE;
+        uint8_t type = 0xFF;
+        size_t type_len = 1;
+        esp_err_t err;
+        if (!slave_transfer(m, &cmd, 1, &type, &type_len, &err) || err != ESP_OK || type_len != 1 ||
+            type != slave_type(m))
+        {
+            fprintf(stderr, "fuzz: slave %zu no longer responds\n", m);
+            return false;
+        }
+    }
+    printf("fuzz: %u frames per slave, %zu slaves, no failures\n", iterations, config->slaves);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --trace FILE      replay FILE (default: synthetic sweeps)\n"
+            "  --slaves N        simulated modules (1-%d, default 6)\n"
+            "  --speed HZ        bus clock, e.g. 100000, 400000, 1000000 (default 400000)\n"
+            "  --stretch-us US   clock stretch per transaction (default 0)\n"
+            "  --mux             put slaves behind an 8-channel mux\n"
+            "  --mode MODE       single | batch (default batch)\n"
+            "  --params K        synthetic: parameters swept per module (default 4)\n"
+            "  --rate HZ         synthetic: updates per second per parameter (default 1000)\n"
+            "  --seconds S       synthetic: trace length (default 1)\n"
+            "  --fuzz N          send N random frames to every slave instead of replaying\n"
+            "  --seed N          random seed for --fuzz (default 1)\n"
+            "  --sched           enumerate the slaves, then drive the bus scheduler with bulk and realtime\n"
+            "                    traffic instead of replaying\n",
+            argv0, SIM_MAX_SLAVES);
+}
+
+int main(int argc, char **argv)
+{
+    sim_config_t config = {.bus_hz = 400000, .mode = SIM_MODE_BATCH, .slaves = 6};
+    const char *trace_path = NULL;
+    size_t params = 4;
+    double rate_hz = 1000;
+    double seconds = 1;
+    unsigned fuzz_iterations = 0;
+    unsigned seed = 1;
+    bool sched = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(arg, "--mux"))
+        {
+            config.mux = true;
+            continue;
+        }
+        if (!strcmp(arg, "--sched"))
+        {
+            sched = true;
+            continue;
+        }
+        if (!val)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+        if (!strcmp(arg, "--trace"))
+        {
+            trace_path = val;
+        }
+        else if (!strcmp(arg, "--slaves"))
+        {
+            config.slaves = strtoul(val, NULL, 0);
+        }
+        else if (!strcmp(arg, "--speed"))
+        {
+            config.bus_hz = (uint32_t)strtoul(val, NULL, 0);
+        }
+        else if (!strcmp(arg, "--stretch-us"))
+        {
+            config.stretch_us = (uint32_t)strtoul(val, NULL, 0);
+        }
+        else if (!strcmp(arg, "--mode"))
+        {
+            config.mode = !strcmp(val, "single") ? SIM_MODE_SINGLE : SIM_MODE_BATCH;
+        }
+        else if (!strcmp(arg, "--params"))
+        {
+            params = strtoul(val, NULL, 0);
+        }
+        else if (!strcmp(arg, "--rate"))
+        {
+            rate_hz = strtod(val, NULL);
+        }
+        else if (!strcmp(arg, "--seconds"))
+        {
+            seconds = strtod(val, NULL);
+        }
+        else if (!strcmp(arg, "--fuzz"))
+        {
+            fuzz_iterations = (unsigned)strtoul(val, NULL, 0);
+        }
+        else if (!strcmp(arg, "--seed"))
+        {
+            seed = (unsigned)strtoul(val, NULL, 0);
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (config.slaves == 0 || config.slaves > SIM_MAX_SLAVES || config.bus_hz == 0 || rate_hz <= 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    signal(SIGPIPE, SIG_IGN); // A crashed slave shows up as a failed write instead
+    for (size_t i = 0; i < config.slaves; i++)
+    {
+        if (!slave_start(i))
+        {
+            perror("slave_start");
+            slaves_stop(i);
+            return 1;
+        }
+    }
+
+    int rc = 0;
+    if (fuzz_iterations)
+    {
+        srand(seed);
+        rc = fuzz(&config, fuzz_iterations) ? 0 : 1;
+    }
+    else if (sched)
+    {
+        sim_bus_t bus = {.mux_channel = -1};
+        const bool ok = sched_check(&config, &bus);
+        printf("sched: %s\n", ok ? "bulk writes reassembled, realtime updates interleaved" : "FAILED");
+        rc = ok ? 0 : 1;
+    }
+    else
+    {
+        sim_trace_t trace = {0};
+        const bool loaded = trace_path ? trace_load(&trace, trace_path, config.slaves)
+                                       : trace_synth(&trace, config.slaves, params, rate_hz, seconds);
+        sim_bus_t bus = {.mux_channel = -1};
+        if (!loaded || !replay(&config, &trace, &bus))
+        {
+            rc = 1;
+        }
+        else
+        {
+            report(&config, &trace, &bus);
+            const size_t mismatches = verify(&config, &trace);
+            if (mismatches)
+            {
+                printf("verify: %s\n", mismatches == SIZE_MAX ? "readback failed" : "MISMATCH");
+                rc = 1;
+            }
+            else
+            {
+                printf("verify: final parameter values match the trace\n");
+            }
+        }
+        free(trace.events);
+    }
+
+    slaves_stop(config.slaves);
+    return rc;
+}
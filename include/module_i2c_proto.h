@@ -5,6 +5,8 @@
 #include <stddef.h>  // For size_t
 #include <stdbool.h> // For bool type
 #include "esp_err.h"
+#include "esp_attr.h"  // For IRAM_ATTR
+#include "sdkconfig.h"
 
 /**
  * @file module_i2c_proto.h
@@ -16,6 +18,33 @@
  * @note This is a shared component used by all ESPSynth modules and the Central Controller
  */
 
+/**
+ * @defgroup helper_linkage Helper Linkage
+ * @brief How the hot-path pack/unpack helpers are compiled
+ *
+ * Helpers declared with I2C_PROTO_HELPER are defined in
+ * module_i2c_proto_inline.h. By default they are ordinary functions in
+ * module_i2c_proto.c. CONFIG_I2C_PROTO_INLINE_HELPERS makes them static
+ * inline in every user instead, and CONFIG_I2C_PROTO_HELPERS_IN_IRAM puts
+ * them (and the lookup tables they read) in internal RAM so the I2C ISR
+ * does not stall on flash cache misses.
+ * @{
+ */
+#if CONFIG_I2C_PROTO_INLINE_HELPERS
+#define I2C_PROTO_HELPER              static inline
+#else
+#define I2C_PROTO_HELPER
+#endif
+
+#if CONFIG_I2C_PROTO_HELPERS_IN_IRAM
+#define I2C_PROTO_HELPER_ATTR         IRAM_ATTR /**< Placement of helper definitions */
+#define I2C_PROTO_TABLE_ATTR          DRAM_ATTR /**< Placement of the lookup tables */
+#else
+#define I2C_PROTO_HELPER_ATTR
+#define I2C_PROTO_TABLE_ATTR
+#endif
+/** @} */
+
 /**
  * @defgroup common_registers Common Registers
  * @brief Registers common to all module types
@@ -27,6 +56,20 @@
 #define REG_COMMON_I2S_CONFIG         0x03 /**< I2S configuration */
 #define REG_COMMON_SET_PARAM          0x04 /**< Set parameter */
 #define REG_COMMON_GET_PARAM          0x05 /**< Get parameter */
+#define REG_COMMON_SET_PARAM_BATCH    0x06 /**< Set several parameters in one write */
+#define REG_COMMON_SET_PARAM_COMPACT  0x07 /**< Set several parameters, values sized by param type */
+#define REG_COMMON_SET_PARAM_TIMED    0x08 /**< Set parameter at a given TDM frame */
+#define REG_COMMON_GET_PARAM_RANGE    0x09 /**< Read all parameters in an ID range */
+#define REG_COMMON_DIRTY_BITMAP       0x0A /**< Read (and clear) the bitmap of locally changed parameters */
+#define REG_COMMON_SET_PARAM_RAMP     0x0B /**< Glide a parameter to a target over a number of samples */
+#define REG_COMMON_GROUP_CONFIG       0x0C /**< Set the module's group membership mask */
+#define REG_COMMON_GROUP_WRITE        0x0D /**< Write addressed to a set of groups (sent to the general call address) */
+#define REG_COMMON_CRC_FRAME          0x0E /**< Frame of messages protected by a CRC-8 */
+#define REG_COMMON_PRESET_DELTA       0x0F /**< One chunk of a preset load, changed parameters only */
+#define REG_COMMON_IDENTITY           0x10 /**< Read type, version, status, parameter count and capabilities in one transfer */
+#define REG_COMMON_DIAG               0x11 /**< Read (and optionally clear) the counters of one command */
+#define REG_COMMON_I2S_STAGE          0x12 /**< Stage an I2S configuration without applying it */
+#define REG_COMMON_I2S_COMMIT         0x13 /**< Switch to the staged I2S configuration at a given TDM frame (groupable) */
 /** @} */
 
 /**
@@ -35,8 +78,17 @@
  * @{
  */
 #define CMD_COMMON_RESET              0xF0 /**< Reset module */
-#define CMD_COMMON_SAVE_SETTINGS      0xF1 /**< Save settings to NVS */
-#define CMD_COMMON_LOAD_SETTINGS      0xF2 /**< Load settings from NVS */
+#define CMD_COMMON_SAVE_SETTINGS      0xF1 /**< Save parameters changed since the last save to NVS, in the background (STATUS_BUSY) */
+#define CMD_COMMON_LOAD_SETTINGS      0xF2 /**< Load saved parameters from NVS, in the background (STATUS_BUSY) */
+/** @} */
+
+/**
+ * @defgroup proto_version Protocol Version
+ * @brief Reported through REG_COMMON_FIRMWARE_VERSION as {major, minor}
+ * @{
+ */
+#define I2C_PROTO_VERSION_MAJOR       2
+#define I2C_PROTO_VERSION_MINOR       7
 /** @} */
 
 /**
@@ -60,9 +112,34 @@
  */
 #define STATUS_INITIALIZED            (1 << 0) /**< Module is initialized */
 #define STATUS_ERROR                  (1 << 1) /**< Module has an error */
-#define STATUS_BUSY                   (1 << 2) /**< Module is busy processing */
+#define STATUS_BUSY                   (1 << 2) /**< Module is busy processing (e.g. a SAVE/LOAD_SETTINGS job is running) */
 #define STATUS_AUDIO_ACTIVE           (1 << 3) /**< Module is generating/processing audio */
-#define STATUS_PARAM_CHANGED          (1 << 4) /**< Parameter has changed */
+#define STATUS_PARAM_CHANGED          (1 << 4) /**< Parameter has changed locally; read REG_COMMON_DIRTY_BITMAP */
+#define STATUS_CRC_ERROR              (1 << 5) /**< A REG_COMMON_CRC_FRAME failed its check and was dropped; cleared by reading REG_COMMON_STATUS */
+/** @} */
+
+/**
+ * @defgroup capability_flags Capability Flags
+ * @brief Optional features reported in ModuleIdentity_t::capabilities
+ * @{
+ */
+#define I2C_PROTO_CAP_BATCH           (1 << 0) /**< REG_COMMON_SET_PARAM_BATCH */
+#define I2C_PROTO_CAP_COMPACT         (1 << 1) /**< REG_COMMON_SET_PARAM_COMPACT */
+#define I2C_PROTO_CAP_TIMED           (1 << 2) /**< REG_COMMON_SET_PARAM_TIMED */
+#define I2C_PROTO_CAP_RANGE_READ      (1 << 3) /**< REG_COMMON_GET_PARAM_RANGE */
+#define I2C_PROTO_CAP_DIRTY_BITMAP    (1 << 4) /**< REG_COMMON_DIRTY_BITMAP and STATUS_PARAM_CHANGED */
+#define I2C_PROTO_CAP_RAMP            (1 << 5) /**< REG_COMMON_SET_PARAM_RAMP */
+#define I2C_PROTO_CAP_GROUP           (1 << 6) /**< REG_COMMON_GROUP_CONFIG / REG_COMMON_GROUP_WRITE */
+#define I2C_PROTO_CAP_CRC             (1 << 7) /**< REG_COMMON_CRC_FRAME */
+#define I2C_PROTO_CAP_PRESET_DELTA    (1 << 8) /**< REG_COMMON_PRESET_DELTA */
+#define I2C_PROTO_CAP_ATTENTION       (1 << 9) /**< Attention line wired (module_i2c_proto_config_t::attention_gpio) */
+#define I2C_PROTO_CAP_DIAG            (1 << 10) /**< REG_COMMON_DIAG (CONFIG_I2C_PROTO_STATS) */
+#define I2C_PROTO_CAP_I2S_STAGED      (1 << 11) /**< REG_COMMON_I2S_STAGE / REG_COMMON_I2S_COMMIT */
+/** Everything this version of the slave runtime always implements (I2C_PROTO_CAP_ATTENTION and _DIAG depend on the build) */
+#define I2C_PROTO_CAPS_RUNTIME        (I2C_PROTO_CAP_BATCH | I2C_PROTO_CAP_COMPACT | I2C_PROTO_CAP_TIMED | \
+                                       I2C_PROTO_CAP_RANGE_READ | I2C_PROTO_CAP_DIRTY_BITMAP | I2C_PROTO_CAP_RAMP | \
+                                       I2C_PROTO_CAP_GROUP | I2C_PROTO_CAP_CRC | I2C_PROTO_CAP_PRESET_DELTA | \
+                                       I2C_PROTO_CAP_I2S_STAGED)
 /** @} */
 
 /**
@@ -90,56 +167,1709 @@
 /** @} */
 
 /**
- * @brief Initialize the I2C protocol handler
- * 
- * @param module_type The module type identifier
- * @param default_address Default I2C address to use if not found in NVS
- * @return ESP_OK if initialization is successful, error code otherwise
+ * @defgroup param_table Parameter Table
+ * @brief Type, range and storage of every known parameter ID
+ *
+ * I2C_PROTO_PARAM_LIST is an X-macro: each entry is X(id, type, min, max)
+ * where type is one of U8, U16, S16 or U32 and [min, max] is the accepted
+ * value range. Module and Central Controller firmware share this list, so it
+ * is the single place a new parameter has to be added; the descriptor table,
+ * the ID lookup and the slave's parameter storage are all generated from it.
+ * Keep entries in ascending ID order; range reads walk the table in order.
+ * @{
  */
-esp_err_t module_i2c_proto_init(uint8_t module_type, uint8_t default_address);
+#define I2C_PROTO_PARAM_LIST(X)                                   \
+    X(PARAM_OSC_WAVEFORM,         U8,  0,      UINT8_MAX)         \
+    X(PARAM_OSC_PITCH_MIDI,       U8,  0,      127)               \
+    X(PARAM_OSC_PITCH_FIXED_HZ,   U32, 0,      UINT32_MAX)        \
+    X(PARAM_OSC_LEVEL_U16,        U16, 0,      UINT16_MAX)        \
+    X(PARAM_OSC_PW_U16,           U16, 0,      UINT16_MAX)        \
+    X(PARAM_OSC_DETUNE_S16,       S16, -8192,  8191)              \
+    X(PARAM_FILTER_TYPE,          U8,  0,      UINT8_MAX)         \
+    X(PARAM_FILTER_CUTOFF_U16,    U16, 0,      UINT16_MAX)        \
+    X(PARAM_FILTER_RESONANCE_U16, U16, 0,      UINT16_MAX)        \
+    X(PARAM_FILTER_GAIN_S16,      S16, -8192,  8191)
+
+#define I2C_PROTO_PARAM_ID_SPACE      0x100 /**< Parameter IDs covered by the table (0x00-0xFF) */
 
 /**
- * @brief Process an incoming I2C command
- * 
- * @param cmd_buffer Pointer to the command buffer
- * @param cmd_len Length of the command data
- * @param[out] resp_buffer Pointer to the response buffer
- * @param[in,out] resp_len Maximum length of response buffer on input, actual response length on output
- * @return ESP_OK if command processed successfully, error code otherwise
+ * @brief Wire type of a parameter value
  */
-esp_err_t module_i2c_proto_process_command(const uint8_t *cmd_buffer, size_t cmd_len, 
-                                          uint8_t *resp_buffer, size_t *resp_len);
+typedef enum {
+    PARAM_TYPE_NONE = 0, /**< Unknown parameter */
+    PARAM_TYPE_U8,       /**< uint8_t, 1 byte in compact frames */
+    PARAM_TYPE_U16,      /**< uint16_t, 2 bytes in compact frames */
+    PARAM_TYPE_S16,      /**< int16_t, 2 bytes in compact frames */
+    PARAM_TYPE_U32,      /**< uint32_t, 4 bytes in compact frames */
+} ParamType_t;
+
+/** @cond INTERNAL */
+#define I2C_PROTO_CTYPE_U8            uint8_t
+#define I2C_PROTO_CTYPE_U16           uint16_t
+#define I2C_PROTO_CTYPE_S16           int16_t
+#define I2C_PROTO_CTYPE_U32           uint32_t
+#define I2C_PROTO_PARAM_ENUM_(name, ptype, lo, hi)  I2C_PROTO_PARAM_IDX_##name,
+#define I2C_PROTO_PARAM_FIELD_(name, ptype, lo, hi) I2C_PROTO_CTYPE_##ptype name##_value;
+#define I2C_PROTO_PARAM_TYPE_(name, ptype, lo, hi)  I2C_PROTO_PARAM_TYPE_##name = PARAM_TYPE_##ptype,
+/** @endcond */
 
 /**
- * @brief Set a parameter value
- * 
- * @param param_id The parameter identifier
- * @param value Pointer to the parameter value data
- * @param value_len Length of the parameter value data
- * @return ESP_OK if parameter set successfully, error code otherwise
+ * @brief Dense index of every parameter, in I2C_PROTO_PARAM_LIST order
+ *
+ * I2C_PROTO_PARAM_IDX_<name> is the position of PARAM_<name> in the
+ * descriptor table, e.g. I2C_PROTO_PARAM_IDX_PARAM_OSC_LEVEL_U16.
  */
-esp_err_t module_i2c_proto_set_param(uint8_t param_id, const void *value, size_t value_len);
+enum {
+    I2C_PROTO_PARAM_LIST(I2C_PROTO_PARAM_ENUM_)
+    I2C_PROTO_PARAM_COUNT /**< Number of known parameters */
+};
 
 /**
- * @brief Get a parameter value
- * 
- * @param param_id The parameter identifier
- * @param[out] value Pointer to store the parameter value
- * @param[in,out] value_len Maximum length of value buffer on input, actual parameter length on output
- * @return ESP_OK if parameter retrieved successfully, error code otherwise
+ * @brief ParamType_t of every parameter as a constant expression
+ *
+ * I2C_PROTO_PARAM_TYPE_<name> is the type of PARAM_<name>, e.g.
+ * I2C_PROTO_PARAM_TYPE_PARAM_OSC_LEVEL_U16 == PARAM_TYPE_U16. The typed
+ * accessors (MODULE_I2C_PROTO_GET_U16() etc.) check against it at compile time.
  */
-esp_err_t module_i2c_proto_get_param(uint8_t param_id, void *value, size_t *value_len);
+enum {
+    I2C_PROTO_PARAM_LIST(I2C_PROTO_PARAM_TYPE_)
+};
+
+#define I2C_PROTO_PARAM_BITMAP_WORDS  ((I2C_PROTO_PARAM_COUNT + 31) / 32) /**< uint32_t words in a bitmap with one bit per parameter index */
+#define I2C_PROTO_DIRTY_BITMAP_LEN    ((I2C_PROTO_PARAM_COUNT + 7) / 8) /**< Bytes returned by REG_COMMON_DIRTY_BITMAP; bit i of byte i / 8 is parameter index i */
 
 /**
- * @brief Register parameter change callback
- * 
- * @param param_id Parameter ID to monitor
- * @param callback Function to call when parameter changes
- * @param user_data User data to pass to the callback
- * @return ESP_OK if callback registered successfully, error code otherwise
+ * @brief Storage for every parameter's current value on the slave
+ *
+ * One field named <PARAM_NAME>_value per entry, of the parameter's C type.
  */
-esp_err_t module_i2c_proto_register_param_callback(uint8_t param_id, 
-                                                 void (*callback)(void *user_data, const void *value, size_t value_len), 
-                                                 void *user_data);
+typedef struct {
+    I2C_PROTO_PARAM_LIST(I2C_PROTO_PARAM_FIELD_)
+} module_i2c_proto_params_t;
+
+/** @cond INTERNAL */
+extern module_i2c_proto_params_t i2c_proto_param_values; // Slave parameter storage, read through MODULE_I2C_PROTO_GET_*()
+/** @endcond */
+
+/**
+ * @brief Static description of one parameter
+ */
+typedef struct {
+    uint16_t id;     /**< Parameter ID (ParamId_t) */
+    uint8_t  type;   /**< ParamType_t of the value */
+    uint8_t  width;  /**< Value size in bytes */
+    uint16_t offset; /**< Offset of the value in module_i2c_proto_params_t */
+    int64_t  min;    /**< Smallest accepted value */
+    int64_t  max;    /**< Largest accepted value */
+} ParamDescriptor_t;
+
+/**
+ * @brief Descriptor of every known parameter, indexed by I2C_PROTO_PARAM_IDX_*
+ */
+extern const ParamDescriptor_t i2c_proto_param_descriptors[I2C_PROTO_PARAM_COUNT];
+
+/** @cond INTERNAL */
+extern const uint8_t i2c_proto_param_index[I2C_PROTO_PARAM_ID_SPACE]; // Descriptor index + 1 by ID, 0 = unknown
+extern const uint8_t i2c_proto_param_type_widths[PARAM_TYPE_U32 + 1];  // Compact value bytes by ParamType_t
+/** @endcond */
+/** @} */
+
+/**
+ * @defgroup proto_types Protocol Data Types
+ * @brief Payload types carried after the command/register byte
+ *
+ * The payload structs mirror the wire layout exactly: they are packed (no
+ * padding) and every multi-byte field is little-endian on the wire,
+ * whatever the byte order of the MCU. The sizes and offsets below are part
+ * of the protocol and checked at compile time. The helpers write and read
+ * fields byte by byte with i2c_proto_wr_le16()/i2c_proto_rd_le16() and
+ * friends, so a module on another MCU (e.g. an RP2040) only needs this
+ * header; never memcpy a payload struct to or from the bus.
+ * @{
+ */
+
+/** @cond INTERNAL */
+#define I2C_PROTO_PACKED              __attribute__((packed))
+#ifdef __cplusplus
+#define I2C_PROTO_STATIC_ASSERT(cond, msg) static_assert(cond, msg)
+#else
+#define I2C_PROTO_STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)
+#endif
+/** @endcond */
+
+/**
+ * @brief Parameter identifier (see the PARAM_* ranges above)
+ */
+typedef uint16_t ParamId_t;
+
+/**
+ * @brief Parameter value, interpreted according to the ParamId_t
+ *
+ * On the wire the value is the little-endian encoding of u32. Fill it
+ * through u32 (or s32 for signed parameters) so that narrower values end up
+ * in the low bytes on any MCU.
+ */
+typedef union {
+    uint32_t u32;    /**< Unsigned 32-bit value */
+    int32_t  s32;    /**< Signed 32-bit value */
+    uint16_t u16[2]; /**< Unsigned 16-bit value(s), [0] for single-value params */
+    int16_t  s16[2]; /**< Signed 16-bit value(s), [0] for single-value params */
+    uint8_t  u8[4];  /**< Unsigned 8-bit value(s), [0] for single-value params */
+} ParamValue_t;
+
+/**
+ * @brief Payload of REG_COMMON_SET_PARAM (6 bytes)
+ *
+ * | Offset | Size | Field       |
+ * |--------|------|-------------|
+ * | 0      | 2    | param_id    |
+ * | 2      | 4    | param_value |
+ */
+typedef struct I2C_PROTO_PACKED {
+    ParamId_t    param_id;    /**< Target parameter */
+    ParamValue_t param_value; /**< New value */
+} SetParamPayload_t;
+
+/**
+ * @brief Payload of REG_COMMON_SET_PARAM_TIMED
+ *
+ * frame is a free-running 32-bit count of TDM frames on the shared I2S bus
+ * (one frame carries every slot of I2sConfig_t once). All modules count the
+ * same frame clock, so the change lands on the same sample everywhere.
+ * Frames compare modulo 2^32. A slave holding MODULE_I2C_PROTO_TIMED_LEN
+ * timed writes that have not reached their frame yet rejects further ones
+ * (ESP_ERR_NO_MEM, counted as an error in the REG_COMMON_DIAG statistics)
+ * rather than applying them early.
+ *
+ * | Offset | Size | Field |
+ * |--------|------|-------|
+ * | 0      | 4    | frame |
+ * | 4      | 6    | param |
+ */
+typedef struct I2C_PROTO_PACKED {
+    uint32_t          frame; /**< TDM frame at which the value takes effect */
+    SetParamPayload_t param; /**< Parameter and value */
+} TimedSetParamPayload_t;
+
+/**
+ * @brief Payload of REG_COMMON_GET_PARAM_RANGE
+ *
+ * Use first = 0x0000, last = 0xFFFF to dump every parameter of a module.
+ *
+ * | Offset | Size | Field |
+ * |--------|------|-------|
+ * | 0      | 2    | first |
+ * | 2      | 2    | last  |
+ */
+typedef struct I2C_PROTO_PACKED {
+    ParamId_t first; /**< Lowest parameter ID to return */
+    ParamId_t last;  /**< Highest parameter ID to return */
+} GetParamRangePayload_t;
+
+/**
+ * @brief Payload of REG_COMMON_SET_PARAM_RAMP (10 bytes)
+ *
+ * The slave moves the parameter linearly from its current value to target
+ * over ramp_samples audio frames, updating it once per audio block (see
+ * module_i2c_proto_ramp_process()). One message per gesture replaces a
+ * stream of SET_PARAM writes. ramp_samples = 0 sets target immediately; a
+ * later SET_PARAM, SET_PARAM_TIMED or ramp for the same parameter replaces
+ * a ramp in progress.
+ *
+ * | Offset | Size | Field        |
+ * |--------|------|--------------|
+ * | 0      | 2    | param_id     |
+ * | 2      | 4    | target       |
+ * | 6      | 4    | ramp_samples |
+ */
+typedef struct I2C_PROTO_PACKED {
+    ParamId_t    param_id;     /**< Target parameter */
+    ParamValue_t target;       /**< Value at the end of the ramp */
+    uint32_t     ramp_samples; /**< Ramp length in audio frames */
+} RampParamPayload_t;
+
+#define I2S_SLOT_NONE                 0xFF /**< TDM slot not assigned */
+
+/**
+ * @brief Payload of REG_COMMON_I2S_CONFIG (2 bytes)
+ *
+ * | Offset | Size | Field        |
+ * |--------|------|--------------|
+ * | 0      | 1    | tdm_slot_in  |
+ * | 1      | 1    | tdm_slot_out |
+ */
+typedef struct I2C_PROTO_PACKED {
+    uint8_t tdm_slot_in;  /**< TDM slot the module reads audio from (I2S_SLOT_NONE if unused) */
+    uint8_t tdm_slot_out; /**< TDM slot the module writes audio to (I2S_SLOT_NONE if unused) */
+} I2sConfig_t;
+
+/**
+ * @brief Payload of REG_COMMON_I2S_COMMIT (4 bytes)
+ *
+ * Re-routing in two phases: each module first gets its new slots with
+ * REG_COMMON_I2S_STAGE (payload I2sConfig_t), which changes nothing yet.
+ * One REG_COMMON_I2S_COMMIT, usually as a group write to every module, then
+ * names the TDM frame (same clock as REG_COMMON_SET_PARAM_TIMED) from which
+ * the staged slots are used. The audio task picks the switch up with
+ * module_i2c_proto_next_i2s_switch() and changes slots inside a running
+ * stream, so I2S is never stopped. A commit without a staged configuration
+ * is ignored; a later commit replaces one that is not yet due.
+ *
+ * | Offset | Size | Field |
+ * |--------|------|-------|
+ * | 0      | 4    | frame |
+ */
+typedef struct I2C_PROTO_PACKED {
+    uint32_t frame; /**< First TDM frame using the staged slots */
+} I2sCommitPayload_t;
+
+/**
+ * @brief Response to REG_COMMON_IDENTITY (10 bytes)
+ *
+ * Replaces separate MODULE_TYPE, FIRMWARE_VERSION and STATUS reads at
+ * enumeration. status is the current REG_COMMON_STATUS value, but reading it
+ * here does not clear STATUS_CRC_ERROR. Decode with i2c_proto_unpack_identity().
+ *
+ * | Offset | Size | Field         |
+ * |--------|------|---------------|
+ * | 0      | 1    | module_type   |
+ * | 1      | 1    | version_major |
+ * | 2      | 1    | version_minor |
+ * | 3      | 1    | status        |
+ * | 4      | 2    | param_count   |
+ * | 6      | 4    | capabilities  |
+ */
+typedef struct I2C_PROTO_PACKED {
+    uint8_t  module_type;   /**< MODULE_TYPE_* */
+    uint8_t  version_major; /**< I2C_PROTO_VERSION_MAJOR of the module */
+    uint8_t  version_minor; /**< I2C_PROTO_VERSION_MINOR of the module */
+    uint8_t  status;        /**< STATUS_* flags */
+    uint16_t param_count;   /**< Entries in the module's parameter table */
+    uint32_t capabilities;  /**< I2C_PROTO_CAP_* flags */
+} ModuleIdentity_t;
+
+/**
+ * @brief Payload of REG_COMMON_DIAG (2 bytes)
+ *
+ * | Offset | Size | Field |
+ * |--------|------|-------|
+ * | 0      | 1    | cmd   |
+ * | 1      | 1    | flags |
+ */
+typedef struct I2C_PROTO_PACKED {
+    uint8_t cmd;   /**< Command whose counters to read, I2C_PROTO_DIAG_UNPARSED for undecodable input */
+    uint8_t flags; /**< I2C_PROTO_DIAG_* flags */
+} DiagRequestPayload_t;
+
+#define I2C_PROTO_DIAG_CLEAR          (1 << 0) /**< Zero the counters after reporting them */
+#define I2C_PROTO_DIAG_UNPARSED       0xFF     /**< Counters of input that did not split into messages (unknown command, truncation) */
+#define I2C_PROTO_DIAG_BUCKETS        8        /**< Latency histogram buckets */
+#define I2C_PROTO_DIAG_BUCKET_SHIFT   9        /**< Bucket 0 counts messages under 2^9 cycles; the last one everything from 2^15 on */
+
+/**
+ * @brief Counters of one command, as returned by REG_COMMON_DIAG (56 bytes)
+ *
+ * Cycles are CPU cycles spent handling a message in
+ * module_i2c_proto_process_command() (nanoseconds in host builds). Bucket b
+ * of the histogram counts messages taking 2^(8+b) to 2^(9+b) cycles, with
+ * bucket 0 open below and the last bucket open above. The 32-bit counters
+ * wrap; take differences of two reads for rates and averages
+ * (cycles_total / messages).
+ *
+ * | Offset | Size | Field         |
+ * |--------|------|---------------|
+ * | 0      | 4    | messages      |
+ * | 4      | 4    | bytes         |
+ * | 8      | 4    | errors        |
+ * | 12     | 4    | decode_errors |
+ * | 16     | 4    | cycles_max    |
+ * | 20     | 4    | cycles_total  |
+ * | 24     | 32   | histogram     |
+ */
+typedef struct I2C_PROTO_PACKED {
+    uint32_t messages;                             /**< Messages handled */
+    uint32_t bytes;                                /**< Message bytes, command byte included */
+    uint32_t errors;                               /**< Messages whose handling failed */
+    uint32_t decode_errors;                        /**< Of those, malformed payloads (ESP_ERR_INVALID_ARG/_SIZE/_CRC) */
+    uint32_t cycles_max;                           /**< Slowest message since the last clear */
+    uint32_t cycles_total;                         /**< Sum over all messages */
+    uint32_t histogram[I2C_PROTO_DIAG_BUCKETS];    /**< Messages per latency bucket */
+} DiagStats_t;
+
+I2C_PROTO_STATIC_ASSERT(sizeof(ParamValue_t) == 4, "ParamValue_t must be 4 bytes on the wire");
+I2C_PROTO_STATIC_ASSERT(sizeof(SetParamPayload_t) == 6, "SetParamPayload_t wire size");
+I2C_PROTO_STATIC_ASSERT(offsetof(SetParamPayload_t, param_id) == 0, "SetParamPayload_t layout");
+I2C_PROTO_STATIC_ASSERT(offsetof(SetParamPayload_t, param_value) == 2, "SetParamPayload_t layout");
+I2C_PROTO_STATIC_ASSERT(sizeof(TimedSetParamPayload_t) == 10, "TimedSetParamPayload_t wire size");
+I2C_PROTO_STATIC_ASSERT(offsetof(TimedSetParamPayload_t, frame) == 0, "TimedSetParamPayload_t layout");
+I2C_PROTO_STATIC_ASSERT(offsetof(TimedSetParamPayload_t, param) == 4, "TimedSetParamPayload_t layout");
+I2C_PROTO_STATIC_ASSERT(sizeof(GetParamRangePayload_t) == 4, "GetParamRangePayload_t wire size");
+I2C_PROTO_STATIC_ASSERT(offsetof(GetParamRangePayload_t, first) == 0, "GetParamRangePayload_t layout");
+I2C_PROTO_STATIC_ASSERT(offsetof(GetParamRangePayload_t, last) == 2, "GetParamRangePayload_t layout");
+I2C_PROTO_STATIC_ASSERT(sizeof(RampParamPayload_t) == 10, "RampParamPayload_t wire size");
+I2C_PROTO_STATIC_ASSERT(offsetof(RampParamPayload_t, param_id) == 0, "RampParamPayload_t layout");
+I2C_PROTO_STATIC_ASSERT(offsetof(RampParamPayload_t, target) == 2, "RampParamPayload_t layout");
+I2C_PROTO_STATIC_ASSERT(offsetof(RampParamPayload_t, ramp_samples) == 6, "RampParamPayload_t layout");
+I2C_PROTO_STATIC_ASSERT(sizeof(I2sConfig_t) == 2, "I2sConfig_t wire size");
+I2C_PROTO_STATIC_ASSERT(offsetof(I2sConfig_t, tdm_slot_in) == 0, "I2sConfig_t layout");
+I2C_PROTO_STATIC_ASSERT(offsetof(I2sConfig_t, tdm_slot_out) == 1, "I2sConfig_t layout");
+I2C_PROTO_STATIC_ASSERT(sizeof(I2sCommitPayload_t) == 4, "I2sCommitPayload_t wire size");
+I2C_PROTO_STATIC_ASSERT(sizeof(ModuleIdentity_t) == 10, "ModuleIdentity_t wire size");
+I2C_PROTO_STATIC_ASSERT(offsetof(ModuleIdentity_t, param_count) == 4, "ModuleIdentity_t layout");
+I2C_PROTO_STATIC_ASSERT(offsetof(ModuleIdentity_t, capabilities) == 6, "ModuleIdentity_t layout");
+I2C_PROTO_STATIC_ASSERT(sizeof(DiagRequestPayload_t) == 2, "DiagRequestPayload_t wire size");
+I2C_PROTO_STATIC_ASSERT(sizeof(DiagStats_t) == 56, "DiagStats_t wire size");
+I2C_PROTO_STATIC_ASSERT(offsetof(DiagStats_t, histogram) == 24, "DiagStats_t layout");
+
+/** @} */
+
+/**
+ * @defgroup batch_frames Batched Parameter Frames
+ * @brief Layout of REG_COMMON_SET_PARAM_BATCH
+ *
+ * A batch frame is the command byte, a count byte and `count` entries of
+ * I2C_PROTO_BATCH_ENTRY_LEN bytes each. Every entry has the layout of a
+ * SetParamPayload_t.
+ * @{
+ */
+#define I2C_PROTO_BATCH_ENTRY_LEN     sizeof(SetParamPayload_t) /**< Bytes per batch entry */
+#define I2C_PROTO_BATCH_MAX_PARAMS    40 /**< Maximum entries in one batch frame */
+#define I2C_PROTO_BATCH_MAX_FRAME_LEN (2 + I2C_PROTO_BATCH_MAX_PARAMS * I2C_PROTO_BATCH_ENTRY_LEN) /**< Largest batch frame, command byte included */
+
+/**
+ * @brief Read cursor over the entries of a received batch payload
+ *
+ * Entries are decoded straight out of the receive buffer, so the buffer must
+ * stay valid while the iterator is in use.
+ */
+typedef struct {
+    const uint8_t *cursor; /**< Next entry to decode */
+    uint8_t remaining;     /**< Entries left after cursor */
+} i2c_proto_batch_iter_t;
+/** @} */
+
+/**
+ * @defgroup compact_frames Compact Parameter Frames
+ * @brief Layout of REG_COMMON_SET_PARAM_COMPACT
+ *
+ * Same framing as a batch (command byte, count byte, entries), but each entry
+ * is a little-endian ParamId_t followed by only as many little-endian value
+ * bytes as the parameter's ParamType_t needs. Only IDs present in
+ * I2C_PROTO_PARAM_LIST can be sent this way. Decoded values are zero- or
+ * sign-extended to 32 bits. Compact payloads are walked with the same
+ * i2c_proto_batch_iter_t as batch payloads.
+ * @{
+ */
+#define I2C_PROTO_COMPACT_MAX_ENTRY_LEN (sizeof(ParamId_t) + sizeof(uint32_t)) /**< Largest compact entry */
+
+/**
+ * @brief Response to REG_COMMON_GET_PARAM_RANGE
+ *
+ * A count byte, a "more" byte and `count` compact entries for the known
+ * parameters in the range, in ascending ID order. "more" is non-zero if the
+ * slave ran out of response space; the master then asks again starting at
+ * the ID after the last entry. Bytes after the last entry are ignored, so the
+ * master can simply read a fixed-size block.
+ */
+#define I2C_PROTO_RANGE_RESP_HEADER_LEN 2 /**< Count + more byte */
+/** @} */
+
+/**
+ * @defgroup group_writes Group Writes
+ * @brief Layout of REG_COMMON_GROUP_CONFIG and REG_COMMON_GROUP_WRITE
+ *
+ * Each module belongs to the groups whose bits are set in the mask last
+ * written to REG_COMMON_GROUP_CONFIG (one byte, 0 after init). A group write
+ * is the command byte, a group mask byte and exactly one inner write message;
+ * every module sharing a group with the mask applies the inner message, and a
+ * mask of I2C_PROTO_GROUP_ALL reaches every module. The master sends it once
+ * to I2C_PROTO_GENERAL_CALL_ADDR, with every mux channel that holds a group
+ * member enabled (a TCA9548A-style mux takes a channel bitmask), instead of
+ * once per module. Only messages that need no response can be wrapped, see
+ * i2c_proto_group_write_allowed().
+ * @{
+ */
+#define I2C_PROTO_GENERAL_CALL_ADDR   0x00 /**< I2C general call address group writes are sent to */
+#define I2C_PROTO_GROUP_ALL           0x00 /**< Group write mask reaching every module */
+#define I2C_PROTO_GROUP_HEADER_LEN    2    /**< Command + mask byte before the inner message */
+/** @} */
+
+/**
+ * @defgroup preset_delta Preset Delta Frames
+ * @brief Layout of REG_COMMON_PRESET_DELTA
+ *
+ * The command byte, a flags byte, a count byte and `count` compact entries
+ * (see compact_frames). A preset load is a sequence of such chunks holding
+ * only the parameters whose values differ from what the module already has;
+ * the master works that out from a shadow of acknowledged values, see
+ * i2c_proto_pack_preset_delta() in module_i2c_proto_master.h. count may be 0
+ * when nothing (more) differs. The chunk flagged I2C_PROTO_PRESET_LAST runs
+ * the module's command callback with REG_COMMON_PRESET_DELTA once its entries
+ * are applied.
+ * @{
+ */
+#define I2C_PROTO_PRESET_FIRST        (1 << 0) /**< First chunk of a preset load */
+#define I2C_PROTO_PRESET_LAST         (1 << 1) /**< Last chunk of a preset load */
+#define I2C_PROTO_PRESET_HEADER_LEN   3        /**< Command + flags + count byte */
+/** @} */
+
+/**
+ * @defgroup crc_frames CRC-Protected Frames
+ * @brief Layout of REG_COMMON_CRC_FRAME
+ *
+ * The command byte, a length byte, a CRC byte and `length` bytes holding one
+ * or more complete messages. The CRC is CRC-8 (polynomial 0x07, initial value
+ * 0, no reflection, as used by SMBus PEC) over the length byte and the
+ * messages, so one check covers a whole batch. A slave drops a frame that
+ * fails the check without applying any of it, returns ESP_ERR_INVALID_CRC and
+ * sets STATUS_CRC_ERROR; the master reads REG_COMMON_STATUS after sending and
+ * retransmits just that frame if the flag is set.
+ * @{
+ */
+#define I2C_PROTO_CRC_HEADER_LEN      3 /**< Command + length + CRC byte */
+#define I2C_PROTO_CRC_MAX_INNER_LEN   (I2C_PROTO_MAX_FRAME_LEN - I2C_PROTO_CRC_HEADER_LEN) /**< Largest protected frame */
+/** @} */
+
+/**
+ * @defgroup frame_builder Frame Builder
+ * @brief Incremental assembly of several messages into one write
+ *
+ * A frame is a sequence of complete messages sent back to back in a single
+ * I2C write; the slave splits it again with i2c_proto_msg_len(). Consecutive
+ * parameters are folded into one REG_COMMON_SET_PARAM_BATCH message, so the
+ * command byte is only emitted when the message type changes or a batch is
+ * full.
+ * @{
+ */
+#define I2C_PROTO_MAX_FRAME_LEN       256 /**< Largest write a slave is expected to accept */
+
+/**
+ * @brief Frame builder state, valid between begin and finish
+ */
+typedef struct {
+    uint8_t *buf;         /**< Caller-owned frame buffer (e.g. DMA-capable memory) */
+    size_t cap;           /**< Size of buf */
+    size_t len;           /**< Bytes written so far */
+    uint8_t *batch_count; /**< Count byte of the batch being extended, NULL if none is open */
+} i2c_proto_frame_builder_t;
+/** @} */
+
+/**
+ * @defgroup decode_views Decode Views
+ * @brief Read-only access to received payloads without copying them
+ *
+ * A view is validated once against the received length and then reads its
+ * fields straight out of the receive buffer through the little-endian
+ * accessors below, which are safe for any alignment. The buffer must stay
+ * valid and unchanged while the view is in use. Value fields are exposed as
+ * a pointer to their little-endian bytes; the slave decodes them by
+ * parameter width straight into the parameter block, so no intermediate
+ * payload struct is built and any MCU byte order works.
+ * @{
+ */
+
+/**
+ * @brief Read a little-endian uint16_t from a possibly unaligned address
+ */
+static inline uint16_t i2c_proto_rd_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/**
+ * @brief Read a little-endian uint32_t from a possibly unaligned address
+ */
+static inline uint32_t i2c_proto_rd_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Write a uint16_t as little-endian bytes to a possibly unaligned address
+ */
+static inline void i2c_proto_wr_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+/**
+ * @brief Write a uint32_t as little-endian bytes to a possibly unaligned address
+ */
+static inline void i2c_proto_wr_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/**
+ * @brief View of a REG_COMMON_SET_PARAM payload
+ */
+typedef struct {
+    const uint8_t *payload; /**< Start of the payload in the receive buffer */
+} i2c_proto_set_param_view_t;
+
+/**
+ * @brief View of a REG_COMMON_SET_PARAM_TIMED payload
+ */
+typedef struct {
+    const uint8_t *payload; /**< Start of the payload in the receive buffer */
+} i2c_proto_set_param_timed_view_t;
+
+/**
+ * @brief View of a REG_COMMON_I2S_CONFIG payload
+ */
+typedef struct {
+    const uint8_t *payload; /**< Start of the payload in the receive buffer */
+} i2c_proto_i2s_config_view_t;
+
+/**
+ * @brief View of a REG_COMMON_GET_PARAM_RANGE payload
+ */
+typedef struct {
+    const uint8_t *payload; /**< Start of the payload in the receive buffer */
+} i2c_proto_get_param_range_view_t;
+
+/**
+ * @brief View of a REG_COMMON_SET_PARAM_RAMP payload
+ */
+typedef struct {
+    const uint8_t *payload; /**< Start of the payload in the receive buffer */
+} i2c_proto_set_param_ramp_view_t;
+
+/**
+ * @brief One entry of a batch or compact payload, as produced by the *_iter_next_view() functions
+ */
+typedef struct {
+    ParamId_t param_id;   /**< Parameter ID */
+    const uint8_t *value; /**< Little-endian value bytes in the receive buffer */
+    uint8_t width;        /**< Value bytes at value (4 for batch entries) */
+} i2c_proto_param_entry_view_t;
+
+/** @brief Parameter ID of a SET_PARAM view */
+static inline ParamId_t i2c_proto_set_param_view_id(i2c_proto_set_param_view_t view)
+{
+    return i2c_proto_rd_le16(view.payload + offsetof(SetParamPayload_t, param_id));
+}
+
+/** @brief Little-endian value bytes of a SET_PARAM view (sizeof(ParamValue_t) of them) */
+static inline const uint8_t *i2c_proto_set_param_view_value(i2c_proto_set_param_view_t view)
+{
+    return view.payload + offsetof(SetParamPayload_t, param_value);
+}
+
+/** @brief Target frame of a SET_PARAM_TIMED view */
+static inline uint32_t i2c_proto_set_param_timed_view_frame(i2c_proto_set_param_timed_view_t view)
+{
+    return i2c_proto_rd_le32(view.payload + offsetof(TimedSetParamPayload_t, frame));
+}
+
+/** @brief Parameter ID of a SET_PARAM_TIMED view */
+static inline ParamId_t i2c_proto_set_param_timed_view_id(i2c_proto_set_param_timed_view_t view)
+{
+    return i2c_proto_rd_le16(view.payload + offsetof(TimedSetParamPayload_t, param.param_id));
+}
+
+/** @brief Little-endian value bytes of a SET_PARAM_TIMED view (sizeof(ParamValue_t) of them) */
+static inline const uint8_t *i2c_proto_set_param_timed_view_value(i2c_proto_set_param_timed_view_t view)
+{
+    return view.payload + offsetof(TimedSetParamPayload_t, param.param_value);
+}
+
+/** @brief Input slot of an I2S_CONFIG view */
+static inline uint8_t i2c_proto_i2s_config_view_slot_in(i2c_proto_i2s_config_view_t view)
+{
+    return view.payload[offsetof(I2sConfig_t, tdm_slot_in)];
+}
+
+/** @brief Output slot of an I2S_CONFIG view */
+static inline uint8_t i2c_proto_i2s_config_view_slot_out(i2c_proto_i2s_config_view_t view)
+{
+    return view.payload[offsetof(I2sConfig_t, tdm_slot_out)];
+}
+
+/** @brief First ID of a GET_PARAM_RANGE view */
+static inline ParamId_t i2c_proto_get_param_range_view_first(i2c_proto_get_param_range_view_t view)
+{
+    return i2c_proto_rd_le16(view.payload + offsetof(GetParamRangePayload_t, first));
+}
+
+/** @brief Last ID of a GET_PARAM_RANGE view */
+static inline ParamId_t i2c_proto_get_param_range_view_last(i2c_proto_get_param_range_view_t view)
+{
+    return i2c_proto_rd_le16(view.payload + offsetof(GetParamRangePayload_t, last));
+}
+
+/** @brief Parameter ID of a SET_PARAM_RAMP view */
+static inline ParamId_t i2c_proto_set_param_ramp_view_id(i2c_proto_set_param_ramp_view_t view)
+{
+    return i2c_proto_rd_le16(view.payload + offsetof(RampParamPayload_t, param_id));
+}
+
+/** @brief Little-endian target value bytes of a SET_PARAM_RAMP view (sizeof(ParamValue_t) of them) */
+static inline const uint8_t *i2c_proto_set_param_ramp_view_target(i2c_proto_set_param_ramp_view_t view)
+{
+    return view.payload + offsetof(RampParamPayload_t, target);
+}
+
+/** @brief Ramp length of a SET_PARAM_RAMP view */
+static inline uint32_t i2c_proto_set_param_ramp_view_samples(i2c_proto_set_param_ramp_view_t view)
+{
+    return i2c_proto_rd_le32(view.payload + offsetof(RampParamPayload_t, ramp_samples));
+}
+
+/** @brief Value of a PARAM_TYPE_U8 entry */
+static inline uint8_t i2c_proto_entry_view_u8(const i2c_proto_param_entry_view_t *entry)
+{
+    return entry->value[0];
+}
+
+/** @brief Value of a PARAM_TYPE_U16 entry */
+static inline uint16_t i2c_proto_entry_view_u16(const i2c_proto_param_entry_view_t *entry)
+{
+    return i2c_proto_rd_le16(entry->value);
+}
+
+/** @brief Value of a PARAM_TYPE_S16 entry */
+static inline int16_t i2c_proto_entry_view_s16(const i2c_proto_param_entry_view_t *entry)
+{
+    return (int16_t)i2c_proto_rd_le16(entry->value);
+}
+
+/** @brief Value of a PARAM_TYPE_U32 entry */
+static inline uint32_t i2c_proto_entry_view_u32(const i2c_proto_param_entry_view_t *entry)
+{
+    return i2c_proto_rd_le32(entry->value);
+}
+
+/**
+ * @brief Validate a REG_COMMON_SET_PARAM payload and view it in place
+ *
+ * @param payload_buf Received payload (command byte already stripped)
+ * @param payload_len Length of payload_buf
+ * @param[out] view View over payload_buf
+ * @return true if the payload has the right length, false otherwise
+ */
+I2C_PROTO_HELPER bool i2c_proto_view_set_param(const uint8_t *payload_buf, size_t payload_len, i2c_proto_set_param_view_t *view);
+
+/**
+ * @brief Validate a REG_COMMON_SET_PARAM_TIMED payload and view it in place
+ *
+ * @param payload_buf Received payload (command byte already stripped)
+ * @param payload_len Length of payload_buf
+ * @param[out] view View over payload_buf
+ * @return true if the payload has the right length, false otherwise
+ */
+I2C_PROTO_HELPER bool i2c_proto_view_set_param_timed(const uint8_t *payload_buf, size_t payload_len, i2c_proto_set_param_timed_view_t *view);
+
+/**
+ * @brief Validate a REG_COMMON_I2S_CONFIG payload and view it in place
+ *
+ * @param payload_buf Received payload (command byte already stripped)
+ * @param payload_len Length of payload_buf
+ * @param[out] view View over payload_buf
+ * @return true if the payload has the right length, false otherwise
+ */
+I2C_PROTO_HELPER bool i2c_proto_view_i2s_config(const uint8_t *payload_buf, size_t payload_len, i2c_proto_i2s_config_view_t *view);
+
+/**
+ * @brief Validate a REG_COMMON_GET_PARAM_RANGE payload and view it in place
+ *
+ * @param payload_buf Received payload (command byte already stripped)
+ * @param payload_len Length of payload_buf
+ * @param[out] view View over payload_buf
+ * @return true if the payload has the right length, false otherwise
+ */
+I2C_PROTO_HELPER bool i2c_proto_view_get_param_range(const uint8_t *payload_buf, size_t payload_len, i2c_proto_get_param_range_view_t *view);
+
+/**
+ * @brief Validate a REG_COMMON_SET_PARAM_RAMP payload and view it in place
+ *
+ * @param payload_buf Received payload (command byte already stripped)
+ * @param payload_len Length of payload_buf
+ * @param[out] view View over payload_buf
+ * @return true if the payload has the right length, false otherwise
+ */
+I2C_PROTO_HELPER bool i2c_proto_view_set_param_ramp(const uint8_t *payload_buf, size_t payload_len, i2c_proto_set_param_ramp_view_t *view);
+/** @} */
+
+/**
+ * @defgroup msg_helpers Message Helper Functions
+ * @brief Pack (master side) and unpack (slave side) helpers for command payloads
+ * @{
+ */
+
+/**
+ * @brief Build a REG_COMMON_SET_PARAM message
+ *
+ * @param[out] buf Buffer receiving the command byte and payload
+ * @param buf_len Size of buf
+ * @param param_id Target parameter
+ * @param param_value New value
+ * @return Number of bytes written, 0 if buf is NULL or too small
+ */
+I2C_PROTO_HELPER size_t i2c_proto_pack_set_param_msg(uint8_t *buf, size_t buf_len, ParamId_t param_id, ParamValue_t param_value);
+
+/**
+ * @brief Decode a REG_COMMON_SET_PARAM payload (command byte already stripped)
+ *
+ * @param payload_buf Received payload
+ * @param payload_len Length of payload_buf, must be sizeof(SetParamPayload_t)
+ * @param[out] param_id Decoded parameter ID
+ * @param[out] param_value Decoded value
+ * @return true on success, false on invalid arguments or length
+ */
+I2C_PROTO_HELPER bool i2c_proto_unpack_set_param_payload(const uint8_t *payload_buf, size_t payload_len, ParamId_t *param_id, ParamValue_t *param_value);
+
+/**
+ * @brief Build a REG_COMMON_I2S_CONFIG message
+ *
+ * @param[out] buf Buffer receiving the command byte and payload
+ * @param buf_len Size of buf
+ * @param config TDM slot assignment to send
+ * @return Number of bytes written, 0 if an argument is NULL or buf is too small
+ */
+I2C_PROTO_HELPER size_t i2c_proto_pack_i2s_config_msg(uint8_t *buf, size_t buf_len, const I2sConfig_t *config);
+
+/**
+ * @brief Decode a REG_COMMON_I2S_CONFIG payload (command byte already stripped)
+ *
+ * @param payload_buf Received payload
+ * @param payload_len Length of payload_buf, must be sizeof(I2sConfig_t)
+ * @param[out] config Decoded slot assignment
+ * @return true on success, false on invalid arguments or length
+ */
+I2C_PROTO_HELPER bool i2c_proto_unpack_i2s_config_payload(const uint8_t *payload_buf, size_t payload_len, I2sConfig_t *config);
+
+/**
+ * @brief Build a REG_COMMON_SET_PARAM_TIMED message
+ *
+ * @param[out] buf Buffer receiving the command byte and payload
+ * @param buf_len Size of buf
+ * @param frame TDM frame at which the value takes effect
+ * @param param_id Target parameter
+ * @param param_value New value
+ * @return Number of bytes written, 0 if buf is NULL or too small
+ */
+size_t i2c_proto_pack_set_param_timed_msg(uint8_t *buf, size_t buf_len, uint32_t frame, ParamId_t param_id, ParamValue_t param_value);
+
+/**
+ * @brief Decode a REG_COMMON_SET_PARAM_TIMED payload (command byte already stripped)
+ *
+ * @param payload_buf Received payload
+ * @param payload_len Length of payload_buf, must be sizeof(TimedSetParamPayload_t)
+ * @param[out] frame Decoded TDM frame
+ * @param[out] param_id Decoded parameter ID
+ * @param[out] param_value Decoded value
+ * @return true on success, false on invalid arguments or length
+ */
+bool i2c_proto_unpack_set_param_timed_payload(const uint8_t *payload_buf, size_t payload_len, uint32_t *frame, ParamId_t *param_id, ParamValue_t *param_value);
+
+/**
+ * @brief Build a REG_COMMON_GET_PARAM_RANGE message
+ *
+ * @param[out] buf Buffer receiving the command byte and payload
+ * @param buf_len Size of buf
+ * @param first Lowest parameter ID to read
+ * @param last Highest parameter ID to read
+ * @return Number of bytes written, 0 if buf is NULL or too small
+ */
+size_t i2c_proto_pack_get_param_range_msg(uint8_t *buf, size_t buf_len, ParamId_t first, ParamId_t last);
+
+/**
+ * @brief Build a REG_COMMON_SET_PARAM_RAMP message
+ *
+ * @param[out] buf Buffer receiving the command byte and payload
+ * @param buf_len Size of buf
+ * @param param_id Target parameter
+ * @param target Value at the end of the ramp
+ * @param ramp_samples Ramp length in audio frames (0 = jump)
+ * @return Number of bytes written, 0 if buf is NULL or too small
+ */
+size_t i2c_proto_pack_set_param_ramp_msg(uint8_t *buf, size_t buf_len, ParamId_t param_id, ParamValue_t target, uint32_t ramp_samples);
+
+/**
+ * @brief Build a REG_COMMON_GROUP_CONFIG message
+ *
+ * @param[out] buf Buffer receiving the command byte and mask
+ * @param buf_len Size of buf
+ * @param group_mask Groups the module should belong to (bit n = group n)
+ * @return Number of bytes written, 0 if buf is NULL or too small
+ */
+size_t i2c_proto_pack_group_config_msg(uint8_t *buf, size_t buf_len, uint8_t group_mask);
+
+/**
+ * @brief Capability a command belongs to
+ *
+ * Lets either side check a command against ModuleIdentity_t::capabilities.
+ *
+ * @param cmd Command byte (REG_COMMON_* or CMD_COMMON_*)
+ * @return Its I2C_PROTO_CAP_* flag, 0 for commands every module implements
+ */
+uint32_t i2c_proto_cmd_capability(uint8_t cmd);
+
+/**
+ * @brief Check whether a message may be wrapped in a REG_COMMON_GROUP_WRITE
+ *
+ * Reads (which a general call cannot return), REG_COMMON_I2S_CONFIG and
+ * REG_COMMON_I2S_STAGE (slots are per module), group configuration and
+ * nested group writes are refused.
+ *
+ * @param cmd Command byte of the inner message
+ * @return true if cmd is a write every group member can apply
+ */
+bool i2c_proto_group_write_allowed(uint8_t cmd);
+
+/**
+ * @brief Build a REG_COMMON_GROUP_WRITE message around one write message
+ *
+ * msg may point into buf (e.g. at buf + I2C_PROTO_GROUP_HEADER_LEN when the
+ * inner message was packed in place); it is moved as needed.
+ *
+ * @param[out] buf Buffer receiving the wrapper and inner message
+ * @param buf_len Size of buf
+ * @param group_mask Target groups, I2C_PROTO_GROUP_ALL for every module
+ * @param msg One complete inner message (command byte included)
+ * @param msg_len Length of msg
+ * @return Number of bytes written, 0 if msg is not exactly one message
+ *         accepted by i2c_proto_group_write_allowed() or buf is too small
+ */
+size_t i2c_proto_pack_group_write_msg(uint8_t *buf, size_t buf_len, uint8_t group_mask, const uint8_t *msg, size_t msg_len);
+
+/**
+ * @brief CRC-8 (polynomial 0x07, initial value 0) of a byte range
+ *
+ * Table-driven, one lookup per byte.
+ *
+ * @param crc Running CRC; 0 to start, or the result of a previous call to continue
+ * @param data Bytes to add
+ * @param len Number of bytes
+ * @return Updated CRC
+ */
+uint8_t i2c_proto_crc8(uint8_t crc, const uint8_t *data, size_t len);
+
+/**
+ * @brief Seal a frame of one or more messages in a REG_COMMON_CRC_FRAME
+ *
+ * frame may point into buf (e.g. at buf + I2C_PROTO_CRC_HEADER_LEN when the
+ * frame builder wrote there); it is moved as needed. Call again with the same
+ * frame to retransmit.
+ *
+ * @param[out] buf Buffer receiving header and frame
+ * @param buf_len Size of buf
+ * @param frame Complete messages to protect
+ * @param frame_len Length of frame, 1 to I2C_PROTO_CRC_MAX_INNER_LEN
+ * @return Number of bytes written, 0 on invalid arguments or if buf is too small
+ */
+size_t i2c_proto_pack_crc_frame(uint8_t *buf, size_t buf_len, const uint8_t *frame, size_t frame_len);
+
+/**
+ * @brief Start iterating a REG_COMMON_GET_PARAM_RANGE response
+ *
+ * Entries are decoded with i2c_proto_compact_iter_next().
+ *
+ * @param[out] iter Iterator to initialize
+ * @param resp_buf Bytes read from the slave
+ * @param resp_len Length of resp_buf, may exceed the actual response
+ * @param[out] more Set to true if the slave had more entries than fitted
+ * @return true if the response is well formed, false otherwise
+ */
+bool i2c_proto_range_resp_iter_init(i2c_proto_batch_iter_t *iter, const uint8_t *resp_buf, size_t resp_len, bool *more);
+
+/**
+ * @brief Decode a REG_COMMON_IDENTITY response
+ *
+ * @param resp_buf Bytes read from the slave
+ * @param resp_len Length of resp_buf, at least sizeof(ModuleIdentity_t)
+ * @param[out] identity Decoded response
+ * @return true on success, false on invalid arguments or a short response
+ */
+bool i2c_proto_unpack_identity(const uint8_t *resp_buf, size_t resp_len, ModuleIdentity_t *identity);
+
+/**
+ * @brief Build a REG_COMMON_I2S_STAGE message
+ *
+ * @param[out] buf Buffer receiving the command byte and payload
+ * @param buf_len Size of buf
+ * @param config Slots to use after the next REG_COMMON_I2S_COMMIT
+ * @return Number of bytes written, 0 on invalid arguments or if buf is too small
+ */
+size_t i2c_proto_pack_i2s_stage_msg(uint8_t *buf, size_t buf_len, const I2sConfig_t *config);
+
+/**
+ * @brief Build a REG_COMMON_I2S_COMMIT message
+ *
+ * Wrap it with i2c_proto_pack_group_write_msg() to switch several modules
+ * with one transaction.
+ *
+ * @param[out] buf Buffer receiving the command byte and payload
+ * @param buf_len Size of buf
+ * @param frame First TDM frame using the staged slots
+ * @return Number of bytes written, 0 if buf is too small
+ */
+size_t i2c_proto_pack_i2s_commit_msg(uint8_t *buf, size_t buf_len, uint32_t frame);
+
+/**
+ * @brief Build a REG_COMMON_DIAG message
+ *
+ * @param[out] buf Buffer receiving the command byte and payload
+ * @param buf_len Size of buf
+ * @param cmd Command whose counters to read, or I2C_PROTO_DIAG_UNPARSED
+ * @param flags I2C_PROTO_DIAG_* flags
+ * @return Number of bytes written, 0 if buf is too small
+ */
+size_t i2c_proto_pack_diag_msg(uint8_t *buf, size_t buf_len, uint8_t cmd, uint8_t flags);
+
+/**
+ * @brief Decode a REG_COMMON_DIAG response
+ *
+ * @param resp_buf Bytes read from the slave
+ * @param resp_len Length of resp_buf, at least sizeof(DiagStats_t)
+ * @param[out] stats Decoded counters
+ * @return true on success, false on invalid arguments or a short response
+ */
+bool i2c_proto_unpack_diag(const uint8_t *resp_buf, size_t resp_len, DiagStats_t *stats);
+
+/**
+ * @brief Build a REG_COMMON_SET_PARAM_BATCH message carrying several parameters
+ *
+ * @param[out] buf Buffer receiving the command byte, count and entries
+ * @param buf_len Size of buf
+ * @param params Parameters to send, in order
+ * @param count Number of entries in params (1 to I2C_PROTO_BATCH_MAX_PARAMS)
+ * @return Number of bytes written, 0 on invalid arguments or if buf is too small
+ */
+size_t i2c_proto_pack_set_param_batch(uint8_t *buf, size_t buf_len, const SetParamPayload_t *params, size_t count);
+
+/**
+ * @brief Start iterating a REG_COMMON_SET_PARAM_BATCH payload (command byte already stripped)
+ *
+ * Validates the count byte against payload_len once, so that
+ * i2c_proto_batch_iter_next() does no further length checks.
+ *
+ * @param[out] iter Iterator to initialize
+ * @param payload_buf Received payload, starting at the count byte
+ * @param payload_len Length of payload_buf
+ * @return true if the payload is well formed, false otherwise
+ */
+I2C_PROTO_HELPER bool i2c_proto_batch_iter_init(i2c_proto_batch_iter_t *iter, const uint8_t *payload_buf, size_t payload_len);
+
+/**
+ * @brief Decode the next entry of a batch payload
+ *
+ * @param iter Iterator set up by i2c_proto_batch_iter_init()
+ * @param[out] param_id Decoded parameter ID
+ * @param[out] param_value Decoded value
+ * @return true if an entry was decoded, false once all entries are consumed
+ */
+I2C_PROTO_HELPER bool i2c_proto_batch_iter_next(i2c_proto_batch_iter_t *iter, ParamId_t *param_id, ParamValue_t *param_value);
+
+/**
+ * @brief View the next entry of a batch payload in place
+ *
+ * @param iter Iterator set up by i2c_proto_batch_iter_init()
+ * @param[out] entry Entry pointing into the receive buffer
+ * @return true if an entry was produced, false once all entries are consumed
+ */
+I2C_PROTO_HELPER bool i2c_proto_batch_iter_next_view(i2c_proto_batch_iter_t *iter, i2c_proto_param_entry_view_t *entry);
+
+/**
+ * @brief Get the length of the message at the start of a received frame
+ *
+ * Used by the slave to split a frame produced by the frame builder into its
+ * individual messages.
+ *
+ * @param buf Frame data, starting at a command/register byte
+ * @param buf_len Bytes available in buf
+ * @return Length of the first message including its command byte, 0 if the
+ *         command is unknown or the message is truncated
+ */
+size_t i2c_proto_msg_len(const uint8_t *buf, size_t buf_len);
+
+/**
+ * @brief Look up the wire type of a parameter
+ *
+ * @param param_id Parameter to look up
+ * @return The parameter's type, PARAM_TYPE_NONE if it is not in I2C_PROTO_PARAM_LIST
+ */
+I2C_PROTO_HELPER ParamType_t i2c_proto_param_type(ParamId_t param_id);
+
+/**
+ * @brief Look up the descriptor of a parameter
+ *
+ * Direct-indexed, so it is constant time and safe to call from the I2C
+ * receive path.
+ *
+ * @param param_id Parameter to look up
+ * @return The parameter's descriptor, NULL if it is not in I2C_PROTO_PARAM_LIST
+ */
+I2C_PROTO_HELPER const ParamDescriptor_t *i2c_proto_param_find(ParamId_t param_id);
+
+/**
+ * @brief Get the number of value bytes a parameter type occupies in compact frames
+ *
+ * @param type Parameter type
+ * @return Width in bytes, 0 for PARAM_TYPE_NONE
+ */
+I2C_PROTO_HELPER size_t i2c_proto_param_width(ParamType_t type);
+
+/**
+ * @brief Build a REG_COMMON_SET_PARAM_COMPACT message
+ *
+ * @param[out] buf Buffer receiving the command byte, count and entries
+ * @param buf_len Size of buf
+ * @param params Parameters to send, in order; every ID must be in the parameter table
+ * @param count Number of entries in params (1 to I2C_PROTO_BATCH_MAX_PARAMS)
+ * @return Number of bytes written, 0 on invalid arguments, unknown IDs or if buf is too small
+ */
+size_t i2c_proto_pack_set_param_compact(uint8_t *buf, size_t buf_len, const SetParamPayload_t *params, size_t count);
+
+/**
+ * @brief Write one compact entry of a PARAM_TYPE_U8 parameter
+ *
+ * The per-type writers have a constant width, so a sender that knows its
+ * parameter types at compile time skips the table lookup. The caller checks
+ * space (at most I2C_PROTO_COMPACT_MAX_ENTRY_LEN bytes) and the count byte.
+ *
+ * @return Bytes written
+ */
+static inline size_t i2c_proto_compact_put_u8(uint8_t *dst, ParamId_t param_id, uint8_t value)
+{
+    i2c_proto_wr_le16(dst, param_id);
+    dst[sizeof(ParamId_t)] = value;
+    return sizeof(ParamId_t) + sizeof(uint8_t);
+}
+
+/** @brief Write one compact entry of a PARAM_TYPE_U16 parameter, see i2c_proto_compact_put_u8() */
+static inline size_t i2c_proto_compact_put_u16(uint8_t *dst, ParamId_t param_id, uint16_t value)
+{
+    i2c_proto_wr_le16(dst, param_id);
+    i2c_proto_wr_le16(dst + sizeof(ParamId_t), value);
+    return sizeof(ParamId_t) + sizeof(uint16_t);
+}
+
+/** @brief Write one compact entry of a PARAM_TYPE_S16 parameter, see i2c_proto_compact_put_u8() */
+static inline size_t i2c_proto_compact_put_s16(uint8_t *dst, ParamId_t param_id, int16_t value)
+{
+    return i2c_proto_compact_put_u16(dst, param_id, (uint16_t)value);
+}
+
+/** @brief Write one compact entry of a PARAM_TYPE_U32 parameter, see i2c_proto_compact_put_u8() */
+static inline size_t i2c_proto_compact_put_u32(uint8_t *dst, ParamId_t param_id, uint32_t value)
+{
+    i2c_proto_wr_le16(dst, param_id);
+    i2c_proto_wr_le32(dst + sizeof(ParamId_t), value);
+    return sizeof(ParamId_t) + sizeof(uint32_t);
+}
+
+/**
+ * @brief Start iterating a REG_COMMON_SET_PARAM_COMPACT payload (command byte already stripped)
+ *
+ * Walks the entries once to check that every ID is known and that the
+ * entries exactly fill payload_len.
+ *
+ * @param[out] iter Iterator to initialize
+ * @param payload_buf Received payload, starting at the count byte
+ * @param payload_len Length of payload_buf
+ * @return true if the payload is well formed, false otherwise
+ */
+bool i2c_proto_compact_iter_init(i2c_proto_batch_iter_t *iter, const uint8_t *payload_buf, size_t payload_len);
+
+/**
+ * @brief Decode the next entry of a compact payload
+ *
+ * @param iter Iterator set up by i2c_proto_compact_iter_init()
+ * @param[out] param_id Decoded parameter ID
+ * @param[out] param_value Decoded value, zero- or sign-extended to 32 bits
+ * @return true if an entry was decoded, false once all entries are consumed
+ */
+I2C_PROTO_HELPER bool i2c_proto_compact_iter_next(i2c_proto_batch_iter_t *iter, ParamId_t *param_id, ParamValue_t *param_value);
+
+/**
+ * @brief View the next entry of a compact payload in place
+ *
+ * Unlike i2c_proto_compact_iter_next() the value is not extended; entry->width
+ * gives the number of bytes the parameter's type uses on the wire.
+ *
+ * @param iter Iterator set up by i2c_proto_compact_iter_init()
+ * @param[out] entry Entry pointing into the receive buffer
+ * @return true if an entry was produced, false once all entries are consumed
+ */
+I2C_PROTO_HELPER bool i2c_proto_compact_iter_next_view(i2c_proto_batch_iter_t *iter, i2c_proto_param_entry_view_t *entry);
+
+/**
+ * @brief Start building a frame into a caller-owned buffer
+ *
+ * This is the only call that validates the buffer; the append functions
+ * just check the space left.
+ *
+ * @param[out] builder Builder to initialize
+ * @param buf Buffer the frame is written to
+ * @param buf_len Size of buf
+ * @return true on success, false if builder or buf is NULL or buf_len is 0
+ */
+bool i2c_proto_frame_builder_begin(i2c_proto_frame_builder_t *builder, uint8_t *buf, size_t buf_len);
+
+/**
+ * @brief Append a parameter write to the frame
+ *
+ * Extends the batch message being built, or opens a new one if the previous
+ * message was not a batch or the batch is full.
+ *
+ * @param builder Builder set up by i2c_proto_frame_builder_begin()
+ * @param param_id Target parameter
+ * @param param_value New value
+ * @return true on success, false if the frame buffer is full
+ */
+I2C_PROTO_HELPER bool i2c_proto_frame_builder_append_param(i2c_proto_frame_builder_t *builder, ParamId_t param_id, ParamValue_t param_value);
+
+/**
+ * @brief Append a REG_COMMON_I2S_CONFIG message to the frame
+ *
+ * @param builder Builder set up by i2c_proto_frame_builder_begin()
+ * @param config TDM slot assignment to send
+ * @return true on success, false if the frame buffer is full
+ */
+bool i2c_proto_frame_builder_append_i2s_config(i2c_proto_frame_builder_t *builder, const I2sConfig_t *config);
+
+/**
+ * @brief Finish the frame
+ *
+ * @param builder Builder set up by i2c_proto_frame_builder_begin()
+ * @return Total frame length in bytes, 0 if nothing was appended
+ */
+size_t i2c_proto_frame_builder_finish(i2c_proto_frame_builder_t *builder);
+
+/** @} */
+
+/**
+ * @brief Parameter change callback
+ *
+ * @param user_data Pointer given at registration
+ * @param value New value, in the parameter's C type
+ * @param value_len Size of the value in bytes
+ */
+typedef void (*module_i2c_proto_param_cb_t)(void *user_data, const void *value, size_t value_len);
+
+/**
+ * @brief Common command callback
+ *
+ * Called for CMD_COMMON_RESET, after a new REG_COMMON_I2S_CONFIG has been
+ * stored (staged configurations reach the audio task through
+ * module_i2c_proto_next_i2s_switch() instead), and after the last REG_COMMON_PRESET_DELTA chunk of a preset load
+ * has been applied, from the I2C receive path. CMD_COMMON_SAVE_SETTINGS and
+ * CMD_COMMON_LOAD_SETTINGS are handled by a background job that saves the
+ * parameters changed since the last save (or loads the saved ones) through
+ * the port layer's NVS hooks; the callback then runs from the worker task
+ * once the job is done, so the module can persist or restore extra state.
+ * Loaded values are applied like writes from the master: in deferred mode, or
+ * while the parameter is ramping, they wait for the audio task's next
+ * module_i2c_proto_apply_pending(), so their parameter callbacks run there.
+ * A failed job sets STATUS_ERROR.
+ *
+ * @param user_data Pointer given at registration
+ * @param cmd The command/register byte
+ * @return ESP_OK if handled, error code otherwise
+ */
+typedef esp_err_t (*module_i2c_proto_command_cb_t)(void *user_data, uint8_t cmd);
+
+/**
+ * @brief Response callback of the dispatch task
+ *
+ * Called from the dispatch task (see module_i2c_proto_config_t::dispatch_core)
+ * whenever a received frame produced a response. buf comes from the response
+ * pool: hand it to the I2C driver for transmission and return it with
+ * module_i2c_proto_resp_release() once the driver is done with it.
+ *
+ * @param user_data Pointer given at registration
+ * @param buf Response bytes
+ * @param len Number of response bytes
+ */
+typedef void (*module_i2c_proto_response_cb_t)(void *user_data, uint8_t *buf, size_t len);
+
+#define MODULE_I2C_PROTO_QUEUE_LEN    64 /**< Parameter writes that can wait for module_i2c_proto_apply_pending() (power of two) */
+#define MODULE_I2C_PROTO_TIMED_LEN    32 /**< Timed parameter writes that can wait for their frame; further ones are rejected with ESP_ERR_NO_MEM */
+#define MODULE_I2C_PROTO_RX_BUFFERS   2  /**< Buffers in the receive arena (ping-pong) */
+#define MODULE_I2C_PROTO_RX_BUF_LEN   I2C_PROTO_MAX_FRAME_LEN /**< Bytes per receive buffer; fits the largest batch frame */
+
+#if CONFIG_I2C_PROTO_STATS
+#define MODULE_I2C_PROTO_STATS 1 /**< Per-command counters and REG_COMMON_DIAG compiled in */
+#else
+#define MODULE_I2C_PROTO_STATS 0
+#endif
+
+#ifdef CONFIG_I2C_PROTO_DISABLED_CAPS
+#define MODULE_I2C_PROTO_DISABLED_CAPS CONFIG_I2C_PROTO_DISABLED_CAPS /**< Default module_i2c_proto_config_t::disabled_caps */
+#else
+#define MODULE_I2C_PROTO_DISABLED_CAPS 0
+#endif
+
+#ifdef CONFIG_I2C_PROTO_DISPATCH_CORE
+#define MODULE_I2C_PROTO_DISPATCH_CORE CONFIG_I2C_PROTO_DISPATCH_CORE /**< Default module_i2c_proto_config_t::dispatch_core */
+#else
+#define MODULE_I2C_PROTO_DISPATCH_CORE -1
+#endif
+
+#ifdef CONFIG_I2C_PROTO_PARAM_CALLBACKS
+#define MODULE_I2C_PROTO_PARAM_CALLBACKS CONFIG_I2C_PROTO_PARAM_CALLBACKS /**< Parameter callback registrations in the static pool */
+#else
+#define MODULE_I2C_PROTO_PARAM_CALLBACKS 32
+#endif
+
+#ifdef CONFIG_I2C_PROTO_RESP_BUFFERS
+#define MODULE_I2C_PROTO_RESP_BUFFERS CONFIG_I2C_PROTO_RESP_BUFFERS /**< Buffers in the response pool */
+#else
+#define MODULE_I2C_PROTO_RESP_BUFFERS 2
+#endif
+
+#ifdef CONFIG_I2C_PROTO_RESP_BUF_LEN
+#define MODULE_I2C_PROTO_RESP_BUF_LEN CONFIG_I2C_PROTO_RESP_BUF_LEN /**< Bytes per response pool buffer */
+#else
+#define MODULE_I2C_PROTO_RESP_BUF_LEN 64
+#endif
+
+/**
+ * @brief A timed parameter change due within the current audio block
+ */
+typedef struct {
+    ParamId_t    param_id; /**< Parameter that changed */
+    uint32_t     offset;   /**< Sample frame within the block at which to switch (0 if already late) */
+    ParamValue_t value;    /**< New value, in u32 (s32 for signed parameters) as on the wire */
+} module_i2c_proto_timed_event_t;
+
+/**
+ * @brief A committed I2S slot change due within the current audio block
+ */
+typedef struct {
+    uint32_t    offset; /**< Sample frame within the block from which the new slots apply (0 if already late) */
+    I2sConfig_t config; /**< New slot assignment */
+} module_i2c_proto_i2s_switch_t;
+
+/**
+ * @brief Slave runtime options for module_i2c_proto_init_with_config()
+ */
+typedef struct {
+    uint8_t module_type;     /**< The module type identifier (MODULE_TYPE_*) */
+    uint8_t default_address; /**< Default I2C address to use if not found in NVS */
+    bool deferred_apply;     /**< Queue parameter writes instead of applying them in process_command */
+    int attention_gpio;      /**< Open-drain, active-low "attention" output asserted while parameters are dirty; -1 for none */
+    uint8_t rx_buffer_count; /**< Receive arena buffers to use (0 to MODULE_I2C_PROTO_RX_BUFFERS), see module_i2c_proto_rx_acquire() */
+    uint16_t rx_buffer_len;  /**< Bytes per receive arena buffer (up to MODULE_I2C_PROTO_RX_BUF_LEN) */
+    uint32_t disabled_caps;  /**< I2C_PROTO_CAP_* features to switch off: not advertised, and their commands are rejected */
+    int dispatch_core;       /**< Core to pin the decode task to, see module_i2c_proto_params_snapshot(); -1 to call module_i2c_proto_rx_process() yourself */
+} module_i2c_proto_config_t;
+
+/**
+ * @brief Default slave options: parameters applied synchronously in process_command, ping-pong receive arena
+ */
+#define MODULE_I2C_PROTO_CONFIG_DEFAULT(type, address) { \
+    .module_type = (type),                               \
+    .default_address = (address),                        \
+    .deferred_apply = false,                             \
+    .attention_gpio = -1,                                \
+    .rx_buffer_count = MODULE_I2C_PROTO_RX_BUFFERS,      \
+    .rx_buffer_len = MODULE_I2C_PROTO_RX_BUF_LEN,        \
+    .disabled_caps = MODULE_I2C_PROTO_DISABLED_CAPS,     \
+    .dispatch_core = MODULE_I2C_PROTO_DISPATCH_CORE,     \
+}
+
+/**
+ * @brief Initialize the I2C protocol handler
+ * 
+ * Resets all parameter values and callback registrations, so callbacks must
+ * be registered after this call.
+ *
+ * @param module_type The module type identifier
+ * @param default_address Default I2C address to use if not found in NVS
+ * @return ESP_OK if initialization is successful, error code otherwise
+ */
+esp_err_t module_i2c_proto_init(uint8_t module_type, uint8_t default_address);
+
+/**
+ * @brief Initialize the I2C protocol handler with explicit options
+ *
+ * With deferred_apply set, module_i2c_proto_process_command() only validates
+ * incoming parameter writes and pushes them into a lock-free
+ * single-producer/single-consumer queue. The audio task then calls
+ * module_i2c_proto_apply_pending() at block boundaries, which stores the
+ * values and runs the parameter callbacks in the audio task's context.
+ * process_command must then be called from a single context (the I2C
+ * receive path) and apply_pending from a single other one.
+ *
+ * With dispatch_core set to a core number, the runtime starts its own
+ * decode task pinned to that core (normally the one not running audio).
+ * module_i2c_proto_rx_commit() wakes it; it drains the receive arena, so
+ * decoding, parameter callbacks and the common command callback all run
+ * there, and responses go out through the callback registered with
+ * module_i2c_proto_register_response_callback(). After each batch of frames
+ * it publishes the parameter values for module_i2c_proto_params_snapshot().
+ * Requires a receive arena (rx_buffer_count > 0); do not call rx_process
+ * yourself in this mode.
+ *
+ * @param config Runtime options
+ * @return ESP_OK if initialization is successful, error code otherwise
+ */
+esp_err_t module_i2c_proto_init_with_config(const module_i2c_proto_config_t *config);
+
+/**
+ * @brief Process an incoming I2C command
+ * 
+ * @param cmd_buffer Pointer to the command buffer
+ * @param cmd_len Length of the command data
+ * @param[out] resp_buffer Pointer to the response buffer
+ * @param[in,out] resp_len Maximum length of response buffer on input, actual response length on output
+ * @return ESP_OK if command processed successfully, error code otherwise
+ */
+esp_err_t module_i2c_proto_process_command(const uint8_t *cmd_buffer, size_t cmd_len, 
+                                          uint8_t *resp_buffer, size_t *resp_len);
+
+/**
+ * @brief Get the receive arena buffer the I2C driver should fill next
+ *
+ * The slave owns a static, DMA-capable arena of rx_buffer_count buffers.
+ * The I2C driver receives each write straight into the buffer returned
+ * here and hands it over with module_i2c_proto_rx_commit(); the task that
+ * calls module_i2c_proto_rx_process() drains committed buffers in order.
+ * With two buffers the driver fills one while the previous frame is
+ * decoded, with no per-byte work and no copy. Acquire/commit must come
+ * from a single context (typically the driver's receive-done ISR) and
+ * rx_process from a single other one. Calling acquire again before commit
+ * returns the same buffer.
+ *
+ * @param[out] buf_len Size of the returned buffer
+ * @return Buffer to receive into, NULL if every buffer still waits for
+ *         rx_process (counted as an overrun) or the arena is disabled
+ */
+uint8_t *module_i2c_proto_rx_acquire(size_t *buf_len);
+
+/**
+ * @brief Hand the buffer from module_i2c_proto_rx_acquire() to the decoder
+ *
+ * Safe to call from an ISR. A zero-length write is ignored and the buffer
+ * stays acquired.
+ *
+ * @param len Bytes the driver received into the buffer
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if no buffer is acquired,
+ *         ESP_ERR_INVALID_SIZE if len exceeds the buffer
+ */
+esp_err_t module_i2c_proto_rx_commit(size_t len);
+
+/**
+ * @brief Decode the oldest committed receive buffer and release it
+ *
+ * Runs module_i2c_proto_process_command() on the buffer in place, then
+ * returns it to the driver.
+ *
+ * @param[out] resp_buffer Response buffer, as for process_command
+ * @param[in,out] resp_len As for process_command
+ * @return Result of process_command, ESP_ERR_NOT_FOUND if no buffer is
+ *         committed, ESP_ERR_INVALID_STATE if the arena is disabled
+ */
+esp_err_t module_i2c_proto_rx_process(uint8_t *resp_buffer, size_t *resp_len);
+
+/**
+ * @brief Number of times module_i2c_proto_rx_acquire() found no free buffer since init
+ */
+uint32_t module_i2c_proto_rx_overruns(void);
+
+/**
+ * @brief Read the counters of one command locally
+ *
+ * Counters are updated without locks by the context that calls
+ * module_i2c_proto_process_command(), so a read from another task may mix
+ * values from either side of one message.
+ *
+ * @param cmd Command byte, or I2C_PROTO_DIAG_UNPARSED
+ * @param[out] stats Current counters
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL,
+ *         ESP_ERR_NOT_SUPPORTED without CONFIG_I2C_PROTO_STATS
+ */
+esp_err_t module_i2c_proto_stats_get(uint8_t cmd, DiagStats_t *stats);
+
+/**
+ * @brief Zero every command's counters
+ *
+ * Exact only when called from the process_command context (like
+ * I2C_PROTO_DIAG_CLEAR); from elsewhere a message handled at the same time
+ * may survive the reset.
+ */
+void module_i2c_proto_stats_reset(void);
+
+/**
+ * @brief Set a parameter value
+ * 
+ * For changes made by the module itself (front panel, internal modulation).
+ * The parameter is marked dirty, STATUS_PARAM_CHANGED is set and the
+ * attention line, if configured, is asserted until the master reads
+ * REG_COMMON_DIRTY_BITMAP.
+ *
+ * Like a write from the master, the change is queued for the audio task in
+ * deferred mode or while the parameter is ramping: it then replaces the ramp,
+ * its callbacks run from module_i2c_proto_apply_pending() and it is flagged
+ * for the master once applied. With the dispatch task on it is always
+ * queued, so it reaches module_i2c_proto_params_snapshot() as an audio-side
+ * commit. Queued local writes must come from one task at a time.
+ *
+ * @param param_id The parameter identifier
+ * @param value Pointer to the parameter value data
+ * @param value_len Length of the parameter value data
+ * @return ESP_OK if parameter set (or queued) successfully, ESP_ERR_NO_MEM if
+ *         the queue is full, error code otherwise
+ */
+esp_err_t module_i2c_proto_set_param(uint8_t param_id, const void *value, size_t value_len);
+
+/**
+ * @brief Get a parameter value
+ * 
+ * @param param_id The parameter identifier
+ * @param[out] value Pointer to store the parameter value
+ * @param[in,out] value_len Maximum length of value buffer on input, actual parameter length on output
+ * @return ESP_OK if parameter retrieved successfully, error code otherwise
+ */
+esp_err_t module_i2c_proto_get_param(uint8_t param_id, void *value, size_t *value_len);
+
+/**
+ * @brief Set a parameter by descriptor index
+ *
+ * Same effect as module_i2c_proto_set_param() without the ID lookup and the
+ * length check. Normally reached through MODULE_I2C_PROTO_SET_U16() and
+ * friends, which supply a checked index.
+ *
+ * @param index I2C_PROTO_PARAM_IDX_* of the parameter
+ * @param value New value; must lie in the parameter's [min, max]
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if index is out of range,
+ *         ESP_ERR_INVALID_ARG if value is out of range, ESP_ERR_NO_MEM if
+ *         the write had to be queued and the queue is full
+ */
+esp_err_t module_i2c_proto_set_param_index(size_t index, int64_t value);
+
+/**
+ * @defgroup typed_params Typed Parameter Access
+ * @brief Fixed-type accessors for parameters known at compile time
+ *
+ * The argument is the PARAM_* name itself, e.g.
+ * MODULE_I2C_PROTO_GET_U16(PARAM_OSC_LEVEL_U16). Using an accessor of the
+ * wrong type, or a name missing from I2C_PROTO_PARAM_LIST, does not compile.
+ * Getters are a plain load from the slave's live parameter storage, for
+ * reading parameters from the audio render loop when no dispatch task runs.
+ * With the dispatch task on, that storage is written from the other core
+ * during the block; read the block's module_i2c_proto_params_snapshot()
+ * with the *_FROM() variants instead. Setters behave like
+ * module_i2c_proto_set_param().
+ * @{
+ */
+/** @cond INTERNAL */
+#define I2C_PROTO_PARAM_TYPE_CHECK_(type, expected) ((void)sizeof(char[(int)(type) == (int)(expected) ? 1 : -1]))
+/** @endcond */
+
+/** @brief Current value of PARAM_<name> of any type, as its own C type (no type check) */
+#define MODULE_I2C_PROTO_GET(name)       (i2c_proto_param_values.name##_value)
+
+/** @brief Current value of a PARAM_TYPE_U8 parameter */
+#define MODULE_I2C_PROTO_GET_U8(name)    (I2C_PROTO_PARAM_TYPE_CHECK_(I2C_PROTO_PARAM_TYPE_##name, PARAM_TYPE_U8), i2c_proto_param_values.name##_value)
+/** @brief Current value of a PARAM_TYPE_U16 parameter */
+#define MODULE_I2C_PROTO_GET_U16(name)   (I2C_PROTO_PARAM_TYPE_CHECK_(I2C_PROTO_PARAM_TYPE_##name, PARAM_TYPE_U16), i2c_proto_param_values.name##_value)
+/** @brief Current value of a PARAM_TYPE_S16 parameter */
+#define MODULE_I2C_PROTO_GET_S16(name)   (I2C_PROTO_PARAM_TYPE_CHECK_(I2C_PROTO_PARAM_TYPE_##name, PARAM_TYPE_S16), i2c_proto_param_values.name##_value)
+/** @brief Current value of a PARAM_TYPE_U32 parameter */
+#define MODULE_I2C_PROTO_GET_U32(name)   (I2C_PROTO_PARAM_TYPE_CHECK_(I2C_PROTO_PARAM_TYPE_##name, PARAM_TYPE_U32), i2c_proto_param_values.name##_value)
+
+/** @brief Value of a PARAM_TYPE_U8 parameter in a module_i2c_proto_params_snapshot() block */
+#define MODULE_I2C_PROTO_GET_U8_FROM(snapshot, name)  (I2C_PROTO_PARAM_TYPE_CHECK_(I2C_PROTO_PARAM_TYPE_##name, PARAM_TYPE_U8), (snapshot)->name##_value)
+/** @brief Value of a PARAM_TYPE_U16 parameter in a module_i2c_proto_params_snapshot() block */
+#define MODULE_I2C_PROTO_GET_U16_FROM(snapshot, name) (I2C_PROTO_PARAM_TYPE_CHECK_(I2C_PROTO_PARAM_TYPE_##name, PARAM_TYPE_U16), (snapshot)->name##_value)
+/** @brief Value of a PARAM_TYPE_S16 parameter in a module_i2c_proto_params_snapshot() block */
+#define MODULE_I2C_PROTO_GET_S16_FROM(snapshot, name) (I2C_PROTO_PARAM_TYPE_CHECK_(I2C_PROTO_PARAM_TYPE_##name, PARAM_TYPE_S16), (snapshot)->name##_value)
+/** @brief Value of a PARAM_TYPE_U32 parameter in a module_i2c_proto_params_snapshot() block */
+#define MODULE_I2C_PROTO_GET_U32_FROM(snapshot, name) (I2C_PROTO_PARAM_TYPE_CHECK_(I2C_PROTO_PARAM_TYPE_##name, PARAM_TYPE_U32), (snapshot)->name##_value)
+
+/** @brief Set a PARAM_TYPE_U8 parameter, see module_i2c_proto_set_param_index() */
+#define MODULE_I2C_PROTO_SET_U8(name, v)  (I2C_PROTO_PARAM_TYPE_CHECK_(I2C_PROTO_PARAM_TYPE_##name, PARAM_TYPE_U8), module_i2c_proto_set_param_index(I2C_PROTO_PARAM_IDX_##name, (int64_t)(v)))
+/** @brief Set a PARAM_TYPE_U16 parameter, see module_i2c_proto_set_param_index() */
+#define MODULE_I2C_PROTO_SET_U16(name, v) (I2C_PROTO_PARAM_TYPE_CHECK_(I2C_PROTO_PARAM_TYPE_##name, PARAM_TYPE_U16), module_i2c_proto_set_param_index(I2C_PROTO_PARAM_IDX_##name, (int64_t)(v)))
+/** @brief Set a PARAM_TYPE_S16 parameter, see module_i2c_proto_set_param_index() */
+#define MODULE_I2C_PROTO_SET_S16(name, v) (I2C_PROTO_PARAM_TYPE_CHECK_(I2C_PROTO_PARAM_TYPE_##name, PARAM_TYPE_S16), module_i2c_proto_set_param_index(I2C_PROTO_PARAM_IDX_##name, (int64_t)(v)))
+/** @brief Set a PARAM_TYPE_U32 parameter, see module_i2c_proto_set_param_index() */
+#define MODULE_I2C_PROTO_SET_U32(name, v) (I2C_PROTO_PARAM_TYPE_CHECK_(I2C_PROTO_PARAM_TYPE_##name, PARAM_TYPE_U32), module_i2c_proto_set_param_index(I2C_PROTO_PARAM_IDX_##name, (int64_t)(v)))
+/** @} */
+
+/**
+ * @brief Register parameter change callback
+ * 
+ * Subscriptions come from a static pool of MODULE_I2C_PROTO_PARAM_CALLBACKS
+ * entries shared by all parameters (CONFIG_I2C_PROTO_PARAM_CALLBACKS); no
+ * heap is used. A parameter can have several subscribers, called in
+ * registration order. Registering the same callback and user_data twice has no
+ * effect. Register and unregister while the I2C receive path and the audio
+ * task are not delivering changes, e.g. right after init.
+ *
+ * @param param_id Parameter ID to monitor
+ * @param callback Function to call when parameter changes, NULL to drop every subscriber of param_id
+ * @param user_data User data to pass to the callback
+ * @return ESP_OK if callback registered successfully, ESP_ERR_NOT_FOUND for
+ *         an unknown parameter, ESP_ERR_NO_MEM if the pool is exhausted
+ */
+esp_err_t module_i2c_proto_register_param_callback(uint8_t param_id, 
+                                                 void (*callback)(void *user_data, const void *value, size_t value_len), 
+                                                 void *user_data);
+
+/**
+ * @brief Remove one parameter change subscription and return it to the pool
+ *
+ * @param param_id Parameter ID the callback was registered for
+ * @param callback Callback given at registration
+ * @param user_data User data given at registration
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND if no such subscription exists
+ */
+esp_err_t module_i2c_proto_unregister_param_callback(uint8_t param_id, module_i2c_proto_param_cb_t callback, void *user_data);
+
+/**
+ * @brief Take a buffer from the static response pool
+ *
+ * The pool holds MODULE_I2C_PROTO_RESP_BUFFERS DMA-capable buffers of
+ * MODULE_I2C_PROTO_RESP_BUF_LEN bytes. Pass the buffer to
+ * module_i2c_proto_rx_process() (or process_command) as the response
+ * buffer, hand it to the I2C driver for transmission and release it once
+ * the driver is done with it. Safe to call from any context.
+ *
+ * @param[out] buf_len Size of the returned buffer
+ * @return Buffer, NULL if all are in use
+ */
+uint8_t *module_i2c_proto_resp_acquire(size_t *buf_len);
+
+/**
+ * @brief Return a buffer obtained from module_i2c_proto_resp_acquire()
+ *
+ * Safe to call from an ISR (e.g. the driver's transmit-done callback).
+ *
+ * @param buf Buffer to release
+ * @return ESP_OK, ESP_ERR_INVALID_ARG if buf is not a pool buffer,
+ *         ESP_ERR_INVALID_STATE if it is not currently acquired
+ */
+esp_err_t module_i2c_proto_resp_release(uint8_t *buf);
+
+/**
+ * @brief Register the common command callback
+ *
+ * @param callback Function to call for common commands, NULL to unregister
+ * @param user_data User data to pass to the callback
+ * @return ESP_OK
+ */
+esp_err_t module_i2c_proto_register_command_callback(module_i2c_proto_command_cb_t callback, void *user_data);
+
+/**
+ * @brief Register the dispatch task's response callback
+ *
+ * Without one, the dispatch task decodes frames without a response buffer, so
+ * reads fail with ESP_ERR_INVALID_SIZE.
+ *
+ * @param callback Function receiving each response, NULL to unregister
+ * @param user_data User data to pass to the callback
+ * @return ESP_OK
+ */
+esp_err_t module_i2c_proto_register_response_callback(module_i2c_proto_response_cb_t callback, void *user_data);
+
+/**
+ * @brief Latest parameter values published by the dispatch task
+ *
+ * The dispatch task keeps three copies of module_i2c_proto_params_t. After
+ * each batch of frames and after CMD_COMMON_LOAD_SETTINGS, it fills the
+ * spare copy and swaps it in with one atomic exchange. This call takes the
+ * newest copy the same way. Neither side ever waits, and the returned block
+ * does not change until the next call. Call it once per audio block from the
+ * audio task only, and read fields directly, e.g.
+ * snapshot->PARAM_OSC_LEVEL_U16_value, or with
+ * MODULE_I2C_PROTO_GET_U16_FROM() and its siblings.
+ *
+ * Values committed on the audio task (ramps, timed, deferred and local
+ * writes) are merged into the returned block by this call, so call it after
+ * module_i2c_proto_apply_pending(), module_i2c_proto_next_timed_event() and
+ * module_i2c_proto_ramp_process() for the block. Without a dispatch task
+ * this is the live storage read by MODULE_I2C_PROTO_GET().
+ *
+ * @return Current snapshot, valid until the next call
+ */
+const module_i2c_proto_params_t *module_i2c_proto_params_snapshot(void);
+
+/**
+ * @brief Get the I2S configuration last received from the master
+ *
+ * @param[out] config Current TDM slot assignment
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if config is NULL
+ */
+esp_err_t module_i2c_proto_get_i2s_config(I2sConfig_t *config);
+
+/**
+ * @brief Get the I2C address the module answers on
+ *
+ * @return 7-bit slave address
+ */
+uint8_t module_i2c_proto_get_address(void);
+
+/**
+ * @brief Apply parameter writes queued by process_command in deferred mode
+ *
+ * Call from the audio task once per block. Values are applied in arrival
+ * order and the registered callbacks run from this call.
+ *
+ * @return Number of parameter writes applied
+ */
+size_t module_i2c_proto_apply_pending(void);
+
+/**
+ * @brief Take the next timed parameter change that falls within an audio block
+ *
+ * Call from the audio task in a loop at the start of each block until it
+ * returns false. REG_COMMON_SET_PARAM_TIMED writes always travel through the
+ * deferred queue, whatever deferred_apply is set to; this call also applies
+ * any untimed writes queued before them. Each returned change has already
+ * been stored and its callbacks run, and changes come out in frame order so
+ * the renderer can split the block at event->offset.
+ *
+ * @param block_start TDM frame of the first sample of the block
+ * @param block_frames Number of frames in the block
+ * @param[out] event The change and its offset within the block
+ * @return true if a change was returned, false if none is due in this block
+ */
+bool module_i2c_proto_next_timed_event(uint32_t block_start, uint32_t block_frames, module_i2c_proto_timed_event_t *event);
+
+/**
+ * @brief Take a staged I2S configuration whose commit frame falls within an audio block
+ *
+ * Call from the audio task at the start of each block, next to
+ * module_i2c_proto_next_timed_event(). On true, read the old slots up to
+ * sw->offset and the new ones from there on; module_i2c_proto_get_i2s_config()
+ * reports the new slots from then on. Staged switches travel through the
+ * same queue as timed writes, so this call also applies queued writes.
+ *
+ * @param block_start TDM frame of the first sample of the block
+ * @param block_frames Number of frames in the block
+ * @param[out] sw The new slots and the offset at which they apply
+ * @return true if a switch was returned, false if none is due in this block
+ */
+bool module_i2c_proto_next_i2s_switch(uint32_t block_start, uint32_t block_frames, module_i2c_proto_i2s_switch_t *sw);
+
+/**
+ * @brief Advance every REG_COMMON_SET_PARAM_RAMP in progress by one audio block
+ *
+ * Call from the audio task once per block, after
+ * module_i2c_proto_next_timed_event() if timed writes are used. Ramps, like
+ * timed writes, always travel through the deferred queue; this call also
+ * applies queued writes. Each ramping parameter is stored at the value it
+ * reaches frames samples further on and its callbacks run, so the renderer
+ * can smooth between successive block values. While a ramp is pending,
+ * SET_PARAM writes for that parameter are queued even without
+ * deferred_apply so they stay ordered with it.
+ *
+ * @param frames Samples in the block
+ * @return Number of ramps still in progress
+ */
+size_t module_i2c_proto_ramp_process(uint32_t frames);
+
+#if CONFIG_I2C_PROTO_INLINE_HELPERS
+#include "module_i2c_proto_inline.h"
+#endif
 
 #endif /* MODULE_I2C_PROTO_H */
\ No newline at end of file
@@ -0,0 +1,285 @@
+#ifndef MODULE_I2C_PROTO_INLINE_H
+#define MODULE_I2C_PROTO_INLINE_H
+
+/**
+ * @file module_i2c_proto_inline.h
+ * @brief Bodies of the hot-path helpers marked I2C_PROTO_HELPER
+ *
+ * With CONFIG_I2C_PROTO_INLINE_HELPERS this file is included at the end of
+ * module_i2c_proto.h and every user gets static inline copies, so constant
+ * IDs and values fold into the caller. Otherwise module_i2c_proto.c
+ * includes it once to emit the ordinary out-of-line definitions. Do not
+ * include it directly.
+ */
+
+#include "module_i2c_proto.h"
+
+// Implementation for i2c_proto_param_find
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR const ParamDescriptor_t *i2c_proto_param_find(ParamId_t param_id)
+{
+    if (param_id >= I2C_PROTO_PARAM_ID_SPACE || i2c_proto_param_index[param_id] == 0)
+    {
+        return NULL; // Unknown parameter
+    }
+    return &i2c_proto_param_descriptors[i2c_proto_param_index[param_id] - 1];
+}
+
+// Implementation for i2c_proto_param_type
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR ParamType_t i2c_proto_param_type(ParamId_t param_id)
+{
+    const ParamDescriptor_t *desc = i2c_proto_param_find(param_id);
+    return desc ? (ParamType_t)desc->type : PARAM_TYPE_NONE;
+}
+
+// Implementation for i2c_proto_param_width
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR size_t i2c_proto_param_width(ParamType_t type)
+{
+    return (size_t)type <= PARAM_TYPE_U32 ? i2c_proto_param_type_widths[type] : 0;
+}
+
+// Implementation for i2c_proto_pack_set_param_msg
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR size_t i2c_proto_pack_set_param_msg(uint8_t *buf, size_t buf_len, ParamId_t param_id, ParamValue_t param_value)
+{
+    const size_t required_len = 1 + sizeof(SetParamPayload_t); // Command + Payload
+    if (!buf || buf_len < required_len)
+    {
+        return 0; // Error: Null buffer or buffer too small
+    }
+
+    buf[0] = REG_COMMON_SET_PARAM; // The command byte
+    i2c_proto_wr_le16(buf + 1 + offsetof(SetParamPayload_t, param_id), param_id);
+    i2c_proto_wr_le32(buf + 1 + offsetof(SetParamPayload_t, param_value), param_value.u32);
+
+    return required_len;
+}
+
+// Implementation for i2c_proto_unpack_set_param_payload
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR bool i2c_proto_unpack_set_param_payload(const uint8_t *payload_buf, size_t payload_len, ParamId_t *param_id, ParamValue_t *param_value)
+{
+    if (!payload_buf || !param_id || !param_value || payload_len != sizeof(SetParamPayload_t))
+    {
+        return false; // Error: Invalid args or length
+    }
+
+    const i2c_proto_set_param_view_t view = {.payload = payload_buf};
+    *param_id = i2c_proto_set_param_view_id(view);
+    param_value->u32 = i2c_proto_rd_le32(i2c_proto_set_param_view_value(view));
+
+    return true;
+}
+
+// Implementation for i2c_proto_pack_i2s_config_msg
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR size_t i2c_proto_pack_i2s_config_msg(uint8_t *buf, size_t buf_len, const I2sConfig_t *config)
+{
+    const size_t required_len = 1 + sizeof(I2sConfig_t); // Command + Payload
+    if (!buf || !config || buf_len < required_len)
+    {
+        return 0; // Error: Null buffer or buffer too small
+    }
+
+    buf[0] = REG_COMMON_I2S_CONFIG; // The command byte
+    buf[1 + offsetof(I2sConfig_t, tdm_slot_in)] = config->tdm_slot_in;
+    buf[1 + offsetof(I2sConfig_t, tdm_slot_out)] = config->tdm_slot_out;
+
+    return required_len;
+}
+
+// Implementation for i2c_proto_unpack_i2s_config_payload
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR bool i2c_proto_unpack_i2s_config_payload(const uint8_t *payload_buf, size_t payload_len, I2sConfig_t *config)
+{
+    if (!payload_buf || !config || payload_len != sizeof(I2sConfig_t))
+    {
+        return false; // Error: Invalid args or length
+    }
+
+    const i2c_proto_i2s_config_view_t view = {.payload = payload_buf};
+    config->tdm_slot_in = i2c_proto_i2s_config_view_slot_in(view);
+    config->tdm_slot_out = i2c_proto_i2s_config_view_slot_out(view);
+    return true;
+}
+
+// Implementation for i2c_proto_view_set_param
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR bool i2c_proto_view_set_param(const uint8_t *payload_buf, size_t payload_len, i2c_proto_set_param_view_t *view)
+{
+    if (!payload_buf || !view || payload_len != sizeof(SetParamPayload_t))
+    {
+        return false; // Error: Invalid args or length
+    }
+    view->payload = payload_buf;
+    return true;
+}
+
+// Implementation for i2c_proto_view_set_param_timed
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR bool i2c_proto_view_set_param_timed(const uint8_t *payload_buf, size_t payload_len, i2c_proto_set_param_timed_view_t *view)
+{
+    if (!payload_buf || !view || payload_len != sizeof(TimedSetParamPayload_t))
+    {
+        return false; // Error: Invalid args or length
+    }
+    view->payload = payload_buf;
+    return true;
+}
+
+// Implementation for i2c_proto_view_i2s_config
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR bool i2c_proto_view_i2s_config(const uint8_t *payload_buf, size_t payload_len, i2c_proto_i2s_config_view_t *view)
+{
+    if (!payload_buf || !view || payload_len != sizeof(I2sConfig_t))
+    {
+        return false; // Error: Invalid args or length
+    }
+    view->payload = payload_buf;
+    return true;
+}
+
+// Implementation for i2c_proto_view_get_param_range
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR bool i2c_proto_view_get_param_range(const uint8_t *payload_buf, size_t payload_len, i2c_proto_get_param_range_view_t *view)
+{
+    if (!payload_buf || !view || payload_len != sizeof(GetParamRangePayload_t))
+    {
+        return false; // Error: Invalid args or length
+    }
+    view->payload = payload_buf;
+    return true;
+}
+
+// Implementation for i2c_proto_view_set_param_ramp
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR bool i2c_proto_view_set_param_ramp(const uint8_t *payload_buf, size_t payload_len, i2c_proto_set_param_ramp_view_t *view)
+{
+    if (!payload_buf || !view || payload_len != sizeof(RampParamPayload_t))
+    {
+        return false; // Error: Invalid args or length
+    }
+    view->payload = payload_buf;
+    return true;
+}
+
+// Implementation for i2c_proto_batch_iter_init
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR bool i2c_proto_batch_iter_init(i2c_proto_batch_iter_t *iter, const uint8_t *payload_buf, size_t payload_len)
+{
+    if (!iter || !payload_buf || payload_len < 1)
+    {
+        return false; // Error: Invalid args or missing count byte
+    }
+
+    const uint8_t count = payload_buf[0];
+    if (count == 0 || count > I2C_PROTO_BATCH_MAX_PARAMS || payload_len != 1 + (size_t)count * I2C_PROTO_BATCH_ENTRY_LEN)
+    {
+        return false; // Error: Count does not match the received length
+    }
+
+    iter->cursor = payload_buf + 1;
+    iter->remaining = count;
+    return true;
+}
+
+// Implementation for i2c_proto_batch_iter_next
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR bool i2c_proto_batch_iter_next(i2c_proto_batch_iter_t *iter, ParamId_t *param_id, ParamValue_t *param_value)
+{
+    if (iter->remaining == 0)
+    {
+        return false; // All entries consumed
+    }
+
+    *param_id = i2c_proto_rd_le16(iter->cursor);
+    param_value->u32 = i2c_proto_rd_le32(iter->cursor + sizeof(ParamId_t));
+    iter->cursor += I2C_PROTO_BATCH_ENTRY_LEN;
+    iter->remaining--;
+
+    return true;
+}
+
+// Implementation for i2c_proto_batch_iter_next_view
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR bool i2c_proto_batch_iter_next_view(i2c_proto_batch_iter_t *iter, i2c_proto_param_entry_view_t *entry)
+{
+    if (iter->remaining == 0)
+    {
+        return false; // All entries consumed
+    }
+
+    entry->param_id = i2c_proto_rd_le16(iter->cursor);
+    entry->value = iter->cursor + sizeof(ParamId_t);
+    entry->width = sizeof(ParamValue_t);
+    iter->cursor += I2C_PROTO_BATCH_ENTRY_LEN;
+    iter->remaining--;
+
+    return true;
+}
+
+// Implementation for i2c_proto_compact_iter_next
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR bool i2c_proto_compact_iter_next(i2c_proto_batch_iter_t *iter, ParamId_t *param_id, ParamValue_t *param_value)
+{
+    if (iter->remaining == 0)
+    {
+        return false; // All entries consumed
+    }
+
+    const ParamId_t id = i2c_proto_rd_le16(iter->cursor);
+    const ParamType_t type = i2c_proto_param_type(id);
+    const size_t width = i2c_proto_param_width(type);
+
+    uint32_t value = 0;
+    for (size_t b = 0; b < width; b++)
+    {
+        value |= (uint32_t)iter->cursor[sizeof(ParamId_t) + b] << (8 * b);
+    }
+
+    *param_id = id;
+    if (type == PARAM_TYPE_S16)
+    {
+        param_value->s32 = (int16_t)value; // Sign-extend
+    }
+    else
+    {
+        param_value->u32 = value;
+    }
+
+    iter->cursor += sizeof(ParamId_t) + width;
+    iter->remaining--;
+    return true;
+}
+
+// Implementation for i2c_proto_compact_iter_next_view
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR bool i2c_proto_compact_iter_next_view(i2c_proto_batch_iter_t *iter, i2c_proto_param_entry_view_t *entry)
+{
+    if (iter->remaining == 0)
+    {
+        return false; // All entries consumed
+    }
+
+    // Entries were validated by i2c_proto_compact_iter_init(), so the ID is known
+    entry->param_id = i2c_proto_rd_le16(iter->cursor);
+    entry->value = iter->cursor + sizeof(ParamId_t);
+    entry->width = (uint8_t)i2c_proto_param_width(i2c_proto_param_type(entry->param_id));
+    iter->cursor += sizeof(ParamId_t) + entry->width;
+    iter->remaining--;
+    return true;
+}
+
+// Implementation for i2c_proto_frame_builder_append_param
+I2C_PROTO_HELPER I2C_PROTO_HELPER_ATTR bool i2c_proto_frame_builder_append_param(i2c_proto_frame_builder_t *builder, ParamId_t param_id, ParamValue_t param_value)
+{
+    const bool extend = builder->batch_count && *builder->batch_count < I2C_PROTO_BATCH_MAX_PARAMS;
+    const size_t required_len = (extend ? 0 : 2) + I2C_PROTO_BATCH_ENTRY_LEN; // [Command + Count] + Entry
+    if (builder->cap - builder->len < required_len)
+    {
+        return false; // Error: Frame buffer full
+    }
+
+    uint8_t *entry = builder->buf + builder->len;
+    if (!extend)
+    {
+        entry[0] = REG_COMMON_SET_PARAM_BATCH; // Open a new batch
+        entry[1] = 0;
+        builder->batch_count = entry + 1;
+        entry += 2;
+    }
+
+    i2c_proto_wr_le16(entry + offsetof(SetParamPayload_t, param_id), param_id);
+    i2c_proto_wr_le32(entry + offsetof(SetParamPayload_t, param_value), param_value.u32);
+    (*builder->batch_count)++;
+    builder->len += required_len;
+
+    return true;
+}
+
+#endif /* MODULE_I2C_PROTO_INLINE_H */
@@ -0,0 +1,335 @@
+#ifndef MODULE_I2C_PROTO_MASTER_H
+#define MODULE_I2C_PROTO_MASTER_H
+
+#include "module_i2c_proto.h"
+
+/**
+ * @file module_i2c_proto_master.h
+ * @brief Central Controller (I2C master) side helpers for the ESPSynth protocol
+ *
+ * These build on the pack helpers in module_i2c_proto.h and are used by the
+ * Central Controller's i2c_manager. Nothing here touches the I2C driver; the
+ * caller sends the frames produced.
+ */
+
+/**
+ * @defgroup module_keys Module Keys
+ * @brief Identify a slave by mux channel and address
+ * @{
+ */
+#define I2C_PROTO_MODULE_KEY(mux_channel, address) ((uint16_t)(((mux_channel) << 7) | ((address) & 0x7F))) /**< Key of a module behind a mux channel */
+#define I2C_PROTO_MODULE_KEY_CHANNEL(key)          ((uint8_t)((key) >> 7))   /**< Mux channel of a module key */
+#define I2C_PROTO_MODULE_KEY_ADDRESS(key)          ((uint8_t)((key) & 0x7F)) /**< 7-bit address of a module key */
+/** @} */
+
+/**
+ * @defgroup negotiation Capability Negotiation
+ * @brief Choosing the parameter write encoding per module link
+ *
+ * Modules on one rack may run different firmware. Each link uses the
+ * fastest encoding its module supports, taken from the capabilities in
+ * ModuleIdentity_t or, for modules older than REG_COMMON_IDENTITY, derived
+ * from REG_COMMON_FIRMWARE_VERSION. Faster firmware can then be rolled out
+ * module by module without slowing down the rest of the rack.
+ * @{
+ */
+
+/**
+ * @brief Encoding of parameter writes on one module link, slowest first
+ */
+typedef enum {
+    I2C_PROTO_ENCODING_SINGLE = 0, /**< One REG_COMMON_SET_PARAM per frame (any 2.x firmware) */
+    I2C_PROTO_ENCODING_BATCH,      /**< REG_COMMON_SET_PARAM_BATCH messages; the default */
+    I2C_PROTO_ENCODING_COMPACT,    /**< REG_COMMON_SET_PARAM_COMPACT messages, values sized by parameter type */
+} i2c_proto_encoding_t;
+/** @} */
+
+/**
+ * @brief Capabilities implied by a protocol version
+ *
+ * For modules that answer REG_COMMON_FIRMWARE_VERSION but not
+ * REG_COMMON_IDENTITY. 2.0 has batch and compact writes, timed writes,
+ * range reads and the dirty bitmap, 2.1 adds ramps, 2.2 groups, 2.3 CRC
+ * frames and 2.4 preset deltas. Other major versions get no optional
+ * features. Modules before 2.0 cannot be driven by this master at all: they
+ * expect every payload, SET_PARAM included, as an unpacked native struct,
+ * so check identity.version_major before talking to a module.
+ *
+ * @param version_major First byte of the REG_COMMON_FIRMWARE_VERSION response
+ * @param version_minor Second byte
+ * @return I2C_PROTO_CAP_* flags
+ */
+uint32_t i2c_proto_caps_from_version(uint8_t version_major, uint8_t version_minor);
+
+/**
+ * @brief Fastest parameter write encoding a module supports
+ *
+ * @param capabilities I2C_PROTO_CAP_* flags of the module
+ * @return I2C_PROTO_ENCODING_COMPACT, _BATCH or _SINGLE
+ */
+i2c_proto_encoding_t i2c_proto_negotiate_encoding(uint32_t capabilities);
+
+/**
+ * @defgroup coalescer Parameter Coalescing
+ * @brief Last-write-wins buffering of parameter updates per module
+ *
+ * Each update overwrites the pending value of the same (module, parameter)
+ * and sets its dirty bit, so a flush sends one entry per distinct dirty
+ * parameter no matter how many updates were queued in between.
+ * @{
+ */
+#define I2C_PROTO_COALESCE_MAX_MODULES 16 /**< Modules one coalescer can track */
+
+/**
+ * @brief Pending updates of one module
+ */
+typedef struct {
+    bool in_use;                                      /**< Slot assigned to module_key */
+    uint16_t module_key;                              /**< I2C_PROTO_MODULE_KEY() of the module */
+    uint8_t encoding;                                 /**< i2c_proto_encoding_t used by flush */
+    uint32_t dirty[I2C_PROTO_PARAM_BITMAP_WORDS];     /**< One bit per parameter index with a pending value */
+    ParamValue_t values[I2C_PROTO_PARAM_COUNT];       /**< Newest value per parameter index */
+} i2c_proto_coalesce_entry_t;
+
+/**
+ * @brief Coalescing stage for up to I2C_PROTO_COALESCE_MAX_MODULES modules
+ *
+ * Not thread-safe; use it from the task that owns the bus.
+ */
+typedef struct {
+    i2c_proto_coalesce_entry_t modules[I2C_PROTO_COALESCE_MAX_MODULES]; /**< Per-module state */
+} i2c_proto_coalescer_t;
+/** @} */
+
+/**
+ * @brief Initialize an empty coalescer
+ *
+ * @param[out] coalescer Coalescer to initialize
+ */
+void i2c_proto_coalescer_init(i2c_proto_coalescer_t *coalescer);
+
+/**
+ * @brief Record a parameter update, replacing any pending value for the same parameter
+ *
+ * @param coalescer Coalescer set up by i2c_proto_coalescer_init()
+ * @param module_key Target module, see I2C_PROTO_MODULE_KEY()
+ * @param param_id Target parameter
+ * @param param_value New value
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if param_id is not in the
+ *         parameter table, ESP_ERR_NO_MEM if all module slots are taken
+ */
+esp_err_t i2c_proto_coalescer_set(i2c_proto_coalescer_t *coalescer, uint16_t module_key, ParamId_t param_id, ParamValue_t param_value);
+
+/**
+ * @brief Select the encoding flush uses for a module
+ *
+ * Modules start with I2C_PROTO_ENCODING_BATCH. Pending updates are kept.
+ *
+ * @param coalescer Coalescer set up by i2c_proto_coalescer_init()
+ * @param module_key Module, see I2C_PROTO_MODULE_KEY()
+ * @param encoding Result of i2c_proto_negotiate_encoding()
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on an unknown encoding,
+ *         ESP_ERR_NO_MEM if all module slots are taken
+ */
+esp_err_t i2c_proto_coalescer_set_encoding(i2c_proto_coalescer_t *coalescer, uint16_t module_key, i2c_proto_encoding_t encoding);
+
+/**
+ * @brief Find a module with pending updates
+ *
+ * @param coalescer Coalescer set up by i2c_proto_coalescer_init()
+ * @param[out] module_key Key of a module with at least one dirty parameter
+ * @return true if such a module exists
+ */
+bool i2c_proto_coalescer_next_pending(const i2c_proto_coalescer_t *coalescer, uint16_t *module_key);
+
+/**
+ * @brief Pack the pending updates of one module into a frame
+ *
+ * With the batch encoding a single dirty parameter goes out as
+ * REG_COMMON_SET_PARAM, several as REG_COMMON_SET_PARAM_BATCH messages. The
+ * compact encoding uses REG_COMMON_SET_PARAM_COMPACT messages; the single
+ * encoding sends one REG_COMMON_SET_PARAM per frame, since such firmware may
+ * not take several messages in one write. Parameters that were packed are
+ * cleared; those that did not fit stay dirty for the next flush.
+ *
+ * @param coalescer Coalescer set up by i2c_proto_coalescer_init()
+ * @param module_key Module to flush
+ * @param[out] buf Frame buffer
+ * @param buf_len Size of buf
+ * @return Frame length in bytes, 0 if nothing is pending or buf is too small
+ */
+size_t i2c_proto_coalescer_flush(i2c_proto_coalescer_t *coalescer, uint16_t module_key, uint8_t *buf, size_t buf_len);
+
+/**
+ * @defgroup snapshot Parameter Snapshots
+ * @brief Struct-of-arrays copy of a module's parameters read with REG_COMMON_GET_PARAM_RANGE
+ * @{
+ */
+
+/**
+ * @brief All parameter values of one module, indexed by I2C_PROTO_PARAM_IDX_*
+ */
+typedef struct {
+    uint32_t present[I2C_PROTO_PARAM_BITMAP_WORDS]; /**< One bit per parameter index that has been read */
+    ParamValue_t values[I2C_PROTO_PARAM_COUNT];     /**< Value per parameter index */
+} i2c_proto_param_snapshot_t;
+/** @} */
+
+/**
+ * @brief Mark every parameter of a snapshot as not read
+ *
+ * @param[out] snapshot Snapshot to clear
+ */
+void i2c_proto_param_snapshot_clear(i2c_proto_param_snapshot_t *snapshot);
+
+/**
+ * @brief Merge a REG_COMMON_GET_PARAM_RANGE response into a snapshot
+ *
+ * Typical use: send i2c_proto_pack_get_param_range_msg(first = 0, last =
+ * 0xFFFF), read a block, unpack, and repeat from *next_first while *more is
+ * set.
+ *
+ * @param snapshot Snapshot to update
+ * @param resp_buf Bytes read from the slave
+ * @param resp_len Length of resp_buf
+ * @param[out] next_first First ID to request in the follow-up read
+ * @param[out] more Set to true if the slave has further entries in the range
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on NULL arguments,
+ *         ESP_ERR_INVALID_RESPONSE if the response is malformed
+ */
+esp_err_t i2c_proto_param_snapshot_unpack(i2c_proto_param_snapshot_t *snapshot, const uint8_t *resp_buf, size_t resp_len,
+                                          ParamId_t *next_first, bool *more);
+
+/**
+ * @brief Get a value from a snapshot
+ *
+ * @param snapshot Snapshot to read
+ * @param param_id Parameter to look up
+ * @param[out] param_value The value, if present
+ * @return true if the parameter is known and was read
+ */
+bool i2c_proto_param_snapshot_get(const i2c_proto_param_snapshot_t *snapshot, ParamId_t param_id, ParamValue_t *param_value);
+
+/**
+ * @brief Store a value in a snapshot and mark it present
+ *
+ * @param snapshot Snapshot to update
+ * @param param_id Parameter to set
+ * @param param_value The value
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if snapshot is NULL,
+ *         ESP_ERR_NOT_FOUND if the parameter is unknown
+ */
+esp_err_t i2c_proto_param_snapshot_set(i2c_proto_param_snapshot_t *snapshot, ParamId_t param_id, ParamValue_t param_value);
+
+/**
+ * @brief Merge every parameter write in a sent frame into a snapshot
+ *
+ * Keeps a per-module shadow of acknowledged values: call it with each frame
+ * the module accepted (SET_PARAM, batch, compact, timed, ramp targets and
+ * preset chunks, including ones inside group-write or CRC wrappers). Other
+ * messages are skipped.
+ *
+ * @param snapshot Shadow to update
+ * @param frame Frame as sent
+ * @param frame_len Length of frame
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on NULL arguments,
+ *         ESP_ERR_INVALID_SIZE if the frame is malformed (messages before the
+ *         bad one are merged)
+ */
+esp_err_t i2c_proto_param_snapshot_apply_frame(i2c_proto_param_snapshot_t *snapshot, const uint8_t *frame, size_t frame_len);
+
+/**
+ * @brief List the parameters flagged in a REG_COMMON_DIRTY_BITMAP response
+ *
+ * @param bitmap Bytes read from the slave
+ * @param bitmap_len Length of bitmap, normally I2C_PROTO_DIRTY_BITMAP_LEN
+ * @param[out] param_ids Receives the IDs of the dirty parameters
+ * @param max_ids Capacity of param_ids
+ * @return Number of IDs written
+ */
+size_t i2c_proto_dirty_bitmap_to_ids(const uint8_t *bitmap, size_t bitmap_len, ParamId_t *param_ids, size_t max_ids);
+
+/**
+ * @defgroup preset_loads Delta Preset Loads
+ * @brief Sending a preset as REG_COMMON_PRESET_DELTA chunks of changed values only
+ *
+ * The master keeps one i2c_proto_param_snapshot_t per module as a shadow of
+ * the values the module has acknowledged (filled from a
+ * REG_COMMON_GET_PARAM_RANGE read or by i2c_proto_param_snapshot_apply_frame()
+ * after each accepted write). A preset switch then sends only the parameters
+ * where the preset differs from the shadow, so most switches fit in one
+ * transaction:
+ *
+ * @code
+ * i2c_proto_preset_delta_t load;
+ * i2c_proto_preset_delta_begin(&load);
+ * size_t len;
+ * while ((len = i2c_proto_pack_preset_delta(&load, &shadow, &preset, buf, sizeof(buf))) > 0)
+ * {
+ *     if (i2c_write(module, buf, len) == ESP_OK)
+ *     {
+ *         i2c_proto_param_snapshot_apply_frame(&shadow, buf, len);
+ *     }
+ * }
+ * @endcode
+ * @{
+ */
+
+/**
+ * @brief Progress of one preset load
+ */
+typedef struct {
+    size_t next_index; /**< Parameter index the next chunk starts at */
+    bool started;      /**< First chunk has been produced */
+    bool done;         /**< Last chunk has been produced */
+} i2c_proto_preset_delta_t;
+
+/**
+ * @brief Start a preset load
+ *
+ * @param[out] load Load state to reset
+ */
+void i2c_proto_preset_delta_begin(i2c_proto_preset_delta_t *load);
+
+/**
+ * @brief Build the next REG_COMMON_PRESET_DELTA chunk
+ *
+ * Takes every parameter present in preset that is absent from shadow or
+ * differs from it (compared at the parameter's wire width), in index order,
+ * up to I2C_PROTO_BATCH_MAX_PARAMS entries or what fits in buf. The last
+ * chunk carries I2C_PROTO_PRESET_LAST, and is sent with no entries when
+ * nothing differs. shadow is only read; merge each chunk once the module
+ * accepted it.
+ *
+ * @param load Load state from i2c_proto_preset_delta_begin()
+ * @param shadow Values the module is known to have
+ * @param preset Values to load
+ * @param[out] buf Buffer receiving the chunk
+ * @param buf_len Size of buf, at least I2C_PROTO_PRESET_HEADER_LEN + I2C_PROTO_COMPACT_MAX_ENTRY_LEN
+ * @return Number of bytes written, 0 once the load is complete or on invalid arguments
+ */
+size_t i2c_proto_pack_preset_delta(i2c_proto_preset_delta_t *load, const i2c_proto_param_snapshot_t *shadow,
+                                   const i2c_proto_param_snapshot_t *preset, uint8_t *buf, size_t buf_len);
+/** @} */
+
+/**
+ * @defgroup group_write_routing Group Write Routing
+ * @brief Reaching every member of a group with one transaction
+ * @{
+ */
+
+/**
+ * @brief Mux channel bitmask covering a set of modules
+ *
+ * Write the result to a TCA9548A-style mux to open every channel holding a
+ * group member, then send the REG_COMMON_GROUP_WRITE once to
+ * I2C_PROTO_GENERAL_CALL_ADDR. Channels above 7 are ignored.
+ *
+ * @param module_keys I2C_PROTO_MODULE_KEY() of each group member
+ * @param count Number of keys
+ * @return Bit n set if channel n holds at least one of the modules
+ */
+uint8_t i2c_proto_group_mux_mask(const uint16_t *module_keys, size_t count);
+/** @} */
+
+#endif /* MODULE_I2C_PROTO_MASTER_H */
@@ -0,0 +1,363 @@
+#ifndef MODULE_I2C_PROTO_SCHED_H
+#define MODULE_I2C_PROTO_SCHED_H
+
+#include "module_i2c_proto_master.h"
+#include <stdatomic.h>
+#include "sdkconfig.h"
+
+/**
+ * @file module_i2c_proto_sched.h
+ * @brief Asynchronous transaction scheduler for the Central Controller (I2C master)
+ *
+ * Frames are enqueued without blocking per module (mux channel + address,
+ * see I2C_PROTO_MODULE_KEY()) and copied into a fixed pool. The bus task
+ * calls i2c_proto_sched_poll(), which issues one transfer at a time through
+ * the caller's asynchronous transport, serving modules on the currently
+ * selected mux channel first so the mux is switched as rarely as possible.
+ * Parameter updates passed to i2c_proto_sched_set_param() are coalesced
+ * and go out in each module's negotiated encoding (batch by default, see
+ * i2c_proto_sched_negotiate()). Nothing here allocates or blocks.
+ *
+ * Every frame has a priority class. A realtime frame is always started
+ * next, ahead of normal and bulk traffic and of the mux grouping, so a
+ * note-on waits at most for the transfer already on the bus. Bulk writes
+ * are split at message boundaries into segments of at most
+ * I2C_PROTO_SCHED_BULK_SEGMENT bytes, which bounds that transfer.
+ */
+
+/**
+ * @defgroup sched_config Scheduler Sizing
+ * @{
+ */
+#ifdef CONFIG_I2C_PROTO_SCHED_FRAMES
+#define I2C_PROTO_SCHED_FRAMES        CONFIG_I2C_PROTO_SCHED_FRAMES /**< Frames in the scheduler pool */
+#else
+#define I2C_PROTO_SCHED_FRAMES        16
+#endif
+#define I2C_PROTO_SCHED_MAX_TARGETS   I2C_PROTO_COALESCE_MAX_MODULES /**< Modules one scheduler can serve */
+#define I2C_PROTO_SCHED_MUX_BURST     8 /**< Transfers in a row on one mux channel while other channels wait */
+#ifdef CONFIG_I2C_PROTO_SCHED_BULK_SEGMENT
+#define I2C_PROTO_SCHED_BULK_SEGMENT  CONFIG_I2C_PROTO_SCHED_BULK_SEGMENT /**< Largest bulk write segment in bytes (a longer single message is sent whole) */
+#else
+#define I2C_PROTO_SCHED_BULK_SEGMENT  64
+#endif
+/** @} */
+
+/**
+ * @brief Priority classes, highest first
+ */
+typedef enum {
+    I2C_PROTO_SCHED_REALTIME = 0, /**< Note and pitch changes; coalesced updates use this class */
+    I2C_PROTO_SCHED_NORMAL,       /**< Default for i2c_proto_sched_enqueue() */
+    I2C_PROTO_SCHED_BULK,         /**< Preset dumps, snapshot reads, save/load; segmented */
+    I2C_PROTO_SCHED_PRIO_COUNT
+} i2c_proto_sched_prio_t;
+
+/**
+ * @brief Completion of an enqueued frame
+ *
+ * Runs from i2c_proto_sched_poll() in the bus task.
+ *
+ * @param user_data Pointer given at enqueue
+ * @param err Result of the transfer (or of the mux switch before it)
+ * @param resp Response buffer given at enqueue, NULL for writes
+ * @param resp_len Bytes read into resp
+ */
+typedef void (*i2c_proto_sched_done_cb_t)(void *user_data, esp_err_t err, uint8_t *resp, size_t resp_len);
+
+/**
+ * @brief Asynchronous I2C transport supplied by the caller
+ *
+ * Each operation only starts a transfer and returns. When it finishes (in
+ * any context, including the I2C ISR) the transport calls
+ * i2c_proto_sched_io_done(). An error returned when starting counts as a
+ * finished transfer with that error.
+ */
+typedef struct {
+    /** Open the mux channels in channel_mask (bit n = channel n); NULL if there is no mux */
+    esp_err_t (*select_channel)(void *ctx, uint8_t channel_mask);
+    /** Write len bytes to the 7-bit address */
+    esp_err_t (*write_async)(void *ctx, uint8_t address, const uint8_t *data, size_t len);
+    /** Write len bytes, then read up to resp_cap bytes back (repeated START) */
+    esp_err_t (*write_read_async)(void *ctx, uint8_t address, const uint8_t *data, size_t len, uint8_t *resp, size_t resp_cap);
+    void *ctx; /**< Passed to every operation */
+} i2c_proto_sched_transport_t;
+
+/**
+ * @brief Pooled frame waiting for (or in) transfer
+ */
+typedef struct {
+    uint8_t data[I2C_PROTO_MAX_FRAME_LEN];
+    uint16_t len;
+    uint16_t module_key;
+    uint8_t next;                    /**< Next frame of the same queue, or of the free list */
+    uint8_t prio;                    /**< i2c_proto_sched_prio_t */
+    bool more;                       /**< Not the last segment of a bulk write; done runs after the last */
+    esp_err_t err;                   /**< First error of earlier segments */
+    uint8_t *resp;                   /**< Read buffer, NULL for a plain write */
+    size_t resp_cap;
+    i2c_proto_sched_done_cb_t done;  /**< May be NULL */
+    void *user_data;
+} i2c_proto_sched_frame_t;
+
+/**
+ * @brief FIFOs of frames for one module, one per priority class
+ */
+typedef struct {
+    bool in_use;
+    uint16_t module_key;
+    uint8_t head[I2C_PROTO_SCHED_PRIO_COUNT]; /**< Oldest queued frame */
+    uint8_t tail[I2C_PROTO_SCHED_PRIO_COUNT]; /**< Newest queued frame */
+} i2c_proto_sched_target_t;
+
+/**
+ * @brief Scheduler state; caller-owned, normally static
+ */
+typedef struct {
+    i2c_proto_sched_transport_t transport;
+    i2c_proto_sched_frame_t frames[I2C_PROTO_SCHED_FRAMES];
+    uint8_t free;                    /**< Head of the free frame list */
+    uint8_t free_count;              /**< Frames on the free list */
+    i2c_proto_sched_target_t targets[I2C_PROTO_SCHED_MAX_TARGETS];
+    i2c_proto_coalescer_t coalescer; /**< Pending i2c_proto_sched_set_param() updates */
+    int16_t mux_channel;             /**< Channel currently open, -1 if unknown */
+    uint8_t burst;                   /**< Transfers since the last mux switch */
+    uint8_t next_target;             /**< Round-robin start for the next pick */
+    uint8_t state;                   /**< Internal transfer state */
+    uint8_t active;                  /**< Frame being transferred */
+    atomic_bool io_pending;          /**< Set when a transfer starts, cleared by i2c_proto_sched_io_done() */
+    esp_err_t io_err;
+    size_t io_resp_len;
+    uint32_t mux_switches;           /**< Statistics: channel selections issued */
+    uint32_t transfers;              /**< Statistics: frames completed */
+} i2c_proto_sched_t;
+
+/**
+ * @brief Reset a scheduler
+ *
+ * @param[out] sched Scheduler to initialize
+ * @param transport Asynchronous transport; write_async is required
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on NULL arguments or a missing operation
+ */
+esp_err_t i2c_proto_sched_init(i2c_proto_sched_t *sched, const i2c_proto_sched_transport_t *transport);
+
+/**
+ * @brief Queue a write or write-read to a module in a priority class
+ *
+ * The frame is copied, so buf can be reused immediately. Frames to the same
+ * module in the same class go out in order; a higher class overtakes lower
+ * ones. A bulk write longer than I2C_PROTO_SCHED_BULK_SEGMENT is split into
+ * segments (each a pool frame) at message boundaries; done then runs once,
+ * after the last segment, with the first error of any segment.
+ *
+ * @param sched Scheduler
+ * @param module_key I2C_PROTO_MODULE_KEY() of the target
+ * @param prio Priority class
+ * @param buf Frame to send (one or more complete messages)
+ * @param len Length of buf, at most I2C_PROTO_MAX_FRAME_LEN
+ * @param resp Response buffer for a write-read, NULL for a write
+ * @param resp_cap Size of resp
+ * @param done Completion callback, may be NULL
+ * @param user_data Passed to done
+ * @return ESP_OK if queued, ESP_ERR_INVALID_ARG on invalid arguments
+ *         (including a bulk write that is not a sequence of complete
+ *         messages), ESP_ERR_NO_MEM if the frame pool or the target table
+ *         is full
+ */
+esp_err_t i2c_proto_sched_enqueue_prio(i2c_proto_sched_t *sched, uint16_t module_key, i2c_proto_sched_prio_t prio,
+                                       const uint8_t *buf, size_t len, uint8_t *resp, size_t resp_cap,
+                                       i2c_proto_sched_done_cb_t done, void *user_data);
+
+/**
+ * @brief Queue a write to a module (normal class)
+ *
+ * The frame is copied, so buf can be reused immediately. Frames to the same
+ * module go out in order.
+ *
+ * @param sched Scheduler
+ * @param module_key I2C_PROTO_MODULE_KEY() of the target
+ * @param buf Frame to send (one or more complete messages)
+ * @param len Length of buf, at most I2C_PROTO_MAX_FRAME_LEN
+ * @param done Completion callback, may be NULL
+ * @param user_data Passed to done
+ * @return ESP_OK if queued, ESP_ERR_INVALID_ARG on invalid arguments,
+ *         ESP_ERR_NO_MEM if the frame pool or the target table is full
+ */
+esp_err_t i2c_proto_sched_enqueue(i2c_proto_sched_t *sched, uint16_t module_key, const uint8_t *buf, size_t len,
+                                  i2c_proto_sched_done_cb_t done, void *user_data);
+
+/**
+ * @brief Queue a write followed by a read (register read, GET_PARAM_RANGE, ...)
+ *
+ * Same as i2c_proto_sched_enqueue() (normal class); resp must stay valid
+ * until done runs.
+ *
+ * @param resp Buffer receiving the response
+ * @param resp_cap Size of resp
+ */
+esp_err_t i2c_proto_sched_enqueue_read(i2c_proto_sched_t *sched, uint16_t module_key, const uint8_t *buf, size_t len,
+                                       uint8_t *resp, size_t resp_cap, i2c_proto_sched_done_cb_t done, void *user_data);
+
+/**
+ * @brief Record a parameter update for coalesced sending
+ *
+ * Replaces any pending value of the same (module, parameter). Pending
+ * updates for a module go out as one realtime frame ahead of its queued
+ * realtime frames, so do not also enqueue explicit writes of the same
+ * parameter. The flush needs a pool frame; while every frame is queued, the
+ * queued frames go out first until one is free.
+ *
+ * @return Same as i2c_proto_coalescer_set()
+ */
+esp_err_t i2c_proto_sched_set_param(i2c_proto_sched_t *sched, uint16_t module_key, ParamId_t param_id, ParamValue_t param_value);
+
+/**
+ * @brief Select the parameter write encoding for a module's coalesced updates
+ *
+ * @param sched Scheduler
+ * @param module_key I2C_PROTO_MODULE_KEY() of the module
+ * @param encoding Result of i2c_proto_negotiate_encoding()
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid arguments,
+ *         ESP_ERR_NO_MEM if the target table is full
+ */
+esp_err_t i2c_proto_sched_set_encoding(i2c_proto_sched_t *sched, uint16_t module_key, i2c_proto_encoding_t encoding);
+
+/**
+ * @brief Report completion of the operation last started by the scheduler
+ *
+ * Called by the transport; ISR-safe.
+ *
+ * @param sched Scheduler
+ * @param err Result of the operation
+ * @param resp_len Bytes read for write_read_async, 0 otherwise
+ */
+void i2c_proto_sched_io_done(i2c_proto_sched_t *sched, esp_err_t err, size_t resp_len);
+
+/**
+ * @brief Advance the scheduler; call from the bus task
+ *
+ * Finishes a completed transfer (running its callback) and starts the next
+ * one. Returns after starting at most one operation, so call it again
+ * whenever the transport signals completion.
+ *
+ * @param sched Scheduler
+ * @return true while a transfer is in flight or work is queued
+ */
+bool i2c_proto_sched_poll(i2c_proto_sched_t *sched);
+
+/**
+ * @defgroup module_enum Module Enumeration
+ * @brief Boot-time discovery of every module behind every mux channel
+ *
+ * Instead of probing each address and then reading MODULE_TYPE,
+ * FIRMWARE_VERSION and STATUS one after another, the enumerator keeps the
+ * bus busy with back-to-back transfers through the same asynchronous
+ * transport the scheduler uses:
+ *
+ * 1. With every scanned mux channel open at once, each address in the range
+ *    gets a one-byte REG_COMMON_MODULE_TYPE write. An acknowledge means a
+ *    module answers there on at least one channel; most addresses are ruled
+ *    out for all channels with a single NACK.
+ * 2. Channel by channel, each of those addresses gets one REG_COMMON_IDENTITY
+ *    read, which returns everything boot needs.
+ *
+ * Step 1 is skipped without a mux, with a single channel, or if the mux
+ * refuses to open all channels. Keep the mux's own address out of the
+ * range. A module that acknowledges but has no REG_COMMON_IDENTITY (protocol
+ * before 2.5) is read the old way (FIRMWARE_VERSION, MODULE_TYPE, STATUS);
+ * its capabilities then come from i2c_proto_caps_from_version() and
+ * param_count is 0. Pass the results to i2c_proto_sched_negotiate().
+ * @{
+ */
+
+/**
+ * @brief Module found by the enumerator
+ */
+typedef struct {
+    uint16_t module_key;       /**< I2C_PROTO_MODULE_KEY() of the module (channel 0 without a mux) */
+    ModuleIdentity_t identity; /**< Its REG_COMMON_IDENTITY response */
+} i2c_proto_enum_result_t;
+
+/**
+ * @brief Enumerator state; caller-owned
+ */
+typedef struct {
+    i2c_proto_sched_transport_t transport;
+    i2c_proto_enum_result_t *results; /**< Caller's result array */
+    size_t max_results;               /**< Entries in results */
+    size_t count;                     /**< Modules found; only the first max_results are stored */
+    uint8_t channel_mask;             /**< Mux channels to scan */
+    uint8_t first_address;            /**< Lowest address to scan */
+    uint8_t last_address;             /**< Highest address to scan */
+    uint8_t candidates[16];           /**< Bit n: address n acknowledged (or was not probed) */
+    uint8_t phase;                    /**< Internal scan phase */
+    uint8_t op;                       /**< Internal operation in flight */
+    int8_t channel;                   /**< Channel being identified, -1 before the first */
+    uint8_t address;                  /**< Next address of the current pass */
+    uint8_t cmd;                      /**< Command byte of the operation in flight */
+    uint8_t resp[sizeof(ModuleIdentity_t)];
+    uint8_t legacy_op;                /**< Next fallback read for a module without REG_COMMON_IDENTITY */
+    ModuleIdentity_t legacy;          /**< Identity assembled by the fallback reads */
+    atomic_bool io_pending;           /**< Set when an operation starts, cleared by i2c_proto_enum_io_done() */
+    esp_err_t io_err;
+    size_t io_resp_len;
+    uint32_t transfers;               /**< Statistics: operations issued, mux switches included */
+} i2c_proto_enum_t;
+
+/**
+ * @brief Give every enumerated module the fastest encoding it supports
+ *
+ * Calls i2c_proto_sched_set_encoding() with
+ * i2c_proto_negotiate_encoding() of each module's capabilities.
+ *
+ * @param sched Scheduler
+ * @param results Modules found by the enumerator
+ * @param count Entries in results
+ * @return ESP_OK on success, otherwise the first error of i2c_proto_sched_set_encoding()
+ */
+esp_err_t i2c_proto_sched_negotiate(i2c_proto_sched_t *sched, const i2c_proto_enum_result_t *results, size_t count);
+
+/**
+ * @brief Start enumerating modules
+ *
+ * Nothing is sent until the first i2c_proto_enum_poll().
+ *
+ * @param[out] en Enumerator to initialize
+ * @param transport Asynchronous transport; write_async and write_read_async are required
+ * @param channel_mask Mux channels to scan (bit n = channel n); ignored without select_channel
+ * @param first_address Lowest 7-bit address to scan
+ * @param last_address Highest 7-bit address to scan
+ * @param[out] results Array receiving the modules found, in channel then address order
+ * @param max_results Entries in results
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on NULL arguments, a missing
+ *         operation, an empty channel mask or an invalid address range
+ */
+esp_err_t i2c_proto_enum_start(i2c_proto_enum_t *en, const i2c_proto_sched_transport_t *transport, uint8_t channel_mask,
+                               uint8_t first_address, uint8_t last_address, i2c_proto_enum_result_t *results, size_t max_results);
+
+/**
+ * @brief Report completion of the operation last started by the enumerator
+ *
+ * Called by the transport; ISR-safe. A NACK must be reported as an error.
+ *
+ * @param en Enumerator
+ * @param err Result of the operation
+ * @param resp_len Bytes read for write_read_async, 0 otherwise
+ */
+void i2c_proto_enum_io_done(i2c_proto_enum_t *en, esp_err_t err, size_t resp_len);
+
+/**
+ * @brief Advance the enumeration; call from the bus task
+ *
+ * Finishes a completed operation and starts the next one, like
+ * i2c_proto_sched_poll(). Do not run the scheduler on the same bus at the
+ * same time.
+ *
+ * @param en Enumerator
+ * @return true while the scan is running, false once en->count is final
+ */
+bool i2c_proto_enum_poll(i2c_proto_enum_t *en);
+
+/** @} */
+
+#endif /* MODULE_I2C_PROTO_SCHED_H */
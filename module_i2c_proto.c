@@ -1,68 +1,627 @@
 #include "module_i2c_proto.h"
-#include <string.h> // For memcpy
 #include <stdint.h>
+#include <stddef.h> // For offsetof
+#include <string.h> // For memmove
 
-// Implementation for i2c_proto_pack_set_param_msg
-size_t i2c_proto_pack_set_param_msg(uint8_t *buf, size_t buf_len, ParamId_t param_id, ParamValue_t param_value)
+#define PARAM_DESCRIPTOR_(name, ptype, lo, hi)                         \
+    [I2C_PROTO_PARAM_IDX_##name] = {                                   \
+        .id = (name),                                                  \
+        .type = PARAM_TYPE_##ptype,                                    \
+        .width = sizeof(I2C_PROTO_CTYPE_##ptype),                      \
+        .offset = offsetof(module_i2c_proto_params_t, name##_value),   \
+        .min = (lo),                                                   \
+        .max = (hi),                                                   \
+    },
+
+I2C_PROTO_TABLE_ATTR const ParamDescriptor_t i2c_proto_param_descriptors[I2C_PROTO_PARAM_COUNT] = {
+    I2C_PROTO_PARAM_LIST(PARAM_DESCRIPTOR_)
+};
+
+_Static_assert(I2C_PROTO_PARAM_COUNT < UINT8_MAX, "Parameter index must fit the uint8_t lookup table");
+
+// Descriptor index + 1 of every parameter, indexed by ID (0 = unknown)
+#define PARAM_INDEX_(name, ptype, lo, hi) [name] = I2C_PROTO_PARAM_IDX_##name + 1,
+
+I2C_PROTO_TABLE_ATTR const uint8_t i2c_proto_param_index[I2C_PROTO_PARAM_ID_SPACE] = {
+    I2C_PROTO_PARAM_LIST(PARAM_INDEX_)
+};
+
+// Value bytes per ParamType_t in compact frames
+I2C_PROTO_TABLE_ATTR const uint8_t i2c_proto_param_type_widths[PARAM_TYPE_U32 + 1] = {
+    [PARAM_TYPE_NONE] = 0,
+    [PARAM_TYPE_U8] = 1,
+    [PARAM_TYPE_U16] = 2,
+    [PARAM_TYPE_S16] = 2,
+    [PARAM_TYPE_U32] = 4,
+};
+
+#if !CONFIG_I2C_PROTO_INLINE_HELPERS
+#include "module_i2c_proto_inline.h" // Out-of-line definitions of the I2C_PROTO_HELPER functions
+#endif
+
+// Length of the compact entry starting at buf, 0 if the ID is unknown
+static size_t compact_entry_len(const uint8_t *buf)
+{
+    const ParamId_t param_id = i2c_proto_rd_le16(buf);
+    const size_t width = i2c_proto_param_width(i2c_proto_param_type(param_id));
+    return width ? sizeof(ParamId_t) + width : 0;
+}
+
+// Length of `count` compact entries starting at entries, 0 if malformed
+static size_t compact_entries_len(const uint8_t *entries, size_t len, uint8_t count)
+{
+    size_t offset = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (len - offset < sizeof(ParamId_t))
+        {
+            return 0; // Error: Truncated entry
+        }
+        const size_t entry_len = compact_entry_len(entries + offset);
+        if (entry_len == 0 || len - offset < entry_len)
+        {
+            return 0; // Error: Unknown ID or truncated value
+        }
+        offset += entry_len;
+    }
+
+    return offset;
+}
+
+// Length of a compact payload (count byte included), 0 if malformed
+static size_t compact_payload_len(const uint8_t *payload_buf, size_t payload_len)
+{
+    if (payload_len < 1)
+    {
+        return 0; // Error: Count byte missing
+    }
+
+    const uint8_t count = payload_buf[0];
+    if (count == 0 || count > I2C_PROTO_BATCH_MAX_PARAMS)
+    {
+        return 0; // Error: Invalid count
+    }
+
+    const size_t entries_len = compact_entries_len(payload_buf + 1, payload_len - 1, count);
+    return entries_len ? 1 + entries_len : 0;
+}
+
+// Implementation for i2c_proto_pack_set_param_timed_msg
+size_t i2c_proto_pack_set_param_timed_msg(uint8_t *buf, size_t buf_len, uint32_t frame, ParamId_t param_id, ParamValue_t param_value)
 {
-    const size_t required_len = 1 + sizeof(SetParamPayload_t); // Command + Payload
+    const size_t required_len = 1 + sizeof(TimedSetParamPayload_t); // Command + Payload
     if (!buf || buf_len < required_len)
     {
         return 0; // Error: Null buffer or buffer too small
     }
 
-    SetParamPayload_t payload = {
-        .param_id = param_id, // Assuming direct assignment works (check endianness if MCUs differ, unlikely here)
-        .param_value = param_value
-    };
-
-    buf[0] = REG_COMMON_SET_PARAM; // The command byte
-    memcpy(buf + 1, &payload, sizeof(SetParamPayload_t));
+    buf[0] = REG_COMMON_SET_PARAM_TIMED; // The command byte
+    i2c_proto_wr_le32(buf + 1 + offsetof(TimedSetParamPayload_t, frame), frame);
+    i2c_proto_wr_le16(buf + 1 + offsetof(TimedSetParamPayload_t, param.param_id), param_id);
+    i2c_proto_wr_le32(buf + 1 + offsetof(TimedSetParamPayload_t, param.param_value), param_value.u32);
 
     return required_len;
 }
 
-// Implementation for i2c_proto_unpack_set_param_payload
-bool i2c_proto_unpack_set_param_payload(const uint8_t *payload_buf, size_t payload_len, ParamId_t *param_id, ParamValue_t *param_value)
+// Implementation for i2c_proto_unpack_set_param_timed_payload
+bool i2c_proto_unpack_set_param_timed_payload(const uint8_t *payload_buf, size_t payload_len, uint32_t *frame, ParamId_t *param_id, ParamValue_t *param_value)
 {
-    if (!payload_buf || !param_id || !param_value || payload_len != sizeof(SetParamPayload_t))
+    if (!payload_buf || !frame || !param_id || !param_value || payload_len != sizeof(TimedSetParamPayload_t))
     {
         return false; // Error: Invalid args or length
     }
 
-    SetParamPayload_t payload;
-    memcpy(&payload, payload_buf, sizeof(SetParamPayload_t));
-
-    *param_id = payload.param_id; // Assuming direct assignment works
-    *param_value = payload.param_value;
+    const i2c_proto_set_param_timed_view_t view = {.payload = payload_buf};
+    *frame = i2c_proto_set_param_timed_view_frame(view);
+    *param_id = i2c_proto_set_param_timed_view_id(view);
+    param_value->u32 = i2c_proto_rd_le32(i2c_proto_set_param_timed_view_value(view));
 
     return true;
 }
 
-// Implementation for i2c_proto_pack_i2s_config_msg
-size_t i2c_proto_pack_i2s_config_msg(uint8_t *buf, size_t buf_len, const I2sConfig_t *config)
+// Implementation for i2c_proto_pack_get_param_range_msg
+size_t i2c_proto_pack_get_param_range_msg(uint8_t *buf, size_t buf_len, ParamId_t first, ParamId_t last)
+{
+    const size_t required_len = 1 + sizeof(GetParamRangePayload_t); // Command + Payload
+    if (!buf || buf_len < required_len)
+    {
+        return 0; // Error: Null buffer or buffer too small
+    }
+
+    buf[0] = REG_COMMON_GET_PARAM_RANGE; // The command byte
+    i2c_proto_wr_le16(buf + 1 + offsetof(GetParamRangePayload_t, first), first);
+    i2c_proto_wr_le16(buf + 1 + offsetof(GetParamRangePayload_t, last), last);
+
+    return required_len;
+}
+
+// Implementation for i2c_proto_pack_i2s_stage_msg
+size_t i2c_proto_pack_i2s_stage_msg(uint8_t *buf, size_t buf_len, const I2sConfig_t *config)
 {
     const size_t required_len = 1 + sizeof(I2sConfig_t); // Command + Payload
     if (!buf || !config || buf_len < required_len)
+    {
+        return 0; // Error: Invalid args or buffer too small
+    }
+
+    buf[0] = REG_COMMON_I2S_STAGE; // The command byte
+    buf[1 + offsetof(I2sConfig_t, tdm_slot_in)] = config->tdm_slot_in;
+    buf[1 + offsetof(I2sConfig_t, tdm_slot_out)] = config->tdm_slot_out;
+
+    return required_len;
+}
+
+// Implementation for i2c_proto_pack_i2s_commit_msg
+size_t i2c_proto_pack_i2s_commit_msg(uint8_t *buf, size_t buf_len, uint32_t frame)
+{
+    const size_t required_len = 1 + sizeof(I2sCommitPayload_t); // Command + Payload
+    if (!buf || buf_len < required_len)
     {
         return 0; // Error: Null buffer or buffer too small
     }
 
-    buf[0] = REG_COMMON_I2S_CONFIG; // The command byte
-    memcpy(buf + 1, config, sizeof(I2sConfig_t));
+    buf[0] = REG_COMMON_I2S_COMMIT; // The command byte
+    i2c_proto_wr_le32(buf + 1 + offsetof(I2sCommitPayload_t, frame), frame);
 
     return required_len;
 }
 
-// Implementation for i2c_proto_unpack_i2s_config_payload
-bool i2c_proto_unpack_i2s_config_payload(const uint8_t *payload_buf, size_t payload_len, I2sConfig_t *config)
+// Implementation for i2c_proto_pack_diag_msg
+size_t i2c_proto_pack_diag_msg(uint8_t *buf, size_t buf_len, uint8_t cmd, uint8_t flags)
 {
-    if (!payload_buf || !config || payload_len != sizeof(I2sConfig_t))
+    const size_t required_len = 1 + sizeof(DiagRequestPayload_t); // Command + Payload
+    if (!buf || buf_len < required_len)
     {
-        return false; // Error: Invalid args or length
+        return 0; // Error: Null buffer or buffer too small
     }
-    memcpy(config, payload_buf, sizeof(I2sConfig_t));
+
+    buf[0] = REG_COMMON_DIAG; // The command byte
+    buf[1 + offsetof(DiagRequestPayload_t, cmd)] = cmd;
+    buf[1 + offsetof(DiagRequestPayload_t, flags)] = flags;
+
+    return required_len;
+}
+
+// Implementation for i2c_proto_pack_set_param_ramp_msg
+size_t i2c_proto_pack_set_param_ramp_msg(uint8_t *buf, size_t buf_len, ParamId_t param_id, ParamValue_t target, uint32_t ramp_samples)
+{
+    const size_t required_len = 1 + sizeof(RampParamPayload_t); // Command + Payload
+    if (!buf || buf_len < required_len)
+    {
+        return 0; // Error: Null buffer or buffer too small
+    }
+
+    buf[0] = REG_COMMON_SET_PARAM_RAMP; // The command byte
+    i2c_proto_wr_le16(buf + 1 + offsetof(RampParamPayload_t, param_id), param_id);
+    i2c_proto_wr_le32(buf + 1 + offsetof(RampParamPayload_t, target), target.u32);
+    i2c_proto_wr_le32(buf + 1 + offsetof(RampParamPayload_t, ramp_samples), ramp_samples);
+
+    return required_len;
+}
+
+// Implementation for i2c_proto_pack_group_config_msg
+size_t i2c_proto_pack_group_config_msg(uint8_t *buf, size_t buf_len, uint8_t group_mask)
+{
+    if (!buf || buf_len < 2)
+    {
+        return 0; // Error: Null buffer or buffer too small
+    }
+
+    buf[0] = REG_COMMON_GROUP_CONFIG; // The command byte
+    buf[1] = group_mask;
+    return 2;
+}
+
+// Implementation for i2c_proto_cmd_capability
+uint32_t i2c_proto_cmd_capability(uint8_t cmd)
+{
+    switch (cmd)
+    {
+    case REG_COMMON_SET_PARAM_BATCH:
+        return I2C_PROTO_CAP_BATCH;
+    case REG_COMMON_SET_PARAM_COMPACT:
+        return I2C_PROTO_CAP_COMPACT;
+    case REG_COMMON_SET_PARAM_TIMED:
+        return I2C_PROTO_CAP_TIMED;
+    case REG_COMMON_GET_PARAM_RANGE:
+        return I2C_PROTO_CAP_RANGE_READ;
+    case REG_COMMON_DIRTY_BITMAP:
+        return I2C_PROTO_CAP_DIRTY_BITMAP;
+    case REG_COMMON_SET_PARAM_RAMP:
+        return I2C_PROTO_CAP_RAMP;
+    case REG_COMMON_GROUP_CONFIG:
+    case REG_COMMON_GROUP_WRITE:
+        return I2C_PROTO_CAP_GROUP;
+    case REG_COMMON_CRC_FRAME:
+        return I2C_PROTO_CAP_CRC;
+    case REG_COMMON_PRESET_DELTA:
+        return I2C_PROTO_CAP_PRESET_DELTA;
+    case REG_COMMON_DIAG:
+        return I2C_PROTO_CAP_DIAG;
+    case REG_COMMON_I2S_STAGE:
+    case REG_COMMON_I2S_COMMIT:
+        return I2C_PROTO_CAP_I2S_STAGED;
+    default:
+        return 0;
+    }
+}
+
+// Implementation for i2c_proto_group_write_allowed
+bool i2c_proto_group_write_allowed(uint8_t cmd)
+{
+    switch (cmd)
+    {
+    case REG_COMMON_SET_PARAM:
+    case REG_COMMON_SET_PARAM_BATCH:
+    case REG_COMMON_SET_PARAM_COMPACT:
+    case REG_COMMON_SET_PARAM_TIMED:
+    case REG_COMMON_SET_PARAM_RAMP:
+    case REG_COMMON_I2S_COMMIT:
+    case CMD_COMMON_RESET:
+    case CMD_COMMON_SAVE_SETTINGS:
+    case CMD_COMMON_LOAD_SETTINGS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Implementation for i2c_proto_pack_group_write_msg
+size_t i2c_proto_pack_group_write_msg(uint8_t *buf, size_t buf_len, uint8_t group_mask, const uint8_t *msg, size_t msg_len)
+{
+    if (!buf || !msg || msg_len == 0 || !i2c_proto_group_write_allowed(msg[0]) ||
+        i2c_proto_msg_len(msg, msg_len) != msg_len)
+    {
+        return 0; // Error: Not exactly one groupable message
+    }
+    const size_t required_len = I2C_PROTO_GROUP_HEADER_LEN + msg_len;
+    if (buf_len < required_len)
+    {
+        return 0; // Error: Buffer too small
+    }
+
+    memmove(buf + I2C_PROTO_GROUP_HEADER_LEN, msg, msg_len); // msg may already live inside buf
+    buf[0] = REG_COMMON_GROUP_WRITE; // The command byte
+    buf[1] = group_mask;
+    return required_len;
+}
+
+// CRC-8, polynomial 0x07: crc8_table[i] is the CRC of the single byte i
+static I2C_PROTO_TABLE_ATTR const uint8_t crc8_table[256] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3,
+};
+
+// Implementation for i2c_proto_crc8
+uint8_t i2c_proto_crc8(uint8_t crc, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = crc8_table[crc ^ data[i]];
+    }
+    return crc;
+}
+
+// Implementation for i2c_proto_pack_crc_frame
+size_t i2c_proto_pack_crc_frame(uint8_t *buf, size_t buf_len, const uint8_t *frame, size_t frame_len)
+{
+    if (!buf || !frame || frame_len == 0 || frame_len > I2C_PROTO_CRC_MAX_INNER_LEN)
+    {
+        return 0; // Error: Invalid args or frame too long
+    }
+    const size_t required_len = I2C_PROTO_CRC_HEADER_LEN + frame_len;
+    if (buf_len < required_len)
+    {
+        return 0; // Error: Buffer too small
+    }
+
+    memmove(buf + I2C_PROTO_CRC_HEADER_LEN, frame, frame_len); // frame may already live inside buf
+    buf[0] = REG_COMMON_CRC_FRAME; // The command byte
+    buf[1] = (uint8_t)frame_len;
+    buf[2] = i2c_proto_crc8(i2c_proto_crc8(0, &buf[1], 1), buf + I2C_PROTO_CRC_HEADER_LEN, frame_len);
+    return required_len;
+}
+
+// Implementation for i2c_proto_range_resp_iter_init
+bool i2c_proto_range_resp_iter_init(i2c_proto_batch_iter_t *iter, const uint8_t *resp_buf, size_t resp_len, bool *more)
+{
+    if (!iter || !resp_buf || !more || resp_len < I2C_PROTO_RANGE_RESP_HEADER_LEN)
+    {
+        return false; // Error: Invalid args or header missing
+    }
+
+    const uint8_t count = resp_buf[0];
+    const uint8_t *entries = resp_buf + I2C_PROTO_RANGE_RESP_HEADER_LEN;
+    if (count > 0 && compact_entries_len(entries, resp_len - I2C_PROTO_RANGE_RESP_HEADER_LEN, count) == 0)
+    {
+        return false; // Error: Unknown ID or truncated entry
+    }
+
+    iter->cursor = entries;
+    iter->remaining = count;
+    *more = resp_buf[1] != 0;
+    return true;
+}
+
+// Implementation for i2c_proto_unpack_identity
+bool i2c_proto_unpack_identity(const uint8_t *resp_buf, size_t resp_len, ModuleIdentity_t *identity)
+{
+    if (!resp_buf || !identity || resp_len < sizeof(ModuleIdentity_t))
+    {
+        return false; // Error: Invalid args or response too short
+    }
+
+    identity->module_type = resp_buf[offsetof(ModuleIdentity_t, module_type)];
+    identity->version_major = resp_buf[offsetof(ModuleIdentity_t, version_major)];
+    identity->version_minor = resp_buf[offsetof(ModuleIdentity_t, version_minor)];
+    identity->status = resp_buf[offsetof(ModuleIdentity_t, status)];
+    identity->param_count = i2c_proto_rd_le16(resp_buf + offsetof(ModuleIdentity_t, param_count));
+    identity->capabilities = i2c_proto_rd_le32(resp_buf + offsetof(ModuleIdentity_t, capabilities));
+    return true;
+}
+
+// Implementation for i2c_proto_unpack_diag
+bool i2c_proto_unpack_diag(const uint8_t *resp_buf, size_t resp_len, DiagStats_t *stats)
+{
+    if (!resp_buf || !stats || resp_len < sizeof(DiagStats_t))
+    {
+        return false; // Error: Invalid args or response too short
+    }
+
+    stats->messages = i2c_proto_rd_le32(resp_buf + offsetof(DiagStats_t, messages));
+    stats->bytes = i2c_proto_rd_le32(resp_buf + offsetof(DiagStats_t, bytes));
+    stats->errors = i2c_proto_rd_le32(resp_buf + offsetof(DiagStats_t, errors));
+    stats->decode_errors = i2c_proto_rd_le32(resp_buf + offsetof(DiagStats_t, decode_errors));
+    stats->cycles_max = i2c_proto_rd_le32(resp_buf + offsetof(DiagStats_t, cycles_max));
+    stats->cycles_total = i2c_proto_rd_le32(resp_buf + offsetof(DiagStats_t, cycles_total));
+    for (size_t b = 0; b < I2C_PROTO_DIAG_BUCKETS; b++)
+    {
+        stats->histogram[b] = i2c_proto_rd_le32(resp_buf + offsetof(DiagStats_t, histogram) + 4 * b);
+    }
+    return true;
+}
+
+// Implementation for i2c_proto_pack_set_param_batch
+size_t i2c_proto_pack_set_param_batch(uint8_t *buf, size_t buf_len, const SetParamPayload_t *params, size_t count)
+{
+    if (!buf || !params || count == 0 || count > I2C_PROTO_BATCH_MAX_PARAMS)
+    {
+        return 0; // Error: Invalid args or too many entries for one frame
+    }
+    const size_t required_len = 2 + count * I2C_PROTO_BATCH_ENTRY_LEN; // Command + Count + Entries
+    if (buf_len < required_len)
+    {
+        return 0; // Error: Buffer too small
+    }
+
+    buf[0] = REG_COMMON_SET_PARAM_BATCH; // The command byte
+    buf[1] = (uint8_t)count;
+
+    uint8_t *entry = buf + 2;
+    for (size_t i = 0; i < count; i++)
+    {
+        i2c_proto_wr_le16(entry + offsetof(SetParamPayload_t, param_id), params[i].param_id);
+        i2c_proto_wr_le32(entry + offsetof(SetParamPayload_t, param_value), params[i].param_value.u32);
+        entry += I2C_PROTO_BATCH_ENTRY_LEN;
+    }
+
+    return required_len;
+}
+
+// Implementation for i2c_proto_msg_len
+size_t i2c_proto_msg_len(const uint8_t *buf, size_t buf_len)
+{
+    if (!buf || buf_len < 1)
+    {
+        return 0; // Error: Nothing to parse
+    }
+
+    size_t msg_len;
+    switch (buf[0])
+    {
+    case REG_COMMON_MODULE_TYPE:
+    case REG_COMMON_FIRMWARE_VERSION:
+    case REG_COMMON_STATUS:
+    case REG_COMMON_DIRTY_BITMAP:
+    case REG_COMMON_IDENTITY:
+    case CMD_COMMON_RESET:
+    case CMD_COMMON_SAVE_SETTINGS:
+    case CMD_COMMON_LOAD_SETTINGS:
+        msg_len = 1; // Command only
+        break;
+    case REG_COMMON_I2S_CONFIG:
+        msg_len = 1 + sizeof(I2sConfig_t);
+        break;
+    case REG_COMMON_SET_PARAM:
+        msg_len = 1 + sizeof(SetParamPayload_t);
+        break;
+    case REG_COMMON_SET_PARAM_TIMED:
+        msg_len = 1 + sizeof(TimedSetParamPayload_t);
+        break;
+    case REG_COMMON_SET_PARAM_RAMP:
+        msg_len = 1 + sizeof(RampParamPayload_t);
+        break;
+    case REG_COMMON_GROUP_CONFIG:
+        msg_len = 2; // Command + group mask
+        break;
+    case REG_COMMON_GROUP_WRITE:
+    {
+        if (buf_len <= I2C_PROTO_GROUP_HEADER_LEN || !i2c_proto_group_write_allowed(buf[I2C_PROTO_GROUP_HEADER_LEN]))
+        {
+            return 0; // Error: Inner message missing or not allowed in a group write
+        }
+        const size_t inner_len = i2c_proto_msg_len(buf + I2C_PROTO_GROUP_HEADER_LEN, buf_len - I2C_PROTO_GROUP_HEADER_LEN);
+        if (inner_len == 0)
+        {
+            return 0; // Error: Malformed inner message
+        }
+        msg_len = I2C_PROTO_GROUP_HEADER_LEN + inner_len;
+        break;
+    }
+    case REG_COMMON_PRESET_DELTA:
+    {
+        if (buf_len < I2C_PROTO_PRESET_HEADER_LEN || buf[2] > I2C_PROTO_BATCH_MAX_PARAMS)
+        {
+            return 0; // Error: Header missing or invalid count
+        }
+        const size_t entries_len = compact_entries_len(buf + I2C_PROTO_PRESET_HEADER_LEN, buf_len - I2C_PROTO_PRESET_HEADER_LEN, buf[2]);
+        if (buf[2] > 0 && entries_len == 0)
+        {
+            return 0; // Error: Malformed or truncated entries
+        }
+        msg_len = I2C_PROTO_PRESET_HEADER_LEN + entries_len;
+        break;
+    }
+    case REG_COMMON_CRC_FRAME:
+        if (buf_len < I2C_PROTO_CRC_HEADER_LEN || buf[1] == 0)
+        {
+            return 0; // Error: Header missing or empty frame
+        }
+        msg_len = I2C_PROTO_CRC_HEADER_LEN + (size_t)buf[1]; // Contents are checked after the CRC
+        break;
+    case REG_COMMON_GET_PARAM:
+        msg_len = 1 + sizeof(ParamId_t); // Command + ID of the parameter to read back
+        break;
+    case REG_COMMON_GET_PARAM_RANGE:
+        msg_len = 1 + sizeof(GetParamRangePayload_t);
+        break;
+    case REG_COMMON_DIAG:
+        msg_len = 1 + sizeof(DiagRequestPayload_t);
+        break;
+    case REG_COMMON_I2S_STAGE:
+        msg_len = 1 + sizeof(I2sConfig_t);
+        break;
+    case REG_COMMON_I2S_COMMIT:
+        msg_len = 1 + sizeof(I2sCommitPayload_t);
+        break;
+    case REG_COMMON_SET_PARAM_BATCH:
+        if (buf_len < 2)
+        {
+            return 0; // Error: Count byte missing
+        }
+        msg_len = 2 + (size_t)buf[1] * I2C_PROTO_BATCH_ENTRY_LEN;
+        break;
+    case REG_COMMON_SET_PARAM_COMPACT:
+        msg_len = compact_payload_len(buf + 1, buf_len - 1);
+        if (msg_len == 0)
+        {
+            return 0; // Error: Malformed or truncated entries
+        }
+        msg_len += 1; // Command byte
+        break;
+    default:
+        return 0; // Error: Unknown command
+    }
+
+    return msg_len <= buf_len ? msg_len : 0;
+}
+
+// Implementation for i2c_proto_frame_builder_begin
+bool i2c_proto_frame_builder_begin(i2c_proto_frame_builder_t *builder, uint8_t *buf, size_t buf_len)
+{
+    if (!builder)
+    {
+        return false; // Error: Null builder
+    }
+
+    builder->len = 0;
+    builder->batch_count = NULL;
+    if (!buf || buf_len == 0)
+    {
+        // Leave the builder with no space so later appends fail cleanly
+        builder->buf = NULL;
+        builder->cap = 0;
+        return false; // Error: Null buffer or nothing to write into
+    }
+
+    builder->buf = buf;
+    builder->cap = buf_len;
+    return true;
+}
+
+// Implementation for i2c_proto_frame_builder_append_i2s_config
+bool i2c_proto_frame_builder_append_i2s_config(i2c_proto_frame_builder_t *builder, const I2sConfig_t *config)
+{
+    const size_t required_len = 1 + sizeof(I2sConfig_t); // Command + Payload
+    if (builder->cap - builder->len < required_len)
+    {
+        return false; // Error: Frame buffer full
+    }
+
+    uint8_t *msg = builder->buf + builder->len;
+    msg[0] = REG_COMMON_I2S_CONFIG; // The command byte
+    msg[1 + offsetof(I2sConfig_t, tdm_slot_in)] = config->tdm_slot_in;
+    msg[1 + offsetof(I2sConfig_t, tdm_slot_out)] = config->tdm_slot_out;
+    builder->len += required_len;
+    builder->batch_count = NULL; // Next parameter starts a new batch
+
     return true;
 }
 
-// Add implementations for other pack/unpack helpers if defined
\ No newline at end of file
+// Implementation for i2c_proto_frame_builder_finish
+size_t i2c_proto_frame_builder_finish(i2c_proto_frame_builder_t *builder)
+{
+    builder->batch_count = NULL;
+    return builder->len;
+}
+
+// Implementation for i2c_proto_pack_set_param_compact
+size_t i2c_proto_pack_set_param_compact(uint8_t *buf, size_t buf_len, const SetParamPayload_t *params, size_t count)
+{
+    if (!buf || !params || count == 0 || count > I2C_PROTO_BATCH_MAX_PARAMS || buf_len < 2)
+    {
+        return 0; // Error: Invalid args or too many entries for one frame
+    }
+
+    buf[0] = REG_COMMON_SET_PARAM_COMPACT; // The command byte
+    buf[1] = (uint8_t)count;
+
+    size_t offset = 2;
+    for (size_t i = 0; i < count; i++)
+    {
+        const ParamId_t param_id = params[i].param_id;
+        const size_t width = i2c_proto_param_width(i2c_proto_param_type(param_id));
+        if (width == 0 || buf_len - offset < sizeof(ParamId_t) + width)
+        {
+            return 0; // Error: Unknown ID or buffer too small
+        }
+
+        // Little-endian ID followed by the low `width` bytes of the value
+        const uint32_t value = params[i].param_value.u32;
+        buf[offset++] = (uint8_t)param_id;
+        buf[offset++] = (uint8_t)(param_id >> 8);
+        for (size_t b = 0; b < width; b++)
+        {
+            buf[offset++] = (uint8_t)(value >> (8 * b));
+        }
+    }
+
+    return offset;
+}
+
+// Implementation for i2c_proto_compact_iter_init
+bool i2c_proto_compact_iter_init(i2c_proto_batch_iter_t *iter, const uint8_t *payload_buf, size_t payload_len)
+{
+    if (!iter || !payload_buf || compact_payload_len(payload_buf, payload_len) != payload_len)
+    {
+        return false; // Error: Invalid args or malformed entries
+    }
+
+    iter->cursor = payload_buf + 1;
+    iter->remaining = payload_buf[0];
+    return true;
+}
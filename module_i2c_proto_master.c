@@ -0,0 +1,540 @@
+#include "module_i2c_proto_master.h"
+#include <string.h> // For memset
+
+#define BITMAP_WORD(index) ((index) / 32)
+#define BITMAP_BIT(index)  (1UL << ((index) % 32))
+
+static i2c_proto_coalesce_entry_t *coalescer_find(i2c_proto_coalescer_t *coalescer, uint16_t module_key)
+{
+    for (size_t i = 0; i < I2C_PROTO_COALESCE_MAX_MODULES; i++)
+    {
+        i2c_proto_coalesce_entry_t *entry = &coalescer->modules[i];
+        if (entry->in_use && entry->module_key == module_key)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static bool entry_has_dirty(const i2c_proto_coalesce_entry_t *entry)
+{
+    for (size_t w = 0; w < I2C_PROTO_PARAM_BITMAP_WORDS; w++)
+    {
+        if (entry->dirty[w])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Slot of a module, claiming a free one (batch encoding, nothing pending) on first use
+static i2c_proto_coalesce_entry_t *coalescer_claim(i2c_proto_coalescer_t *coalescer, uint16_t module_key)
+{
+    i2c_proto_coalesce_entry_t *entry = coalescer_find(coalescer, module_key);
+    for (size_t i = 0; i < I2C_PROTO_COALESCE_MAX_MODULES && !entry; i++)
+    {
+        if (!coalescer->modules[i].in_use)
+        {
+            entry = &coalescer->modules[i];
+            memset(entry, 0, sizeof(*entry));
+            entry->in_use = true;
+            entry->module_key = module_key;
+            entry->encoding = I2C_PROTO_ENCODING_BATCH;
+        }
+    }
+    return entry;
+}
+
+// Low desc->width bytes of a value, the part that goes on the wire
+static uint32_t wire_bits(const ParamDescriptor_t *desc, ParamValue_t value)
+{
+    return desc->width >= sizeof(uint32_t) ? value.u32 : value.u32 & ((1UL << (8 * desc->width)) - 1);
+}
+
+// Implementation for i2c_proto_caps_from_version
+uint32_t i2c_proto_caps_from_version(uint8_t version_major, uint8_t version_minor)
+{
+    if (version_major != I2C_PROTO_VERSION_MAJOR)
+    {
+        return 0; // Other wire format (1.x copied unpacked structs): no optional features
+    }
+
+    uint32_t caps = I2C_PROTO_CAP_BATCH | I2C_PROTO_CAP_COMPACT | I2C_PROTO_CAP_TIMED | I2C_PROTO_CAP_RANGE_READ |
+                    I2C_PROTO_CAP_DIRTY_BITMAP;
+    if (version_minor >= 1)
+    {
+        caps |= I2C_PROTO_CAP_RAMP;
+    }
+    if (version_minor >= 2)
+    {
+        caps |= I2C_PROTO_CAP_GROUP;
+    }
+    if (version_minor >= 3)
+    {
+        caps |= I2C_PROTO_CAP_CRC;
+    }
+    if (version_minor >= 4)
+    {
+        caps |= I2C_PROTO_CAP_PRESET_DELTA;
+    }
+    return caps;
+}
+
+// Implementation for i2c_proto_negotiate_encoding
+i2c_proto_encoding_t i2c_proto_negotiate_encoding(uint32_t capabilities)
+{
+    if (capabilities & I2C_PROTO_CAP_COMPACT)
+    {
+        return I2C_PROTO_ENCODING_COMPACT;
+    }
+    if (capabilities & I2C_PROTO_CAP_BATCH)
+    {
+        return I2C_PROTO_ENCODING_BATCH;
+    }
+    return I2C_PROTO_ENCODING_SINGLE;
+}
+
+// Implementation for i2c_proto_coalescer_init
+void i2c_proto_coalescer_init(i2c_proto_coalescer_t *coalescer)
+{
+    memset(coalescer, 0, sizeof(*coalescer));
+}
+
+// Implementation for i2c_proto_coalescer_set
+esp_err_t i2c_proto_coalescer_set(i2c_proto_coalescer_t *coalescer, uint16_t module_key, ParamId_t param_id, ParamValue_t param_value)
+{
+    const ParamDescriptor_t *desc = i2c_proto_param_find(param_id);
+    if (!desc)
+    {
+        return ESP_ERR_NOT_FOUND; // Error: Unknown parameter
+    }
+
+    i2c_proto_coalesce_entry_t *entry = coalescer_claim(coalescer, module_key);
+    if (!entry)
+    {
+        return ESP_ERR_NO_MEM; // Error: Too many modules
+    }
+
+    const size_t index = (size_t)(desc - i2c_proto_param_descriptors);
+    entry->values[index] = param_value; // Last write wins
+    entry->dirty[BITMAP_WORD(index)] |= BITMAP_BIT(index);
+    return ESP_OK;
+}
+
+// Implementation for i2c_proto_coalescer_set_encoding
+esp_err_t i2c_proto_coalescer_set_encoding(i2c_proto_coalescer_t *coalescer, uint16_t module_key, i2c_proto_encoding_t encoding)
+{
+    if (!coalescer || (unsigned)encoding > I2C_PROTO_ENCODING_COMPACT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_proto_coalesce_entry_t *entry = coalescer_claim(coalescer, module_key);
+    if (!entry)
+    {
+        return ESP_ERR_NO_MEM; // Error: Too many modules
+    }
+    entry->encoding = (uint8_t)encoding;
+    return ESP_OK;
+}
+
+// Implementation for i2c_proto_coalescer_next_pending
+bool i2c_proto_coalescer_next_pending(const i2c_proto_coalescer_t *coalescer, uint16_t *module_key)
+{
+    for (size_t i = 0; i < I2C_PROTO_COALESCE_MAX_MODULES; i++)
+    {
+        const i2c_proto_coalesce_entry_t *entry = &coalescer->modules[i];
+        if (entry->in_use && entry_has_dirty(entry))
+        {
+            *module_key = entry->module_key;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Pack dirty parameters as REG_COMMON_SET_PARAM_COMPACT messages, opening a
+// new message whenever one reaches I2C_PROTO_BATCH_MAX_PARAMS entries
+static size_t flush_compact(i2c_proto_coalesce_entry_t *entry, uint8_t *buf, size_t buf_len)
+{
+    size_t offset = 0;
+    size_t header = 0; // Count byte of the open message, 0 if none
+    for (size_t w = 0; w < I2C_PROTO_PARAM_BITMAP_WORDS; w++)
+    {
+        uint32_t bits = entry->dirty[w];
+        while (bits)
+        {
+            const size_t index = w * 32 + (size_t)__builtin_ctz(bits);
+            bits &= bits - 1;
+            const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[index];
+            if (header && buf[header] == I2C_PROTO_BATCH_MAX_PARAMS)
+            {
+                header = 0; // Message full
+            }
+            const size_t needed = (header ? 0 : 2) + sizeof(ParamId_t) + desc->width;
+            if (buf_len - offset < needed)
+            {
+                return offset; // Frame full, the rest stays dirty
+            }
+            if (!header)
+            {
+                buf[offset] = REG_COMMON_SET_PARAM_COMPACT; // The command byte
+                buf[offset + 1] = 0;
+                header = offset + 1;
+                offset += 2;
+            }
+
+            const uint32_t value = wire_bits(desc, entry->values[index]);
+            i2c_proto_wr_le16(buf + offset, desc->id);
+            offset += sizeof(ParamId_t);
+            for (size_t b = 0; b < desc->width; b++)
+            {
+                buf[offset++] = (uint8_t)(value >> (8 * b));
+            }
+            buf[header]++;
+            entry->dirty[w] &= ~BITMAP_BIT(index);
+        }
+    }
+    return offset;
+}
+
+// Implementation for i2c_proto_coalescer_flush
+size_t i2c_proto_coalescer_flush(i2c_proto_coalescer_t *coalescer, uint16_t module_key, uint8_t *buf, size_t buf_len)
+{
+    i2c_proto_coalesce_entry_t *entry = coalescer_find(coalescer, module_key);
+    if (!entry || !buf)
+    {
+        return 0; // Nothing pending for this module
+    }
+
+    size_t dirty_count = 0;
+    size_t last_index = 0;
+    for (size_t w = 0; w < I2C_PROTO_PARAM_BITMAP_WORDS; w++)
+    {
+        if (entry->dirty[w])
+        {
+            dirty_count += (size_t)__builtin_popcount(entry->dirty[w]);
+            last_index = w * 32 + (31 - (size_t)__builtin_clz(entry->dirty[w]));
+        }
+    }
+
+    if (dirty_count > 0 && entry->encoding == I2C_PROTO_ENCODING_COMPACT)
+    {
+        return flush_compact(entry, buf, buf_len);
+    }
+    if (dirty_count > 0 && entry->encoding == I2C_PROTO_ENCODING_SINGLE)
+    {
+        // Lowest dirty parameter only; the next flush sends the next one
+        size_t index = 0;
+        while (!entry->dirty[BITMAP_WORD(index)])
+        {
+            index += 32;
+        }
+        index += (size_t)__builtin_ctz(entry->dirty[BITMAP_WORD(index)]);
+        last_index = index;
+        dirty_count = 1;
+    }
+
+    if (dirty_count == 1)
+    {
+        // One update is cheaper as a plain SET_PARAM
+        const size_t len = i2c_proto_pack_set_param_msg(buf, buf_len, i2c_proto_param_descriptors[last_index].id,
+                                                        entry->values[last_index]);
+        if (len)
+        {
+            entry->dirty[BITMAP_WORD(last_index)] &= ~BITMAP_BIT(last_index);
+        }
+        return len;
+    }
+
+    i2c_proto_frame_builder_t builder;
+    if (dirty_count == 0 || !i2c_proto_frame_builder_begin(&builder, buf, buf_len))
+    {
+        return 0;
+    }
+
+    for (size_t w = 0; w < I2C_PROTO_PARAM_BITMAP_WORDS; w++)
+    {
+        uint32_t bits = entry->dirty[w];
+        while (bits)
+        {
+            const size_t index = w * 32 + (size_t)__builtin_ctz(bits);
+            bits &= bits - 1;
+            if (!i2c_proto_frame_builder_append_param(&builder, i2c_proto_param_descriptors[index].id, entry->values[index]))
+            {
+                return i2c_proto_frame_builder_finish(&builder); // Frame full, the rest stays dirty
+            }
+            entry->dirty[w] &= ~BITMAP_BIT(index);
+        }
+    }
+
+    return i2c_proto_frame_builder_finish(&builder);
+}
+
+// Implementation for i2c_proto_param_snapshot_clear
+void i2c_proto_param_snapshot_clear(i2c_proto_param_snapshot_t *snapshot)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+}
+
+// Implementation for i2c_proto_param_snapshot_unpack
+esp_err_t i2c_proto_param_snapshot_unpack(i2c_proto_param_snapshot_t *snapshot, const uint8_t *resp_buf, size_t resp_len,
+                                          ParamId_t *next_first, bool *more)
+{
+    if (!snapshot || !resp_buf || !next_first || !more)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    i2c_proto_batch_iter_t iter;
+    if (!i2c_proto_range_resp_iter_init(&iter, resp_buf, resp_len, more))
+    {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    ParamId_t param_id;
+    ParamValue_t value;
+    while (i2c_proto_compact_iter_next(&iter, &param_id, &value))
+    {
+        // Entries were validated against the parameter table by the iterator
+        const size_t index = (size_t)(i2c_proto_param_find(param_id) - i2c_proto_param_descriptors);
+        snapshot->values[index] = value;
+        snapshot->present[BITMAP_WORD(index)] |= BITMAP_BIT(index);
+        *next_first = (ParamId_t)(param_id + 1);
+    }
+
+    return ESP_OK;
+}
+
+// Implementation for i2c_proto_param_snapshot_get
+bool i2c_proto_param_snapshot_get(const i2c_proto_param_snapshot_t *snapshot, ParamId_t param_id, ParamValue_t *param_value)
+{
+    const ParamDescriptor_t *desc = i2c_proto_param_find(param_id);
+    if (!desc)
+    {
+        return false;
+    }
+
+    const size_t index = (size_t)(desc - i2c_proto_param_descriptors);
+    if (!(snapshot->present[BITMAP_WORD(index)] & BITMAP_BIT(index)))
+    {
+        return false; // Not read yet
+    }
+    *param_value = snapshot->values[index];
+    return true;
+}
+
+// Implementation for i2c_proto_param_snapshot_set
+esp_err_t i2c_proto_param_snapshot_set(i2c_proto_param_snapshot_t *snapshot, ParamId_t param_id, ParamValue_t param_value)
+{
+    if (!snapshot)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const ParamDescriptor_t *desc = i2c_proto_param_find(param_id);
+    if (!desc)
+    {
+        return ESP_ERR_NOT_FOUND; // Error: Unknown parameter
+    }
+
+    const size_t index = (size_t)(desc - i2c_proto_param_descriptors);
+    snapshot->values[index] = param_value;
+    snapshot->present[BITMAP_WORD(index)] |= BITMAP_BIT(index);
+    return ESP_OK;
+}
+
+static void snapshot_merge_entries(i2c_proto_param_snapshot_t *snapshot, i2c_proto_batch_iter_t *iter, bool compact)
+{
+    ParamId_t param_id;
+    ParamValue_t value;
+    while (compact ? i2c_proto_compact_iter_next(iter, &param_id, &value) : i2c_proto_batch_iter_next(iter, &param_id, &value))
+    {
+        i2c_proto_param_snapshot_set(snapshot, param_id, value); // Unknown IDs in a batch are skipped
+    }
+}
+
+// Implementation for i2c_proto_param_snapshot_apply_frame
+esp_err_t i2c_proto_param_snapshot_apply_frame(i2c_proto_param_snapshot_t *snapshot, const uint8_t *frame, size_t frame_len)
+{
+    if (!snapshot || !frame)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t offset = 0;
+    while (offset < frame_len)
+    {
+        const uint8_t *msg = frame + offset;
+        const size_t msg_len = i2c_proto_msg_len(msg, frame_len - offset);
+        if (msg_len == 0)
+        {
+            return ESP_ERR_INVALID_SIZE; // Error: Unknown command or truncated message
+        }
+        offset += msg_len;
+
+        const uint8_t *payload = msg + 1;
+        const size_t payload_len = msg_len - 1;
+        i2c_proto_batch_iter_t iter;
+        switch (msg[0])
+        {
+        case REG_COMMON_SET_PARAM:
+        {
+            i2c_proto_set_param_view_t view;
+            if (i2c_proto_view_set_param(payload, payload_len, &view))
+            {
+                const ParamValue_t value = {.u32 = i2c_proto_rd_le32(i2c_proto_set_param_view_value(view))};
+                i2c_proto_param_snapshot_set(snapshot, i2c_proto_set_param_view_id(view), value);
+            }
+            break;
+        }
+        case REG_COMMON_SET_PARAM_TIMED:
+        {
+            i2c_proto_set_param_timed_view_t view;
+            if (i2c_proto_view_set_param_timed(payload, payload_len, &view))
+            {
+                const ParamValue_t value = {.u32 = i2c_proto_rd_le32(i2c_proto_set_param_timed_view_value(view))};
+                i2c_proto_param_snapshot_set(snapshot, i2c_proto_set_param_timed_view_id(view), value);
+            }
+            break;
+        }
+        case REG_COMMON_SET_PARAM_RAMP:
+        {
+            i2c_proto_set_param_ramp_view_t view;
+            if (i2c_proto_view_set_param_ramp(payload, payload_len, &view))
+            {
+                const ParamValue_t value = {.u32 = i2c_proto_rd_le32(i2c_proto_set_param_ramp_view_target(view))};
+                i2c_proto_param_snapshot_set(snapshot, i2c_proto_set_param_ramp_view_id(view), value);
+            }
+            break;
+        }
+        case REG_COMMON_SET_PARAM_BATCH:
+            if (i2c_proto_batch_iter_init(&iter, payload, payload_len))
+            {
+                snapshot_merge_entries(snapshot, &iter, false);
+            }
+            break;
+        case REG_COMMON_SET_PARAM_COMPACT:
+            if (i2c_proto_compact_iter_init(&iter, payload, payload_len))
+            {
+                snapshot_merge_entries(snapshot, &iter, true);
+            }
+            break;
+        case REG_COMMON_PRESET_DELTA:
+            if (payload[1] > 0 && i2c_proto_compact_iter_init(&iter, payload + 1, payload_len - 1))
+            {
+                snapshot_merge_entries(snapshot, &iter, true); // Skip the flags byte
+            }
+            break;
+        case REG_COMMON_GROUP_WRITE:
+            i2c_proto_param_snapshot_apply_frame(snapshot, msg + I2C_PROTO_GROUP_HEADER_LEN, msg_len - I2C_PROTO_GROUP_HEADER_LEN);
+            break;
+        case REG_COMMON_CRC_FRAME:
+            i2c_proto_param_snapshot_apply_frame(snapshot, msg + I2C_PROTO_CRC_HEADER_LEN, msg_len - I2C_PROTO_CRC_HEADER_LEN);
+            break;
+        default:
+            break; // Not a parameter write
+        }
+    }
+
+    return ESP_OK;
+}
+
+// Implementation for i2c_proto_preset_delta_begin
+void i2c_proto_preset_delta_begin(i2c_proto_preset_delta_t *load)
+{
+    memset(load, 0, sizeof(*load));
+}
+
+// Implementation for i2c_proto_pack_preset_delta
+size_t i2c_proto_pack_preset_delta(i2c_proto_preset_delta_t *load, const i2c_proto_param_snapshot_t *shadow,
+                                   const i2c_proto_param_snapshot_t *preset, uint8_t *buf, size_t buf_len)
+{
+    if (!load || !shadow || !preset || !buf || load->done ||
+        buf_len < I2C_PROTO_PRESET_HEADER_LEN + I2C_PROTO_COMPACT_MAX_ENTRY_LEN)
+    {
+        return 0; // Load complete or invalid args
+    }
+
+    size_t offset = I2C_PROTO_PRESET_HEADER_LEN;
+    uint8_t count = 0;
+    size_t index = load->next_index;
+    for (; index < I2C_PROTO_PARAM_COUNT; index++)
+    {
+        if (!(preset->present[BITMAP_WORD(index)] & BITMAP_BIT(index)))
+        {
+            continue; // Not part of the preset
+        }
+
+        const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[index];
+        const uint32_t value = wire_bits(desc, preset->values[index]);
+        if ((shadow->present[BITMAP_WORD(index)] & BITMAP_BIT(index)) && wire_bits(desc, shadow->values[index]) == value)
+        {
+            continue; // Module already has it
+        }
+
+        if (count == I2C_PROTO_BATCH_MAX_PARAMS || buf_len - offset < sizeof(ParamId_t) + desc->width)
+        {
+            break; // Chunk full, resume here next time
+        }
+        i2c_proto_wr_le16(buf + offset, desc->id);
+        offset += sizeof(ParamId_t);
+        for (size_t b = 0; b < desc->width; b++)
+        {
+            buf[offset++] = (uint8_t)(value >> (8 * b));
+        }
+        count++;
+    }
+
+    buf[0] = REG_COMMON_PRESET_DELTA; // The command byte
+    buf[1] = load->started ? 0 : I2C_PROTO_PRESET_FIRST;
+    buf[2] = count;
+    if (index == I2C_PROTO_PARAM_COUNT)
+    {
+        buf[1] |= I2C_PROTO_PRESET_LAST;
+        load->done = true;
+    }
+    load->started = true;
+    load->next_index = index;
+    return offset;
+}
+
+// Implementation for i2c_proto_dirty_bitmap_to_ids
+size_t i2c_proto_dirty_bitmap_to_ids(const uint8_t *bitmap, size_t bitmap_len, ParamId_t *param_ids, size_t max_ids)
+{
+    if (!bitmap || !param_ids)
+    {
+        return 0;
+    }
+
+    size_t count = 0;
+    for (size_t index = 0; index < I2C_PROTO_PARAM_COUNT && index / 8 < bitmap_len && count < max_ids; index++)
+    {
+        if (bitmap[index / 8] & (1U << (index % 8)))
+        {
+            param_ids[count++] = i2c_proto_param_descriptors[index].id;
+        }
+    }
+    return count;
+}
+
+// Implementation for i2c_proto_group_mux_mask
+uint8_t i2c_proto_group_mux_mask(const uint16_t *module_keys, size_t count)
+{
+    if (!module_keys)
+    {
+        return 0;
+    }
+
+    uint8_t mask = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint8_t channel = I2C_PROTO_MODULE_KEY_CHANNEL(module_keys[i]);
+        if (channel < 8)
+        {
+            mask |= (uint8_t)(1U << channel);
+        }
+    }
+    return mask;
+}
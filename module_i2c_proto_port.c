@@ -0,0 +1,167 @@
+#include "module_i2c_proto_port.h"
+#include <stdio.h> // For snprintf
+#include "driver/gpio.h"
+#include "esp_cpu.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+
+#define PORT_NVS_NAMESPACE    "i2c_proto" // nvs_flash_init() is up to the application
+#define PORT_WORKER_STACK     3072
+#define PORT_WORKER_PRIORITY  (tskIDLE_PRIORITY + 1)
+#define PORT_DISPATCH_STACK   4096
+#define PORT_DISPATCH_PRIORITY (configMAX_PRIORITIES - 2) // Below the I2C driver's own tasks, above application work
+
+static nvs_handle_t s_nvs;
+static bool s_nvs_open;
+static TaskHandle_t s_worker;
+static void (*s_worker_job)(void);
+static TaskHandle_t s_dispatch;
+static void (*s_dispatch_job)(void);
+
+esp_err_t i2c_proto_port_attention_init(int gpio)
+{
+    const gpio_config_t io_conf = {
+        .pin_bit_mask = 1ULL << gpio,
+        .mode = GPIO_MODE_OUTPUT_OD,
+        .pull_up_en = GPIO_PULLUP_DISABLE, // Shared line, pulled up on the Central Controller
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    esp_err_t err = gpio_config(&io_conf);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    return gpio_set_level((gpio_num_t)gpio, 1); // Released
+}
+
+void i2c_proto_port_attention_set(int gpio, bool asserted)
+{
+    gpio_set_level((gpio_num_t)gpio, asserted ? 0 : 1); // Active low
+}
+
+static esp_err_t nvs_ensure_open(void)
+{
+    if (s_nvs_open)
+    {
+        return ESP_OK;
+    }
+    esp_err_t err = nvs_open(PORT_NVS_NAMESPACE, NVS_READWRITE, &s_nvs);
+    s_nvs_open = err == ESP_OK;
+    return err;
+}
+
+static void nvs_key(uint16_t param_id, char key[NVS_KEY_NAME_MAX_SIZE])
+{
+    snprintf(key, NVS_KEY_NAME_MAX_SIZE, "p%04x", param_id);
+}
+
+esp_err_t i2c_proto_port_nvs_write(uint16_t param_id, const void *value, size_t len)
+{
+    esp_err_t err = nvs_ensure_open();
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_key(param_id, key);
+    return nvs_set_blob(s_nvs, key, value, len);
+}
+
+esp_err_t i2c_proto_port_nvs_read(uint16_t param_id, void *value, size_t len)
+{
+    esp_err_t err = nvs_ensure_open();
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_key(param_id, key);
+    size_t stored_len = len;
+    err = nvs_get_blob(s_nvs, key, value, &stored_len);
+    if (err == ESP_ERR_NVS_NOT_FOUND || (err == ESP_OK && stored_len != len) || err == ESP_ERR_NVS_INVALID_LENGTH)
+    {
+        return ESP_ERR_NOT_FOUND; // Never saved, or saved with another width
+    }
+    return err;
+}
+
+esp_err_t i2c_proto_port_nvs_commit(void)
+{
+    esp_err_t err = nvs_ensure_open();
+    return err == ESP_OK ? nvs_commit(s_nvs) : err;
+}
+
+// Body of the worker and dispatch tasks; arg points at the job pointer
+static void job_task(void *arg)
+{
+    void (*const *job)(void) = arg;
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        (*job)();
+    }
+}
+
+static void task_notify(TaskHandle_t task)
+{
+    if (!task)
+    {
+        return;
+    }
+    if (xPortInIsrContext())
+    {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(task, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+    else
+    {
+        xTaskNotifyGive(task);
+    }
+}
+
+esp_err_t i2c_proto_port_worker_start(void (*job)(void))
+{
+    if (s_worker)
+    {
+        return ESP_OK;
+    }
+    s_worker_job = job;
+    return xTaskCreate(job_task, "i2c_proto_worker", PORT_WORKER_STACK, &s_worker_job, PORT_WORKER_PRIORITY, &s_worker) == pdPASS
+               ? ESP_OK
+               : ESP_ERR_NO_MEM;
+}
+
+void i2c_proto_port_worker_notify(void)
+{
+    task_notify(s_worker);
+}
+
+esp_err_t i2c_proto_port_dispatch_start(int core, void (*job)(void))
+{
+    if (s_dispatch)
+    {
+        return ESP_OK;
+    }
+    if (core < 0 || core >= portNUM_PROCESSORS)
+    {
+        return ESP_ERR_INVALID_ARG; // Error: No such core
+    }
+    s_dispatch_job = job;
+    return xTaskCreatePinnedToCore(job_task, "i2c_proto_dispatch", PORT_DISPATCH_STACK, &s_dispatch_job,
+                                   PORT_DISPATCH_PRIORITY, &s_dispatch, core) == pdPASS
+               ? ESP_OK
+               : ESP_ERR_NO_MEM;
+}
+
+void i2c_proto_port_dispatch_notify(void)
+{
+    task_notify(s_dispatch);
+}
+
+uint32_t i2c_proto_port_cycles(void)
+{
+    return (uint32_t)esp_cpu_get_cycle_count();
+}
@@ -0,0 +1,770 @@
+#include "module_i2c_proto_sched.h"
+#include <string.h> // For memcpy, memset
+
+#define SCHED_NONE UINT8_MAX // End of a frame list
+
+_Static_assert(I2C_PROTO_SCHED_FRAMES < SCHED_NONE, "Scheduler frames are indexed by uint8_t");
+
+enum {
+    ENUM_PROBING,     // Every channel open: which addresses acknowledge anywhere
+    ENUM_IDENTIFYING, // One channel open: read REG_COMMON_IDENTITY from each candidate
+    ENUM_DONE,
+};
+
+enum {
+    ENUM_OP_NONE,
+    ENUM_OP_SELECT,
+    ENUM_OP_PROBE,
+    ENUM_OP_IDENTIFY,
+    ENUM_OP_LEGACY_VERSION, // Fallback for modules without REG_COMMON_IDENTITY
+    ENUM_OP_LEGACY_TYPE,
+    ENUM_OP_LEGACY_STATUS,
+};
+
+enum {
+    SCHED_IDLE,      // Nothing on the bus
+    SCHED_SELECTING, // Mux channel switch in flight for the active frame
+    SCHED_TRANSFER,  // Active frame in flight
+};
+
+static i2c_proto_sched_target_t *target_find(i2c_proto_sched_t *sched, uint16_t module_key, bool create)
+{
+    i2c_proto_sched_target_t *free_slot = NULL;
+    for (size_t i = 0; i < I2C_PROTO_SCHED_MAX_TARGETS; i++)
+    {
+        i2c_proto_sched_target_t *target = &sched->targets[i];
+        if (target->in_use && target->module_key == module_key)
+        {
+            return target;
+        }
+        if (!target->in_use && !free_slot)
+        {
+            free_slot = target;
+        }
+    }
+    if (!create || !free_slot)
+    {
+        return NULL;
+    }
+
+    free_slot->in_use = true;
+    free_slot->module_key = module_key;
+    memset(free_slot->head, SCHED_NONE, sizeof(free_slot->head));
+    memset(free_slot->tail, SCHED_NONE, sizeof(free_slot->tail));
+    return free_slot;
+}
+
+static bool coalesced_pending(const i2c_proto_sched_t *sched, uint16_t module_key)
+{
+    for (size_t i = 0; i < I2C_PROTO_COALESCE_MAX_MODULES; i++)
+    {
+        const i2c_proto_coalesce_entry_t *entry = &sched->coalescer.modules[i];
+        if (entry->in_use && entry->module_key == module_key)
+        {
+            for (size_t w = 0; w < I2C_PROTO_PARAM_BITMAP_WORDS; w++)
+            {
+                if (entry->dirty[w])
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+    return false;
+}
+
+static bool target_ready(const i2c_proto_sched_t *sched, const i2c_proto_sched_target_t *target, uint8_t prio)
+{
+    if (!target->in_use)
+    {
+        return false;
+    }
+    // Coalesced updates need a free frame; with the pool full they wait, and
+    // the queued frames that go out instead free one
+    return target->head[prio] != SCHED_NONE ||
+           (prio == I2C_PROTO_SCHED_REALTIME && sched->free_count > 0 && coalesced_pending(sched, target->module_key));
+}
+
+static uint8_t frame_alloc(i2c_proto_sched_t *sched)
+{
+    const uint8_t index = sched->free;
+    if (index != SCHED_NONE)
+    {
+        sched->free = sched->frames[index].next;
+        sched->free_count--;
+        sched->frames[index].next = SCHED_NONE;
+    }
+    return index;
+}
+
+static void frame_release(i2c_proto_sched_t *sched, uint8_t index)
+{
+    sched->frames[index].next = sched->free;
+    sched->free = index;
+    sched->free_count++;
+}
+
+// Run the active frame's callback (or, for a bulk segment, hand its result
+// to the next segment) and return it to the pool
+static void frame_complete(i2c_proto_sched_t *sched, esp_err_t err, size_t resp_len)
+{
+    i2c_proto_sched_frame_t *frame = &sched->frames[sched->active];
+    const i2c_proto_sched_done_cb_t done = frame->more ? NULL : frame->done;
+    void *user_data = frame->user_data;
+    uint8_t *resp = frame->resp;
+    if (frame->err != ESP_OK)
+    {
+        err = frame->err; // Report the first failed segment
+    }
+    if (frame->more)
+    {
+        // Segments are queued back to back, so the next one heads the same queue
+        const i2c_proto_sched_target_t *target = target_find(sched, frame->module_key, false);
+        if (target && target->head[frame->prio] != SCHED_NONE)
+        {
+            sched->frames[target->head[frame->prio]].err = err;
+        }
+    }
+
+    frame_release(sched, sched->active);
+    sched->active = SCHED_NONE;
+    sched->state = SCHED_IDLE;
+    if (done)
+    {
+        done(user_data, err, resp, resp ? resp_len : 0);
+    }
+}
+
+// Length of the next bulk segment starting at buf: whole messages up to
+// I2C_PROTO_SCHED_BULK_SEGMENT bytes, or one longer message. 0 if malformed.
+static size_t segment_len(const uint8_t *buf, size_t len)
+{
+    size_t seg = 0;
+    while (seg < len)
+    {
+        const size_t msg_len = i2c_proto_msg_len(buf + seg, len - seg);
+        if (msg_len == 0)
+        {
+            return 0; // Error: Not a complete message
+        }
+        if (seg > 0 && seg + msg_len > I2C_PROTO_SCHED_BULK_SEGMENT)
+        {
+            break;
+        }
+        seg += msg_len;
+    }
+    return seg;
+}
+
+static void queue_frame(i2c_proto_sched_t *sched, i2c_proto_sched_target_t *target, uint8_t prio, const uint8_t *buf,
+                        size_t len, uint8_t *resp, size_t resp_cap, bool more, i2c_proto_sched_done_cb_t done, void *user_data)
+{
+    const uint8_t index = frame_alloc(sched); // Caller has checked free_count
+    i2c_proto_sched_frame_t *frame = &sched->frames[index];
+    memcpy(frame->data, buf, len);
+    frame->len = (uint16_t)len;
+    frame->module_key = target->module_key;
+    frame->prio = prio;
+    frame->more = more;
+    frame->err = ESP_OK;
+    frame->resp = resp;
+    frame->resp_cap = resp_cap;
+    frame->done = done;
+    frame->user_data = user_data;
+
+    if (target->tail[prio] == SCHED_NONE)
+    {
+        target->head[prio] = index;
+    }
+    else
+    {
+        sched->frames[target->tail[prio]].next = index;
+    }
+    target->tail[prio] = index;
+}
+
+// Take the next frame of a class for a target; realtime serves coalesced updates first
+static uint8_t target_take(i2c_proto_sched_t *sched, i2c_proto_sched_target_t *target, uint8_t prio)
+{
+    if (prio == I2C_PROTO_SCHED_REALTIME && coalesced_pending(sched, target->module_key))
+    {
+        const uint8_t index = frame_alloc(sched);
+        if (index != SCHED_NONE)
+        {
+            i2c_proto_sched_frame_t *frame = &sched->frames[index];
+            const size_t len = i2c_proto_coalescer_flush(&sched->coalescer, target->module_key, frame->data, sizeof(frame->data));
+            if (len)
+            {
+                frame->len = (uint16_t)len;
+                frame->module_key = target->module_key;
+                frame->prio = I2C_PROTO_SCHED_REALTIME;
+                frame->more = false;
+                frame->err = ESP_OK;
+                frame->resp = NULL;
+                frame->resp_cap = 0;
+                frame->done = NULL;
+                frame->user_data = NULL;
+                return index;
+            }
+            frame_release(sched, index);
+        }
+    }
+
+    const uint8_t index = target->head[prio];
+    if (index != SCHED_NONE)
+    {
+        target->head[prio] = sched->frames[index].next;
+        if (target->head[prio] == SCHED_NONE)
+        {
+            target->tail[prio] = SCHED_NONE;
+        }
+        sched->frames[index].next = SCHED_NONE;
+    }
+    return index;
+}
+
+// Next target to serve in the highest class with work: one on the open mux
+// channel (while its burst lasts, except for realtime traffic), otherwise
+// the next ready one in round-robin order
+static i2c_proto_sched_target_t *pick_target_in(i2c_proto_sched_t *sched, uint8_t prio)
+{
+    const bool burst_left = prio == I2C_PROTO_SCHED_REALTIME || sched->burst < I2C_PROTO_SCHED_MUX_BURST;
+    i2c_proto_sched_target_t *fallback = NULL;
+    for (size_t k = 0; k < I2C_PROTO_SCHED_MAX_TARGETS; k++)
+    {
+        const size_t i = (sched->next_target + k) % I2C_PROTO_SCHED_MAX_TARGETS;
+        i2c_proto_sched_target_t *target = &sched->targets[i];
+        if (!target_ready(sched, target, prio))
+        {
+            continue;
+        }
+        if (!sched->transport.select_channel ||
+            (I2C_PROTO_MODULE_KEY_CHANNEL(target->module_key) == sched->mux_channel && burst_left))
+        {
+            sched->next_target = (uint8_t)((i + 1) % I2C_PROTO_SCHED_MAX_TARGETS);
+            return target;
+        }
+        if (!fallback)
+        {
+            fallback = target;
+        }
+    }
+    if (fallback)
+    {
+        sched->next_target = (uint8_t)((fallback - sched->targets + 1) % I2C_PROTO_SCHED_MAX_TARGETS);
+    }
+    return fallback;
+}
+
+static i2c_proto_sched_target_t *pick_target(i2c_proto_sched_t *sched, uint8_t *prio)
+{
+    i2c_proto_sched_target_t *target = NULL;
+    for (uint8_t p = 0; p < I2C_PROTO_SCHED_PRIO_COUNT && !target; p++)
+    {
+        target = pick_target_in(sched, p);
+        *prio = p;
+    }
+    return target;
+}
+
+static void start_transfer(i2c_proto_sched_t *sched)
+{
+    const i2c_proto_sched_frame_t *frame = &sched->frames[sched->active];
+    const uint8_t address = I2C_PROTO_MODULE_KEY_ADDRESS(frame->module_key);
+    const i2c_proto_sched_transport_t *io = &sched->transport;
+
+    sched->state = SCHED_TRANSFER;
+    sched->burst++;
+    atomic_store_explicit(&sched->io_pending, true, memory_order_relaxed);
+    esp_err_t err = frame->resp ? io->write_read_async(io->ctx, address, frame->data, frame->len, frame->resp, frame->resp_cap)
+                                : io->write_async(io->ctx, address, frame->data, frame->len);
+    if (err != ESP_OK)
+    {
+        i2c_proto_sched_io_done(sched, err, 0); // Could not start: finishes on the next poll
+    }
+}
+
+// Implementation for i2c_proto_sched_init
+esp_err_t i2c_proto_sched_init(i2c_proto_sched_t *sched, const i2c_proto_sched_transport_t *transport)
+{
+    if (!sched || !transport || !transport->write_async)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(sched, 0, sizeof(*sched));
+    sched->transport = *transport;
+    for (size_t i = 0; i < I2C_PROTO_SCHED_FRAMES; i++)
+    {
+        sched->frames[i].next = (uint8_t)(i + 1 < I2C_PROTO_SCHED_FRAMES ? i + 1 : SCHED_NONE);
+    }
+    sched->free = 0;
+    sched->free_count = I2C_PROTO_SCHED_FRAMES;
+    i2c_proto_coalescer_init(&sched->coalescer);
+    sched->mux_channel = -1;
+    sched->state = SCHED_IDLE;
+    sched->active = SCHED_NONE;
+    atomic_init(&sched->io_pending, false);
+    return ESP_OK;
+}
+
+// Implementation for i2c_proto_sched_enqueue_prio
+esp_err_t i2c_proto_sched_enqueue_prio(i2c_proto_sched_t *sched, uint16_t module_key, i2c_proto_sched_prio_t prio,
+                                       const uint8_t *buf, size_t len, uint8_t *resp, size_t resp_cap,
+                                       i2c_proto_sched_done_cb_t done, void *user_data)
+{
+    if (!sched || !buf || len == 0 || len > I2C_PROTO_MAX_FRAME_LEN || (unsigned)prio >= I2C_PROTO_SCHED_PRIO_COUNT ||
+        I2C_PROTO_MODULE_KEY_CHANNEL(module_key) >= 8)
+    {
+        return ESP_ERR_INVALID_ARG; // Error: Invalid args, frame too long or no such mux channel
+    }
+    if (resp && (resp_cap == 0 || !sched->transport.write_read_async))
+    {
+        return ESP_ERR_INVALID_ARG; // Error: Empty response buffer or the transport cannot read
+    }
+
+    // Bulk writes go out in segments; count them before taking any frame
+    const bool segmented = prio == I2C_PROTO_SCHED_BULK && !resp && len > I2C_PROTO_SCHED_BULK_SEGMENT;
+    size_t segments = 1;
+    if (segmented)
+    {
+        segments = 0;
+        for (size_t offset = 0; offset < len; segments++)
+        {
+            const size_t seg = segment_len(buf + offset, len - offset);
+            if (seg == 0)
+            {
+                return ESP_ERR_INVALID_ARG; // Error: Cannot split at a message boundary
+            }
+            offset += seg;
+        }
+    }
+
+    i2c_proto_sched_target_t *target = target_find(sched, module_key, true);
+    if (!target)
+    {
+        return ESP_ERR_NO_MEM; // Error: Too many modules
+    }
+    if (sched->free_count < segments)
+    {
+        return ESP_ERR_NO_MEM; // Error: Frame pool exhausted
+    }
+
+    if (!segmented)
+    {
+        queue_frame(sched, target, prio, buf, len, resp, resp_cap, false, done, user_data);
+        return ESP_OK;
+    }
+    for (size_t offset = 0; offset < len;)
+    {
+        const size_t seg = segment_len(buf + offset, len - offset);
+        queue_frame(sched, target, prio, buf + offset, seg, NULL, 0, offset + seg < len, done, user_data);
+        offset += seg;
+    }
+    return ESP_OK;
+}
+
+// Implementation for i2c_proto_sched_enqueue
+esp_err_t i2c_proto_sched_enqueue(i2c_proto_sched_t *sched, uint16_t module_key, const uint8_t *buf, size_t len,
+                                  i2c_proto_sched_done_cb_t done, void *user_data)
+{
+    return i2c_proto_sched_enqueue_prio(sched, module_key, I2C_PROTO_SCHED_NORMAL, buf, len, NULL, 0, done, user_data);
+}
+
+// Implementation for i2c_proto_sched_enqueue_read
+esp_err_t i2c_proto_sched_enqueue_read(i2c_proto_sched_t *sched, uint16_t module_key, const uint8_t *buf, size_t len,
+                                       uint8_t *resp, size_t resp_cap, i2c_proto_sched_done_cb_t done, void *user_data)
+{
+    if (!resp)
+    {
+        return ESP_ERR_INVALID_ARG; // Error: No response buffer
+    }
+    return i2c_proto_sched_enqueue_prio(sched, module_key, I2C_PROTO_SCHED_NORMAL, buf, len, resp, resp_cap, done, user_data);
+}
+
+// Implementation for i2c_proto_sched_set_param
+esp_err_t i2c_proto_sched_set_param(i2c_proto_sched_t *sched, uint16_t module_key, ParamId_t param_id, ParamValue_t param_value)
+{
+    if (!sched || I2C_PROTO_MODULE_KEY_CHANNEL(module_key) >= 8)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!target_find(sched, module_key, true))
+    {
+        return ESP_ERR_NO_MEM; // Error: Too many modules
+    }
+    return i2c_proto_coalescer_set(&sched->coalescer, module_key, param_id, param_value);
+}
+
+// Implementation for i2c_proto_sched_set_encoding
+esp_err_t i2c_proto_sched_set_encoding(i2c_proto_sched_t *sched, uint16_t module_key, i2c_proto_encoding_t encoding)
+{
+    if (!sched || I2C_PROTO_MODULE_KEY_CHANNEL(module_key) >= 8)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!target_find(sched, module_key, true))
+    {
+        return ESP_ERR_NO_MEM; // Error: Too many modules
+    }
+    return i2c_proto_coalescer_set_encoding(&sched->coalescer, module_key, encoding);
+}
+
+// Implementation for i2c_proto_sched_negotiate
+esp_err_t i2c_proto_sched_negotiate(i2c_proto_sched_t *sched, const i2c_proto_enum_result_t *results, size_t count)
+{
+    if (!sched || (!results && count > 0))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        esp_err_t err = i2c_proto_sched_set_encoding(sched, results[i].module_key,
+                                                     i2c_proto_negotiate_encoding(results[i].identity.capabilities));
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+// Implementation for i2c_proto_sched_io_done
+void i2c_proto_sched_io_done(i2c_proto_sched_t *sched, esp_err_t err, size_t resp_len)
+{
+    sched->io_err = err;
+    sched->io_resp_len = resp_len;
+    atomic_store_explicit(&sched->io_pending, false, memory_order_release);
+}
+
+// Implementation for i2c_proto_sched_poll
+bool i2c_proto_sched_poll(i2c_proto_sched_t *sched)
+{
+    if (!sched)
+    {
+        return false;
+    }
+
+    if (sched->state != SCHED_IDLE)
+    {
+        if (atomic_load_explicit(&sched->io_pending, memory_order_acquire))
+        {
+            return true; // Still on the bus
+        }
+
+        if (sched->state == SCHED_SELECTING)
+        {
+            if (sched->io_err == ESP_OK)
+            {
+                sched->mux_channel = I2C_PROTO_MODULE_KEY_CHANNEL(sched->frames[sched->active].module_key);
+                sched->burst = 0;
+                start_transfer(sched);
+                return true;
+            }
+            sched->mux_channel = -1; // Mux state unknown after a failed switch
+            frame_complete(sched, sched->io_err, 0);
+        }
+        else
+        {
+            sched->transfers++;
+            frame_complete(sched, sched->io_err, sched->io_resp_len);
+        }
+    }
+
+    uint8_t prio;
+    i2c_proto_sched_target_t *target = pick_target(sched, &prio);
+    if (!target)
+    {
+        return false; // Nothing to send
+    }
+    sched->active = target_take(sched, target, prio);
+    if (sched->active == SCHED_NONE)
+    {
+        return true; // Coalescer produced no frame: retry on the next poll
+    }
+
+    const uint8_t channel = I2C_PROTO_MODULE_KEY_CHANNEL(target->module_key);
+    if (sched->transport.select_channel && channel != sched->mux_channel)
+    {
+        sched->state = SCHED_SELECTING;
+        sched->mux_switches++;
+        atomic_store_explicit(&sched->io_pending, true, memory_order_relaxed);
+        esp_err_t err = sched->transport.select_channel(sched->transport.ctx, (uint8_t)(1U << channel));
+        if (err != ESP_OK)
+        {
+            i2c_proto_sched_io_done(sched, err, 0);
+        }
+        return true;
+    }
+
+    start_transfer(sched);
+    return true;
+}
+
+static bool enum_candidate(const i2c_proto_enum_t *en, uint8_t address)
+{
+    return (en->candidates[address / 8] & (1U << (address % 8))) != 0;
+}
+
+static void enum_start_op(i2c_proto_enum_t *en, uint8_t op)
+{
+    const i2c_proto_sched_transport_t *io = &en->transport;
+    esp_err_t err;
+
+    en->op = op;
+    en->transfers++;
+    atomic_store_explicit(&en->io_pending, true, memory_order_relaxed);
+    switch (op)
+    {
+    case ENUM_OP_SELECT:
+        err = io->select_channel(io->ctx, en->phase == ENUM_PROBING ? en->channel_mask : (uint8_t)(1U << en->channel));
+        break;
+    case ENUM_OP_PROBE:
+        en->cmd = REG_COMMON_MODULE_TYPE; // Known to every firmware and free of side effects
+        err = io->write_async(io->ctx, en->address, &en->cmd, 1);
+        break;
+    case ENUM_OP_IDENTIFY:
+        en->cmd = REG_COMMON_IDENTITY;
+        err = io->write_read_async(io->ctx, en->address, &en->cmd, 1, en->resp, sizeof(en->resp));
+        break;
+    case ENUM_OP_LEGACY_VERSION:
+        en->cmd = REG_COMMON_FIRMWARE_VERSION;
+        err = io->write_read_async(io->ctx, en->address, &en->cmd, 1, en->resp, 2);
+        break;
+    case ENUM_OP_LEGACY_TYPE:
+        en->cmd = REG_COMMON_MODULE_TYPE;
+        err = io->write_read_async(io->ctx, en->address, &en->cmd, 1, en->resp, 1);
+        break;
+    default:
+        en->cmd = REG_COMMON_STATUS;
+        err = io->write_read_async(io->ctx, en->address, &en->cmd, 1, en->resp, 1);
+        break;
+    }
+    if (err != ESP_OK)
+    {
+        i2c_proto_enum_io_done(en, err, 0); // Could not start: finishes on the next poll
+    }
+}
+
+static void enum_record(i2c_proto_enum_t *en, const ModuleIdentity_t *identity)
+{
+    if (en->count < en->max_results)
+    {
+        en->results[en->count].module_key = I2C_PROTO_MODULE_KEY(en->channel, en->address);
+        en->results[en->count].identity = *identity;
+    }
+    en->count++;
+}
+
+// A real REG_COMMON_IDENTITY answer; older firmware cannot claim 2.5 or later
+static bool identity_valid(const ModuleIdentity_t *identity)
+{
+    return identity->version_major > I2C_PROTO_VERSION_MAJOR ||
+           (identity->version_major == I2C_PROTO_VERSION_MAJOR && identity->version_minor >= 5);
+}
+
+// Fold the result of the finished operation into the scan
+static void enum_finish_op(i2c_proto_enum_t *en)
+{
+    const esp_err_t err = en->io_err;
+    switch (en->op)
+    {
+    case ENUM_OP_SELECT:
+        if (err == ESP_OK)
+        {
+            break;
+        }
+        if (en->phase == ENUM_PROBING)
+        {
+            // Cannot open every channel at once: try every address on each channel
+            memset(en->candidates, 0xFF, sizeof(en->candidates));
+            en->phase = ENUM_IDENTIFYING;
+        }
+        en->address = (uint8_t)(en->last_address + 1); // Skip to the next channel
+        break;
+    case ENUM_OP_PROBE:
+        if (err == ESP_OK)
+        {
+            en->candidates[en->address / 8] |= (uint8_t)(1U << (en->address % 8));
+        }
+        en->address++;
+        break;
+    case ENUM_OP_IDENTIFY:
+    {
+        ModuleIdentity_t identity;
+        if (err == ESP_OK && i2c_proto_unpack_identity(en->resp, en->io_resp_len, &identity) && identity_valid(&identity))
+        {
+            enum_record(en, &identity);
+            en->address++;
+        }
+        else if (err == ESP_OK)
+        {
+            en->legacy_op = ENUM_OP_LEGACY_VERSION; // Acknowledged without an identity: older firmware
+        }
+        else
+        {
+            en->address++;
+        }
+        break;
+    }
+    case ENUM_OP_LEGACY_VERSION:
+    case ENUM_OP_LEGACY_TYPE:
+    case ENUM_OP_LEGACY_STATUS:
+        if (err != ESP_OK || en->io_resp_len < (en->op == ENUM_OP_LEGACY_VERSION ? 2U : 1U))
+        {
+            en->legacy_op = ENUM_OP_NONE; // Drop the module
+            en->address++;
+            break;
+        }
+        if (en->op == ENUM_OP_LEGACY_VERSION)
+        {
+            memset(&en->legacy, 0, sizeof(en->legacy));
+            en->legacy.version_major = en->resp[0];
+            en->legacy.version_minor = en->resp[1];
+            en->legacy.capabilities = i2c_proto_caps_from_version(en->resp[0], en->resp[1]);
+            en->legacy_op = ENUM_OP_LEGACY_TYPE;
+        }
+        else if (en->op == ENUM_OP_LEGACY_TYPE)
+        {
+            en->legacy.module_type = en->resp[0];
+            en->legacy_op = ENUM_OP_LEGACY_STATUS;
+        }
+        else
+        {
+            en->legacy.status = en->resp[0];
+            enum_record(en, &en->legacy); // param_count stays 0: unknown
+            en->legacy_op = ENUM_OP_NONE;
+            en->address++;
+        }
+        break;
+    default:
+        break;
+    }
+    en->op = ENUM_OP_NONE;
+}
+
+// Start the next operation of the scan; false once it is complete
+static bool enum_next(i2c_proto_enum_t *en)
+{
+    if (en->phase == ENUM_PROBING)
+    {
+        if (en->address <= en->last_address)
+        {
+            enum_start_op(en, ENUM_OP_PROBE);
+            return true;
+        }
+        en->phase = ENUM_IDENTIFYING; // address is past the range, so the first channel is selected below
+    }
+
+    while (en->phase == ENUM_IDENTIFYING)
+    {
+        if (en->legacy_op != ENUM_OP_NONE)
+        {
+            enum_start_op(en, en->legacy_op);
+            return true;
+        }
+        while (en->address <= en->last_address && !enum_candidate(en, en->address))
+        {
+            en->address++;
+        }
+        if (en->address <= en->last_address)
+        {
+            enum_start_op(en, ENUM_OP_IDENTIFY);
+            return true;
+        }
+
+        // Channel finished: move to the next one in the mask
+        do
+        {
+            en->channel++;
+        } while (en->channel < 8 && !(en->channel_mask & (1U << en->channel)));
+        if (en->channel >= 8)
+        {
+            en->phase = ENUM_DONE;
+            break;
+        }
+        en->address = en->first_address;
+        if (en->transport.select_channel)
+        {
+            enum_start_op(en, ENUM_OP_SELECT);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Implementation for i2c_proto_enum_start
+esp_err_t i2c_proto_enum_start(i2c_proto_enum_t *en, const i2c_proto_sched_transport_t *transport, uint8_t channel_mask,
+                               uint8_t first_address, uint8_t last_address, i2c_proto_enum_result_t *results, size_t max_results)
+{
+    if (!en || !transport || !transport->write_async || !transport->write_read_async || (!results && max_results > 0))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!transport->select_channel)
+    {
+        channel_mask = 1; // No mux: everything is on "channel 0"
+    }
+    if (channel_mask == 0 || first_address > last_address || last_address > 0x7F)
+    {
+        return ESP_ERR_INVALID_ARG; // Error: Nothing to scan
+    }
+
+    memset(en, 0, sizeof(*en));
+    en->transport = *transport;
+    en->results = results;
+    en->max_results = max_results;
+    en->channel_mask = channel_mask;
+    en->first_address = first_address;
+    en->last_address = last_address;
+    en->channel = -1;
+    en->op = ENUM_OP_NONE;
+    en->legacy_op = ENUM_OP_NONE;
+    atomic_init(&en->io_pending, false);
+
+    if (transport->select_channel && (channel_mask & (channel_mask - 1)) != 0)
+    {
+        en->phase = ENUM_PROBING; // Several channels: rule addresses out on all of them at once
+        en->address = first_address;
+    }
+    else
+    {
+        memset(en->candidates, 0xFF, sizeof(en->candidates));
+        en->phase = ENUM_IDENTIFYING;
+        en->address = (uint8_t)(last_address + 1);
+    }
+    return ESP_OK;
+}
+
+// Implementation for i2c_proto_enum_io_done
+void i2c_proto_enum_io_done(i2c_proto_enum_t *en, esp_err_t err, size_t resp_len)
+{
+    en->io_err = err;
+    en->io_resp_len = resp_len;
+    atomic_store_explicit(&en->io_pending, false, memory_order_release);
+}
+
+// Implementation for i2c_proto_enum_poll
+bool i2c_proto_enum_poll(i2c_proto_enum_t *en)
+{
+    if (!en || en->phase == ENUM_DONE)
+    {
+        return false;
+    }
+
+    if (en->op != ENUM_OP_NONE)
+    {
+        if (atomic_load_explicit(&en->io_pending, memory_order_acquire))
+        {
+            return true; // Still on the bus
+        }
+        enum_finish_op(en);
+    }
+    else if (en->phase == ENUM_PROBING && en->address == en->first_address && en->transfers == 0)
+    {
+        enum_start_op(en, ENUM_OP_SELECT); // First poll: open every channel for probing
+        return true;
+    }
+    return enum_next(en);
+}
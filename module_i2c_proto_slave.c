@@ -0,0 +1,1929 @@
+#include "module_i2c_proto.h"
+#include "module_i2c_proto_port.h"
+#include <string.h> // For memcpy
+#include <stdint.h>
+#include <stdatomic.h>
+#include "esp_attr.h" // For DMA_ATTR
+
+_Static_assert((MODULE_I2C_PROTO_QUEUE_LEN & (MODULE_I2C_PROTO_QUEUE_LEN - 1)) == 0,
+               "MODULE_I2C_PROTO_QUEUE_LEN must be a power of two");
+_Static_assert(MODULE_I2C_PROTO_PARAM_CALLBACKS < UINT8_MAX, "Callback pool slots are indexed by uint8_t");
+_Static_assert(MODULE_I2C_PROTO_RESP_BUFFERS <= 32, "Response pool in-use flags must fit one word");
+
+#define CALLBACK_NONE UINT8_MAX // End of a subscriber or free list
+#define SETTINGS_COMMIT_EVERY 8 // Parameters written per NVS commit while saving
+
+// Settings job requests (s_settings.request)
+#define SETTINGS_SAVE (1U << 0)
+#define SETTINGS_LOAD (1U << 1)
+
+// Slave-side protocol state. Everything here is touched from the I2C receive
+// path, so there is no locking and no allocation.
+typedef struct {
+    module_i2c_proto_param_cb_t callback;
+    void *user_data;
+    uint8_t next; // Next subscriber of the same parameter, or next free slot
+} param_callback_t;
+
+// Kinds of queued parameter writes
+enum {
+    PENDING_SET,   // Apply as soon as the queue is drained
+    PENDING_TIMED, // Hold until frame (REG_COMMON_SET_PARAM_TIMED)
+    PENDING_RAMP,  // Glide to value over frame samples (REG_COMMON_SET_PARAM_RAMP)
+    PENDING_I2S,   // Switch I2S slots at frame (REG_COMMON_I2S_COMMIT); value.u8 holds in, out
+    PENDING_LOAD,  // Value read back by CMD_COMMON_LOAD_SETTINGS; already matches storage
+    PENDING_LOCAL, // module_i2c_proto_set_param(); flagged for the master once applied
+};
+
+// Validated parameter write waiting for module_i2c_proto_apply_pending()
+typedef struct {
+    uint8_t index;  // Descriptor index (unused for PENDING_I2S)
+    uint8_t kind;   // PENDING_*
+    uint32_t frame; // TDM frame for timed writes, ramp length for ramps
+    ParamValue_t value;
+} pending_param_t;
+
+// Ramp in progress, consumer-side only
+typedef struct {
+    bool active;
+    int64_t start;   // Value when the ramp began
+    int64_t target;
+    uint32_t total;  // Ramp length in samples
+    uint32_t elapsed;
+} param_ramp_t;
+
+static struct {
+    bool initialized;
+    bool deferred_apply;
+    uint8_t module_type;
+    uint8_t address;
+    atomic_uint status; // STATUS_* flags, updated from both the I2C and the audio side
+    int attention_gpio; // -1 if not configured
+    uint32_t capabilities; // I2C_PROTO_CAP_* advertised and accepted
+    atomic_uint dirty[I2C_PROTO_PARAM_BITMAP_WORDS]; // Locally changed parameters, by descriptor index
+    I2sConfig_t i2s_config;
+    I2sConfig_t i2s_staged; // REG_COMMON_I2S_STAGE, valid while i2s_staged_valid
+    bool i2s_staged_valid;
+    uint8_t group_mask; // REG_COMMON_GROUP_CONFIG membership
+    uint8_t callback_head[I2C_PROTO_PARAM_COUNT]; // First s_callbacks slot per descriptor index, CALLBACK_NONE if none
+    module_i2c_proto_command_cb_t command_callback;
+    void *command_user_data;
+} s_proto;
+
+// Every parameter's current value; outside s_proto so MODULE_I2C_PROTO_GET_*()
+// can load from it directly
+module_i2c_proto_params_t i2c_proto_param_values;
+
+// Fixed pool behind every parameter's subscriber list
+static struct {
+    param_callback_t slots[MODULE_I2C_PROTO_PARAM_CALLBACKS];
+    uint8_t free; // Head of the free list
+} s_callbacks;
+
+// Response pool; bit i of s_resp_in_use is set while buffer i is handed out
+static DMA_ATTR uint8_t s_resp_buffers[MODULE_I2C_PROTO_RESP_BUFFERS][MODULE_I2C_PROTO_RESP_BUF_LEN];
+static atomic_uint s_resp_in_use;
+
+// Single-producer / single-consumer (apply_pending) ring. head and tail run
+// freely and are masked on access.
+typedef struct {
+    pending_param_t items[MODULE_I2C_PROTO_QUEUE_LEN];
+    atomic_uint head; // Written only by the producer
+    atomic_uint tail; // Written only by the consumer
+} param_queue_t;
+
+// Writes from process_command, values loaded by the settings worker and
+// local writes (module_i2c_proto_set_param() and friends)
+static param_queue_t s_queue;
+static param_queue_t s_load_queue;
+static param_queue_t s_local_queue;
+
+// Timed writes taken off s_queue that wait for their frame, sorted by frame.
+// Consumer-side only.
+static struct {
+    pending_param_t items[MODULE_I2C_PROTO_TIMED_LEN];
+    size_t count;
+} s_timed;
+
+// Timed writes accepted and not fired yet (on s_queue or in s_timed).
+// process_command reserves a place before queueing, so s_timed never overflows.
+static atomic_uint s_timed_pending;
+
+// Ramps by descriptor index, plus the number of ramps per parameter that have
+// been queued but not finished yet. While that count is non-zero SET_PARAM
+// writes for the parameter are queued so they cannot overtake the ramp.
+static param_ramp_t s_ramps[I2C_PROTO_PARAM_COUNT];
+static atomic_uint s_ramp_refs[I2C_PROTO_PARAM_COUNT];
+
+// Committed I2S slot change waiting for its frame; a newer commit replaces it.
+// Consumer-side only.
+static struct {
+    bool pending;
+    uint32_t frame;
+    I2sConfig_t config;
+} s_i2s_switch;
+
+// Background SAVE/LOAD_SETTINGS job, run by the port's worker task.
+// unsaved has one bit per descriptor index changed since it was last saved.
+static struct {
+    atomic_uint request; // SETTINGS_* waiting for the worker
+    atomic_uint unsaved[I2C_PROTO_PARAM_BITMAP_WORDS];
+} s_settings;
+
+// Receive arena. The driver fills buffers[head % count] while rx_process
+// drains buffers[tail % count]; same free-running SPSC scheme as s_queue.
+static DMA_ATTR uint8_t s_rx_buffers[MODULE_I2C_PROTO_RX_BUFFERS][MODULE_I2C_PROTO_RX_BUF_LEN];
+
+static struct {
+    uint8_t count;     // Buffers in use, 0 = arena disabled
+    uint16_t buf_len;  // Usable bytes per buffer
+    uint16_t len[MODULE_I2C_PROTO_RX_BUFFERS]; // Received length of each committed buffer
+    atomic_uint head;  // Committed buffers, written only by the driver side
+    atomic_uint tail;  // Processed buffers, written only by rx_process
+    atomic_uint overruns;
+} s_rx;
+
+// Decode task (dispatch_core) and the triple buffer it publishes parameter
+// values through. blocks[back] is written only by the task and
+// blocks[front] only by params_snapshot; middle holds the index of the
+// last published block, with DISPATCH_FRESH set until the reader takes it.
+//
+// Commits made on the audio task (ramps, timed and deferred writes) are
+// numbered by audio_seq and kept in audio_values. Each block records the
+// audio_seq it was copied after; params_snapshot merges the newer ones into
+// the front block until a block that already has them is swapped in.
+#define DISPATCH_FRESH 4U
+
+typedef struct {
+    module_i2c_proto_params_t params;
+    uint32_t audio_seq; // Audio-side commits already contained in params
+} dispatch_block_t;
+
+static struct {
+    bool enabled;
+    module_i2c_proto_response_cb_t response_callback;
+    void *response_user_data;
+    dispatch_block_t blocks[3];
+    atomic_uint middle;
+    uint8_t back;
+    uint8_t front;
+    atomic_uint audio_seq; // Written only by the audio task
+    // Audio task only
+    module_i2c_proto_params_t audio_values;
+    uint32_t audio_stamp[I2C_PROTO_PARAM_COUNT];         // audio_seq of each parameter's last audio-side commit
+    uint32_t audio_pending[I2C_PROTO_PARAM_BITMAP_WORDS]; // Audio-side commits some published block may lack
+} s_dispatch;
+
+#if MODULE_I2C_PROTO_STATS
+// Counter slots: registers 0x00..REG_COMMON_I2S_COMMIT, then the CMD_COMMON_*
+// commands, then input that did not split into messages
+#define STATS_SLOT_COMMANDS (REG_COMMON_I2S_COMMIT + 1)
+#define STATS_SLOT_UNPARSED (STATS_SLOT_COMMANDS + CMD_COMMON_LOAD_SETTINGS - CMD_COMMON_RESET + 1)
+#define STATS_SLOTS         (STATS_SLOT_UNPARSED + 1)
+
+// Per-command counters. Only the process_command context writes them, so
+// updates are relaxed load/store pairs rather than read-modify-writes.
+typedef struct {
+    atomic_uint messages;
+    atomic_uint bytes;
+    atomic_uint errors;
+    atomic_uint decode_errors;
+    atomic_uint cycles_max;
+    atomic_uint cycles_total;
+    atomic_uint histogram[I2C_PROTO_DIAG_BUCKETS];
+} cmd_stats_t;
+
+static cmd_stats_t s_stats[STATS_SLOTS];
+
+static size_t stats_slot(uint8_t cmd)
+{
+    if (cmd < STATS_SLOT_COMMANDS)
+    {
+        return cmd;
+    }
+    if (cmd >= CMD_COMMON_RESET && cmd <= CMD_COMMON_LOAD_SETTINGS)
+    {
+        return STATS_SLOT_COMMANDS + (size_t)(cmd - CMD_COMMON_RESET);
+    }
+    return STATS_SLOT_UNPARSED;
+}
+
+static inline void stats_add(atomic_uint *counter, uint32_t n)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static inline uint32_t stats_now(void)
+{
+    return i2c_proto_port_cycles();
+}
+
+// Account for one message of len bytes that started at cycle start
+static void stats_record(uint8_t cmd, size_t len, esp_err_t err, uint32_t start)
+{
+    const uint32_t cycles = i2c_proto_port_cycles() - start;
+    cmd_stats_t *stats = &s_stats[stats_slot(cmd)];
+
+    stats_add(&stats->messages, 1);
+    stats_add(&stats->bytes, (uint32_t)len);
+    if (err != ESP_OK)
+    {
+        stats_add(&stats->errors, 1);
+        if (err == ESP_ERR_INVALID_ARG || err == ESP_ERR_INVALID_SIZE || err == ESP_ERR_INVALID_CRC)
+        {
+            stats_add(&stats->decode_errors, 1);
+        }
+    }
+    if (cycles > atomic_load_explicit(&stats->cycles_max, memory_order_relaxed))
+    {
+        atomic_store_explicit(&stats->cycles_max, cycles, memory_order_relaxed);
+    }
+    stats_add(&stats->cycles_total, cycles);
+
+    size_t bucket = 0;
+    while (bucket < I2C_PROTO_DIAG_BUCKETS - 1 && cycles >= (1U << (I2C_PROTO_DIAG_BUCKET_SHIFT + bucket)))
+    {
+        bucket++;
+    }
+    stats_add(&stats->histogram[bucket], 1);
+}
+
+static void stats_read(uint8_t cmd, DiagStats_t *out)
+{
+    const cmd_stats_t *stats = &s_stats[stats_slot(cmd)];
+    out->messages = atomic_load_explicit(&stats->messages, memory_order_relaxed);
+    out->bytes = atomic_load_explicit(&stats->bytes, memory_order_relaxed);
+    out->errors = atomic_load_explicit(&stats->errors, memory_order_relaxed);
+    out->decode_errors = atomic_load_explicit(&stats->decode_errors, memory_order_relaxed);
+    out->cycles_max = atomic_load_explicit(&stats->cycles_max, memory_order_relaxed);
+    out->cycles_total = atomic_load_explicit(&stats->cycles_total, memory_order_relaxed);
+    for (size_t b = 0; b < I2C_PROTO_DIAG_BUCKETS; b++)
+    {
+        out->histogram[b] = atomic_load_explicit(&stats->histogram[b], memory_order_relaxed);
+    }
+}
+
+static void stats_clear(size_t slot)
+{
+    cmd_stats_t *stats = &s_stats[slot];
+    atomic_store_explicit(&stats->messages, 0, memory_order_relaxed);
+    atomic_store_explicit(&stats->bytes, 0, memory_order_relaxed);
+    atomic_store_explicit(&stats->errors, 0, memory_order_relaxed);
+    atomic_store_explicit(&stats->decode_errors, 0, memory_order_relaxed);
+    atomic_store_explicit(&stats->cycles_max, 0, memory_order_relaxed);
+    atomic_store_explicit(&stats->cycles_total, 0, memory_order_relaxed);
+    for (size_t b = 0; b < I2C_PROTO_DIAG_BUCKETS; b++)
+    {
+        atomic_store_explicit(&stats->histogram[b], 0, memory_order_relaxed);
+    }
+}
+#else
+static inline uint32_t stats_now(void)
+{
+    return 0;
+}
+
+static inline void stats_record(uint8_t cmd, size_t len, esp_err_t err, uint32_t start)
+{
+    (void)cmd;
+    (void)len;
+    (void)err;
+    (void)start;
+}
+#endif
+
+// Frame comparison modulo 2^32
+static inline bool frame_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+// Widen the value in src (the parameter's C type) for range checking
+static int64_t param_value_as_int(const ParamDescriptor_t *desc, const void *src)
+{
+    switch (desc->type)
+    {
+    case PARAM_TYPE_U8:
+        return *(const uint8_t *)src;
+    case PARAM_TYPE_U16:
+    {
+        uint16_t v;
+        memcpy(&v, src, sizeof(v));
+        return v;
+    }
+    case PARAM_TYPE_S16:
+    {
+        int16_t v;
+        memcpy(&v, src, sizeof(v));
+        return v;
+    }
+    case PARAM_TYPE_U32:
+    default:
+    {
+        uint32_t v;
+        memcpy(&v, src, sizeof(v));
+        return v;
+    }
+    }
+}
+
+// Native value of a parameter (its C type in the leading desc->width bytes)
+// from the little-endian wire bytes at wire
+static ParamValue_t param_from_wire(const ParamDescriptor_t *desc, const uint8_t *wire)
+{
+    ParamValue_t v = {.u32 = 0};
+    switch (desc->width)
+    {
+    case 1:
+        v.u8[0] = wire[0];
+        break;
+    case 2:
+        v.u16[0] = i2c_proto_rd_le16(wire);
+        break;
+    default:
+        v.u32 = i2c_proto_rd_le32(wire);
+        break;
+    }
+    return v;
+}
+
+// Native value of a parameter from an integer already in its range
+static ParamValue_t param_from_int(const ParamDescriptor_t *desc, int64_t value)
+{
+    ParamValue_t v = {.u32 = 0};
+    switch (desc->width)
+    {
+    case 1:
+        v.u8[0] = (uint8_t)value;
+        break;
+    case 2:
+        v.u16[0] = (uint16_t)value;
+        break;
+    default:
+        v.u32 = (uint32_t)value;
+        break;
+    }
+    return v;
+}
+
+// Write the native value at src as desc->width little-endian bytes
+static void param_to_wire(const ParamDescriptor_t *desc, const void *src, uint8_t *wire)
+{
+    const uint32_t value = (uint32_t)param_value_as_int(desc, src);
+    for (size_t b = 0; b < desc->width; b++)
+    {
+        wire[b] = (uint8_t)(value >> (8 * b));
+    }
+}
+
+static esp_err_t check_param(const ParamDescriptor_t *desc, const void *src)
+{
+    const int64_t v = param_value_as_int(desc, src);
+    if (v < desc->min || v > desc->max)
+    {
+        return ESP_ERR_INVALID_ARG; // Error: Value out of range
+    }
+    return ESP_OK;
+}
+
+// Decode wire_len little-endian wire bytes into the parameter's native value
+// and range-check it. A 4-byte wire value (ParamValue_t) must be the zero
+// extension of the native value, or for signed types also its sign
+// extension; check_param only sees the native value, so anything else would
+// be accepted truncated.
+static esp_err_t check_wire_param(const ParamDescriptor_t *desc, const uint8_t *value, size_t wire_len, ParamValue_t *out)
+{
+    *out = param_from_wire(desc, value);
+    if (wire_len > desc->width)
+    {
+        const uint32_t raw = i2c_proto_rd_le32(value);
+        const int64_t native = param_value_as_int(desc, out);
+        const bool extended = desc->type == PARAM_TYPE_S16
+                                  ? (int32_t)raw == native || raw == (uint16_t)native
+                                  : raw == native;
+        if (!extended)
+        {
+            return ESP_ERR_INVALID_ARG; // Error: Value out of range
+        }
+    }
+    return check_param(desc, out);
+}
+
+// Parameter fields are written from the I2C, audio and worker contexts while
+// the dispatch task copies them, so each field is stored and loaded with one
+// single-copy atomic access. dst (or src) is a field of a parameter block.
+static void field_store(const ParamDescriptor_t *desc, uint8_t *dst, const void *src)
+{
+    ParamValue_t v;
+    memcpy(&v, src, desc->width); // src may be unaligned
+    switch (desc->width)
+    {
+    case 1:
+        __atomic_store_n(dst, v.u8[0], __ATOMIC_RELAXED);
+        break;
+    case 2:
+        __atomic_store_n((uint16_t *)dst, v.u16[0], __ATOMIC_RELAXED);
+        break;
+    default:
+        __atomic_store_n((uint32_t *)dst, v.u32, __ATOMIC_RELAXED);
+        break;
+    }
+}
+
+static void field_load(const ParamDescriptor_t *desc, uint8_t *dst, const uint8_t *src)
+{
+    switch (desc->width)
+    {
+    case 1:
+        *dst = __atomic_load_n(src, __ATOMIC_RELAXED);
+        break;
+    case 2:
+        *(uint16_t *)dst = __atomic_load_n((const uint16_t *)src, __ATOMIC_RELAXED);
+        break;
+    default:
+        *(uint32_t *)dst = __atomic_load_n((const uint32_t *)src, __ATOMIC_RELAXED);
+        break;
+    }
+}
+
+// Wake the dispatch task, if there is one, to publish a change made outside it
+static void dispatch_wake(void)
+{
+    if (s_dispatch.enabled)
+    {
+        i2c_proto_port_dispatch_notify();
+    }
+}
+
+// Store an already validated value and notify its subscribers. src holds desc->width bytes.
+static void commit_param(const ParamDescriptor_t *desc, const void *src)
+{
+    uint8_t *value = (uint8_t *)&i2c_proto_param_values + desc->offset;
+    const size_t index = (size_t)(desc - i2c_proto_param_descriptors);
+    field_store(desc, value, src);
+    atomic_fetch_or_explicit(&s_settings.unsaved[index / 32], 1U << (index % 32), memory_order_relaxed);
+
+    for (uint8_t i = s_proto.callback_head[index]; i != CALLBACK_NONE;
+         i = s_callbacks.slots[i].next)
+    {
+        const param_callback_t *cb = &s_callbacks.slots[i];
+        cb->callback(cb->user_data, value, desc->width);
+    }
+}
+
+static esp_err_t apply_param(const ParamDescriptor_t *desc, const void *src)
+{
+    esp_err_t err = check_param(desc, src);
+    if (err == ESP_OK)
+    {
+        commit_param(desc, src);
+    }
+    return err;
+}
+
+// Flag a locally made change for the master. The bit is set before the status
+// flag so that a concurrent bitmap read can at worst leave a spurious flag.
+static void mark_dirty(const ParamDescriptor_t *desc)
+{
+    const size_t index = (size_t)(desc - i2c_proto_param_descriptors);
+    atomic_fetch_or(&s_proto.dirty[index / 32], 1U << (index % 32));
+    atomic_fetch_or(&s_proto.status, STATUS_PARAM_CHANGED);
+    if (s_proto.attention_gpio >= 0)
+    {
+        i2c_proto_port_attention_set(s_proto.attention_gpio, true);
+    }
+}
+
+// Producer side of a queue: next free slot, or NULL if the queue is full.
+// The item is handed over by queue_publish().
+static pending_param_t *queue_slot(param_queue_t *queue)
+{
+    const unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    const unsigned tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head - tail >= MODULE_I2C_PROTO_QUEUE_LEN)
+    {
+        return NULL; // Error: Audio task is not draining fast enough
+    }
+    return &queue->items[head & (MODULE_I2C_PROTO_QUEUE_LEN - 1)];
+}
+
+static void queue_publish(param_queue_t *queue)
+{
+    const unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+}
+
+// Queue a parameter write. value is the parameter's native value.
+static esp_err_t queue_param(const ParamDescriptor_t *desc, const void *value, uint8_t kind, uint32_t frame)
+{
+    esp_err_t err = check_param(desc, value);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    pending_param_t *item = queue_slot(&s_queue);
+    if (!item)
+    {
+        return ESP_ERR_NO_MEM; // Error: Audio task is not draining fast enough
+    }
+    item->index = (uint8_t)(desc - i2c_proto_param_descriptors);
+    item->kind = kind;
+    item->frame = frame;
+    item->value.u32 = 0;
+    memcpy(&item->value, value, desc->width);
+    if (kind == PENDING_RAMP)
+    {
+        atomic_fetch_add_explicit(&s_ramp_refs[item->index], 1, memory_order_relaxed);
+    }
+    queue_publish(&s_queue);
+    return ESP_OK;
+}
+
+// Hand the staged I2S configuration to the audio task for the given frame.
+// Going through s_queue keeps it ordered with the parameter writes around it.
+static esp_err_t queue_i2s_switch(uint32_t frame)
+{
+    if (!s_proto.i2s_staged_valid)
+    {
+        return ESP_OK; // Nothing staged here; a group commit may be meant for other modules
+    }
+
+    pending_param_t *item = queue_slot(&s_queue);
+    if (!item)
+    {
+        return ESP_ERR_NO_MEM; // Error: Audio task is not draining fast enough
+    }
+    item->index = 0;
+    item->kind = PENDING_I2S;
+    item->frame = frame;
+    item->value.u32 = 0;
+    item->value.u8[0] = s_proto.i2s_staged.tdm_slot_in;
+    item->value.u8[1] = s_proto.i2s_staged.tdm_slot_out;
+    queue_publish(&s_queue);
+    s_proto.i2s_staged_valid = false;
+    return ESP_OK;
+}
+
+// Apply (or queue, in deferred mode or behind a ramp) a value straight from
+// the receive buffer. value points at the parameter's wire_len little-endian
+// wire bytes, decoded by width whatever the MCU's byte order.
+static esp_err_t apply_wire_param(ParamId_t param_id, const uint8_t *value, size_t wire_len)
+{
+    const ParamDescriptor_t *desc = i2c_proto_param_find(param_id);
+    if (!desc)
+    {
+        return ESP_ERR_NOT_FOUND; // Error: Unknown parameter
+    }
+    ParamValue_t native;
+    esp_err_t err = check_wire_param(desc, value, wire_len, &native);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    const bool ramping = atomic_load_explicit(&s_ramp_refs[desc - i2c_proto_param_descriptors], memory_order_relaxed) != 0;
+    return s_proto.deferred_apply || ramping ? queue_param(desc, &native, PENDING_SET, 0) : apply_param(desc, &native);
+}
+
+static void ramp_stop(size_t index)
+{
+    if (s_ramps[index].active)
+    {
+        s_ramps[index].active = false;
+        atomic_fetch_sub_explicit(&s_ramp_refs[index], 1, memory_order_relaxed);
+    }
+}
+
+// commit_param() from the audio task; also recorded for params_snapshot()
+static void commit_audio(const ParamDescriptor_t *desc, const void *src)
+{
+    commit_param(desc, src);
+    if (!s_dispatch.enabled)
+    {
+        return;
+    }
+
+    const size_t index = (size_t)(desc - i2c_proto_param_descriptors);
+    const uint32_t seq = atomic_load_explicit(&s_dispatch.audio_seq, memory_order_relaxed) + 1;
+    memcpy((uint8_t *)&s_dispatch.audio_values + desc->offset, src, desc->width);
+    s_dispatch.audio_stamp[index] = seq;
+    s_dispatch.audio_pending[index / 32] |= 1U << (index % 32);
+    // Release: a block copied after reading seq also holds the value stored above
+    atomic_store_explicit(&s_dispatch.audio_seq, seq, memory_order_release);
+}
+
+// Commit a queued write; it replaces any ramp in progress on the parameter
+static void commit_queued(const pending_param_t *item)
+{
+    ramp_stop(item->index);
+    commit_audio(&i2c_proto_param_descriptors[item->index], &item->value);
+}
+
+// Store a ramp value
+static void commit_ramp_value(const ParamDescriptor_t *desc, int64_t v)
+{
+    const ParamValue_t value = param_from_int(desc, v);
+    commit_audio(desc, &value);
+}
+
+// Begin a queued ramp from the parameter's current value
+static void ramp_start(const pending_param_t *item)
+{
+    const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[item->index];
+    param_ramp_t *ramp = &s_ramps[item->index];
+
+    ramp_stop(item->index);
+    if (item->frame == 0)
+    {
+        commit_audio(desc, &item->value); // Zero-length ramp: jump
+        atomic_fetch_sub_explicit(&s_ramp_refs[item->index], 1, memory_order_relaxed);
+        return;
+    }
+
+    ramp->start = param_value_as_int(desc, (const uint8_t *)&i2c_proto_param_values + desc->offset);
+    ramp->target = param_value_as_int(desc, &item->value);
+    ramp->total = item->frame;
+    ramp->elapsed = 0;
+    ramp->active = true; // Takes over the reference taken by queue_param
+}
+
+// Keep s_timed sorted; writes for the same frame stay in arrival order
+static void timed_insert(const pending_param_t *item)
+{
+    size_t pos = s_timed.count;
+    while (pos > 0 && frame_before(item->frame, s_timed.items[pos - 1].frame))
+    {
+        s_timed.items[pos] = s_timed.items[pos - 1];
+        pos--;
+    }
+    s_timed.items[pos] = *item;
+    s_timed.count++;
+}
+
+// Consumer side of a queue: apply untimed writes, park timed ones in s_timed
+// and start ramps. Returns the number of untimed writes applied.
+static size_t drain(param_queue_t *queue)
+{
+    // Take everything published so far in one go
+    const unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    const unsigned head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    size_t applied = 0;
+
+    for (unsigned i = tail; i != head; i++)
+    {
+        const pending_param_t *item = &queue->items[i & (MODULE_I2C_PROTO_QUEUE_LEN - 1)];
+        switch (item->kind)
+        {
+        case PENDING_TIMED:
+            timed_insert(item);
+            break;
+        case PENDING_RAMP:
+            ramp_start(item);
+            break;
+        case PENDING_I2S:
+            s_i2s_switch.pending = true;
+            s_i2s_switch.frame = item->frame;
+            s_i2s_switch.config.tdm_slot_in = item->value.u8[0];
+            s_i2s_switch.config.tdm_slot_out = item->value.u8[1];
+            break;
+        case PENDING_LOAD:
+            commit_queued(item);
+            atomic_fetch_and(&s_settings.unsaved[item->index / 32], ~(1U << (item->index % 32))); // Matches storage
+            applied++;
+            break;
+        case PENDING_LOCAL:
+            commit_queued(item);
+            mark_dirty(&i2c_proto_param_descriptors[item->index]);
+            applied++;
+            break;
+        default:
+            commit_queued(item);
+            applied++;
+            break;
+        }
+    }
+
+    atomic_store_explicit(&queue->tail, head, memory_order_release);
+    return applied;
+}
+
+// Loaded settings first: they were requested before anything still in s_queue
+// could depend on them
+static size_t drain_queue(void)
+{
+    size_t applied = drain(&s_load_queue);
+    applied += drain(&s_local_queue);
+    return applied + drain(&s_queue);
+}
+
+// Append len bytes to the response, failing if the master's read buffer is too small
+static esp_err_t respond(uint8_t *resp, size_t resp_cap, size_t *resp_used, const void *data, size_t len)
+{
+    if (!resp || resp_cap - *resp_used < len)
+    {
+        return ESP_ERR_INVALID_SIZE; // Error: No room for the response
+    }
+    memcpy(resp + *resp_used, data, len);
+    *resp_used += len;
+    return ESP_OK;
+}
+
+// Fill a REG_COMMON_GET_PARAM_RANGE response with as many entries as fit
+static esp_err_t respond_param_range(ParamId_t first, ParamId_t last, uint8_t *resp, size_t resp_cap, size_t *resp_used)
+{
+    if (!resp || resp_cap - *resp_used < I2C_PROTO_RANGE_RESP_HEADER_LEN)
+    {
+        return ESP_ERR_INVALID_SIZE; // Error: No room for the response header
+    }
+
+    uint8_t *header = resp + *resp_used;
+    size_t used = *resp_used + I2C_PROTO_RANGE_RESP_HEADER_LEN;
+    uint8_t count = 0;
+    bool more = false;
+
+    // The descriptor table is in ascending ID order, so entries come out sorted
+    for (size_t i = 0; i < I2C_PROTO_PARAM_COUNT; i++)
+    {
+        const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[i];
+        if (desc->id < first || desc->id > last)
+        {
+            continue;
+        }
+        if (resp_cap - used < sizeof(ParamId_t) + desc->width || count == UINT8_MAX)
+        {
+            more = true; // Master continues from the ID after our last entry
+            break;
+        }
+
+        // Compact entry: little-endian ID, then desc->width little-endian value bytes
+        resp[used++] = (uint8_t)desc->id;
+        resp[used++] = (uint8_t)(desc->id >> 8);
+        param_to_wire(desc, (const uint8_t *)&i2c_proto_param_values + desc->offset, resp + used);
+        used += desc->width;
+        count++;
+    }
+
+    header[0] = count;
+    header[1] = more;
+    *resp_used = used;
+    return ESP_OK;
+}
+
+// REG_COMMON_DIRTY_BITMAP: hand out and clear the locally changed parameters
+static esp_err_t respond_dirty_bitmap(uint8_t *resp, size_t resp_cap, size_t *resp_used)
+{
+    if (!resp || resp_cap - *resp_used < I2C_PROTO_DIRTY_BITMAP_LEN)
+    {
+        return ESP_ERR_INVALID_SIZE; // Error: No room for the response, keep the bits
+    }
+
+    atomic_fetch_and(&s_proto.status, ~(unsigned)STATUS_PARAM_CHANGED);
+    uint8_t *out = resp + *resp_used;
+    for (size_t w = 0; w < I2C_PROTO_PARAM_BITMAP_WORDS; w++)
+    {
+        const uint32_t bits = atomic_exchange(&s_proto.dirty[w], 0);
+        for (size_t b = 0; b < 4 && w * 4 + b < I2C_PROTO_DIRTY_BITMAP_LEN; b++)
+        {
+            out[w * 4 + b] = (uint8_t)(bits >> (8 * b));
+        }
+    }
+    *resp_used += I2C_PROTO_DIRTY_BITMAP_LEN;
+
+    if (s_proto.attention_gpio >= 0)
+    {
+        i2c_proto_port_attention_set(s_proto.attention_gpio, false);
+        if (atomic_load(&s_proto.status) & STATUS_PARAM_CHANGED)
+        {
+            i2c_proto_port_attention_set(s_proto.attention_gpio, true); // Changed again meanwhile
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t run_command_callback(uint8_t cmd)
+{
+    if (!s_proto.command_callback)
+    {
+        return ESP_ERR_NOT_SUPPORTED; // Nobody handles this command
+    }
+    return s_proto.command_callback(s_proto.command_user_data, cmd);
+}
+
+// Write every parameter changed since the last save, committing in chunks
+// so a power loss costs at most SETTINGS_COMMIT_EVERY values
+static esp_err_t settings_save(void)
+{
+    esp_err_t result = ESP_OK;
+    size_t staged = 0;
+    for (size_t index = 0; index < I2C_PROTO_PARAM_COUNT; index++)
+    {
+        const unsigned bit = 1U << (index % 32);
+        // Clear first: a change made while writing sets the bit again for the next save
+        if (!(atomic_fetch_and(&s_settings.unsaved[index / 32], ~bit) & bit))
+        {
+            continue;
+        }
+
+        const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[index];
+        esp_err_t err = i2c_proto_port_nvs_write(desc->id, (const uint8_t *)&i2c_proto_param_values + desc->offset, desc->width);
+        if (err == ESP_OK && ++staged == SETTINGS_COMMIT_EVERY)
+        {
+            err = i2c_proto_port_nvs_commit();
+            staged = 0;
+        }
+        if (err != ESP_OK)
+        {
+            atomic_fetch_or(&s_settings.unsaved[index / 32], bit); // Retry on the next save
+            if (result == ESP_OK)
+            {
+                result = err;
+            }
+        }
+    }
+
+    esp_err_t err = staged ? i2c_proto_port_nvs_commit() : ESP_OK;
+    return result == ESP_OK ? err : result;
+}
+
+// Apply one value read back from storage. Like a write from the master, it
+// goes through the audio task in deferred mode and behind a ramp, so callbacks
+// run where the application expects them and the ramp cannot overwrite it.
+static esp_err_t load_param(const ParamDescriptor_t *desc, const ParamValue_t *value)
+{
+    esp_err_t err = check_param(desc, value);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    const size_t index = (size_t)(desc - i2c_proto_param_descriptors);
+    const bool ramping = atomic_load_explicit(&s_ramp_refs[index], memory_order_relaxed) != 0;
+    if (!s_proto.deferred_apply && !ramping)
+    {
+        commit_param(desc, value);
+        atomic_fetch_and(&s_settings.unsaved[index / 32], ~(1U << (index % 32))); // Matches storage now
+        return ESP_OK;
+    }
+
+    pending_param_t *item = queue_slot(&s_load_queue);
+    if (!item)
+    {
+        return ESP_ERR_NO_MEM; // Error: Audio task is not draining fast enough
+    }
+    item->index = (uint8_t)index;
+    item->kind = PENDING_LOAD;
+    item->frame = 0;
+    item->value = *value;
+    queue_publish(&s_load_queue);
+    return ESP_OK;
+}
+
+// Apply every saved parameter; loaded values count as local changes so the
+// master sees them in REG_COMMON_DIRTY_BITMAP
+static esp_err_t settings_load(void)
+{
+    esp_err_t result = ESP_OK;
+    for (size_t index = 0; index < I2C_PROTO_PARAM_COUNT; index++)
+    {
+        const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[index];
+        ParamValue_t value = {.u32 = 0};
+        esp_err_t err = i2c_proto_port_nvs_read(desc->id, &value, desc->width);
+        if (err == ESP_ERR_NOT_FOUND)
+        {
+            continue; // Never saved: keep the current value
+        }
+        if (err == ESP_OK)
+        {
+            err = load_param(desc, &value);
+        }
+        if (err == ESP_OK)
+        {
+            mark_dirty(desc);
+        }
+        else if (result == ESP_OK)
+        {
+            result = err;
+        }
+    }
+    return result;
+}
+
+// Worker job: serve requests until none are left, then drop STATUS_BUSY
+static void settings_job(void)
+{
+    for (;;)
+    {
+        const unsigned request = atomic_exchange(&s_settings.request, 0);
+        if (request == 0)
+        {
+            atomic_fetch_and(&s_proto.status, ~(unsigned)STATUS_BUSY);
+            if (atomic_load(&s_settings.request) == 0)
+            {
+                return;
+            }
+            atomic_fetch_or(&s_proto.status, STATUS_BUSY); // Requested while clearing
+            continue;
+        }
+
+        esp_err_t err = ESP_OK;
+        if (request & SETTINGS_LOAD)
+        {
+            err = settings_load();
+            dispatch_wake(); // Values applied here rather than on the audio task
+            esp_err_t cb_err = run_command_callback(CMD_COMMON_LOAD_SETTINGS);
+            err = err == ESP_OK && cb_err != ESP_ERR_NOT_SUPPORTED ? cb_err : err;
+        }
+        if (request & SETTINGS_SAVE)
+        {
+            esp_err_t save_err = settings_save();
+            esp_err_t cb_err = run_command_callback(CMD_COMMON_SAVE_SETTINGS);
+            save_err = save_err == ESP_OK && cb_err != ESP_ERR_NOT_SUPPORTED ? cb_err : save_err;
+            err = err == ESP_OK ? save_err : err;
+        }
+        if (err != ESP_OK)
+        {
+            atomic_fetch_or(&s_proto.status, STATUS_ERROR);
+        }
+    }
+}
+
+// REG_COMMON_IDENTITY: everything enumeration needs in one response
+static esp_err_t respond_identity(uint8_t *resp, size_t resp_cap, size_t *resp_used)
+{
+    uint8_t identity[sizeof(ModuleIdentity_t)];
+    identity[offsetof(ModuleIdentity_t, module_type)] = s_proto.module_type;
+    identity[offsetof(ModuleIdentity_t, version_major)] = I2C_PROTO_VERSION_MAJOR;
+    identity[offsetof(ModuleIdentity_t, version_minor)] = I2C_PROTO_VERSION_MINOR;
+    identity[offsetof(ModuleIdentity_t, status)] = (uint8_t)atomic_load(&s_proto.status);
+    i2c_proto_wr_le16(identity + offsetof(ModuleIdentity_t, param_count), I2C_PROTO_PARAM_COUNT);
+    i2c_proto_wr_le32(identity + offsetof(ModuleIdentity_t, capabilities), s_proto.capabilities);
+    return respond(resp, resp_cap, resp_used, identity, sizeof(identity));
+}
+
+// REG_COMMON_DIAG: counters of one command, cleared afterwards on request
+static esp_err_t respond_diag(uint8_t cmd, uint8_t flags, uint8_t *resp, size_t resp_cap, size_t *resp_used)
+{
+#if MODULE_I2C_PROTO_STATS
+    DiagStats_t stats;
+    stats_read(cmd, &stats);
+
+    uint8_t out[sizeof(DiagStats_t)];
+    i2c_proto_wr_le32(out + offsetof(DiagStats_t, messages), stats.messages);
+    i2c_proto_wr_le32(out + offsetof(DiagStats_t, bytes), stats.bytes);
+    i2c_proto_wr_le32(out + offsetof(DiagStats_t, errors), stats.errors);
+    i2c_proto_wr_le32(out + offsetof(DiagStats_t, decode_errors), stats.decode_errors);
+    i2c_proto_wr_le32(out + offsetof(DiagStats_t, cycles_max), stats.cycles_max);
+    i2c_proto_wr_le32(out + offsetof(DiagStats_t, cycles_total), stats.cycles_total);
+    for (size_t b = 0; b < I2C_PROTO_DIAG_BUCKETS; b++)
+    {
+        i2c_proto_wr_le32(out + offsetof(DiagStats_t, histogram) + 4 * b, stats.histogram[b]);
+    }
+    esp_err_t err = respond(resp, resp_cap, resp_used, out, sizeof(out));
+    if (err == ESP_OK && (flags & I2C_PROTO_DIAG_CLEAR))
+    {
+        stats_clear(stats_slot(cmd));
+    }
+    return err;
+#else
+    (void)cmd;
+    (void)flags;
+    (void)resp;
+    (void)resp_cap;
+    (void)resp_used;
+    return ESP_ERR_NOT_SUPPORTED; // Unreachable: I2C_PROTO_CAP_DIAG is never advertised
+#endif
+}
+
+static esp_err_t process_frame(const uint8_t *frame, size_t frame_len, uint8_t *resp, size_t resp_cap, size_t *resp_used);
+
+// Process one message of msg_len bytes (already validated by i2c_proto_msg_len)
+static esp_err_t process_msg(const uint8_t *msg, size_t msg_len, uint8_t *resp, size_t resp_cap, size_t *resp_used)
+{
+    const uint8_t *payload = msg + 1;
+    const size_t payload_len = msg_len - 1;
+
+    const uint32_t capability = i2c_proto_cmd_capability(msg[0]);
+    if (capability && !(s_proto.capabilities & capability))
+    {
+        return ESP_ERR_NOT_SUPPORTED; // Error: Feature switched off in module_i2c_proto_config_t::disabled_caps
+    }
+
+    switch (msg[0])
+    {
+    case REG_COMMON_MODULE_TYPE:
+        return respond(resp, resp_cap, resp_used, &s_proto.module_type, 1);
+
+    case REG_COMMON_FIRMWARE_VERSION:
+    {
+        const uint8_t version[2] = {I2C_PROTO_VERSION_MAJOR, I2C_PROTO_VERSION_MINOR};
+        return respond(resp, resp_cap, resp_used, version, sizeof(version));
+    }
+
+    case REG_COMMON_STATUS:
+    {
+        // STATUS_CRC_ERROR is reported once; put it back if the read fails
+        const uint8_t status = (uint8_t)atomic_fetch_and(&s_proto.status, ~(unsigned)STATUS_CRC_ERROR);
+        esp_err_t err = respond(resp, resp_cap, resp_used, &status, 1);
+        if (err != ESP_OK)
+        {
+            atomic_fetch_or(&s_proto.status, status & STATUS_CRC_ERROR);
+        }
+        return err;
+    }
+
+    case REG_COMMON_DIRTY_BITMAP:
+        return respond_dirty_bitmap(resp, resp_cap, resp_used);
+
+    case REG_COMMON_IDENTITY:
+        return respond_identity(resp, resp_cap, resp_used);
+
+    case REG_COMMON_DIAG:
+        return respond_diag(payload[offsetof(DiagRequestPayload_t, cmd)], payload[offsetof(DiagRequestPayload_t, flags)],
+                            resp, resp_cap, resp_used);
+
+    case REG_COMMON_I2S_CONFIG:
+    {
+        i2c_proto_i2s_config_view_t view;
+        if (!i2c_proto_view_i2s_config(payload, payload_len, &view))
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        s_proto.i2s_config.tdm_slot_in = i2c_proto_i2s_config_view_slot_in(view);
+        s_proto.i2s_config.tdm_slot_out = i2c_proto_i2s_config_view_slot_out(view);
+        esp_err_t err = run_command_callback(REG_COMMON_I2S_CONFIG);
+        return err == ESP_ERR_NOT_SUPPORTED ? ESP_OK : err; // Storing the config is enough
+    }
+
+    case REG_COMMON_I2S_STAGE:
+    {
+        i2c_proto_i2s_config_view_t view; // Same payload as REG_COMMON_I2S_CONFIG
+        if (!i2c_proto_view_i2s_config(payload, payload_len, &view))
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        s_proto.i2s_staged.tdm_slot_in = i2c_proto_i2s_config_view_slot_in(view);
+        s_proto.i2s_staged.tdm_slot_out = i2c_proto_i2s_config_view_slot_out(view);
+        s_proto.i2s_staged_valid = true;
+        return ESP_OK;
+    }
+
+    case REG_COMMON_I2S_COMMIT:
+        if (payload_len != sizeof(I2sCommitPayload_t))
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        return queue_i2s_switch(i2c_proto_rd_le32(payload + offsetof(I2sCommitPayload_t, frame)));
+
+    case REG_COMMON_SET_PARAM:
+    {
+        i2c_proto_set_param_view_t view;
+        if (!i2c_proto_view_set_param(payload, payload_len, &view))
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        return apply_wire_param(i2c_proto_set_param_view_id(view), i2c_proto_set_param_view_value(view), sizeof(ParamValue_t));
+    }
+
+    case REG_COMMON_SET_PARAM_TIMED:
+    {
+        i2c_proto_set_param_timed_view_t view;
+        if (!i2c_proto_view_set_param_timed(payload, payload_len, &view))
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        const ParamDescriptor_t *desc = i2c_proto_param_find(i2c_proto_set_param_timed_view_id(view));
+        if (!desc)
+        {
+            return ESP_ERR_NOT_FOUND;
+        }
+        ParamValue_t native;
+        esp_err_t err = check_wire_param(desc, i2c_proto_set_param_timed_view_value(view), sizeof(ParamValue_t), &native);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        if (atomic_fetch_add(&s_timed_pending, 1) >= MODULE_I2C_PROTO_TIMED_LEN)
+        {
+            atomic_fetch_sub(&s_timed_pending, 1);
+            return ESP_ERR_NO_MEM; // Error: Timed backlog full; committing early would defeat the timestamp
+        }
+        // Always deferred to the audio task
+        err = queue_param(desc, &native, PENDING_TIMED, i2c_proto_set_param_timed_view_frame(view));
+        if (err != ESP_OK)
+        {
+            atomic_fetch_sub(&s_timed_pending, 1);
+        }
+        return err;
+    }
+
+    case REG_COMMON_SET_PARAM_RAMP:
+    {
+        i2c_proto_set_param_ramp_view_t view;
+        if (!i2c_proto_view_set_param_ramp(payload, payload_len, &view))
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        const ParamDescriptor_t *desc = i2c_proto_param_find(i2c_proto_set_param_ramp_view_id(view));
+        if (!desc)
+        {
+            return ESP_ERR_NOT_FOUND;
+        }
+        ParamValue_t native;
+        esp_err_t err = check_wire_param(desc, i2c_proto_set_param_ramp_view_target(view), sizeof(ParamValue_t), &native);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        // Interpolated by the audio task in module_i2c_proto_ramp_process()
+        return queue_param(desc, &native, PENDING_RAMP, i2c_proto_set_param_ramp_view_samples(view));
+    }
+
+    case REG_COMMON_SET_PARAM_BATCH:
+    case REG_COMMON_SET_PARAM_COMPACT:
+    {
+        const bool compact = msg[0] == REG_COMMON_SET_PARAM_COMPACT;
+        i2c_proto_batch_iter_t iter;
+        if (!(compact ? i2c_proto_compact_iter_init(&iter, payload, payload_len)
+                      : i2c_proto_batch_iter_init(&iter, payload, payload_len)))
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        // Apply every entry; one bad value does not drop the rest of the batch
+        esp_err_t result = ESP_OK;
+        i2c_proto_param_entry_view_t entry;
+        while (compact ? i2c_proto_compact_iter_next_view(&iter, &entry)
+                       : i2c_proto_batch_iter_next_view(&iter, &entry))
+        {
+            esp_err_t err = apply_wire_param(entry.param_id, entry.value, entry.width);
+            if (result == ESP_OK)
+            {
+                result = err;
+            }
+        }
+        return result;
+    }
+
+    case REG_COMMON_PRESET_DELTA:
+    {
+        // payload: flags, then a compact payload (count + entries) that may be empty
+        const uint8_t flags = payload[0];
+        esp_err_t result = ESP_OK;
+        i2c_proto_batch_iter_t iter;
+        if (payload[1] > 0 && i2c_proto_compact_iter_init(&iter, payload + 1, payload_len - 1))
+        {
+            i2c_proto_param_entry_view_t entry;
+            while (i2c_proto_compact_iter_next_view(&iter, &entry))
+            {
+                esp_err_t err = apply_wire_param(entry.param_id, entry.value, entry.width);
+                if (result == ESP_OK)
+                {
+                    result = err;
+                }
+            }
+        }
+        if (flags & I2C_PROTO_PRESET_LAST)
+        {
+            esp_err_t err = run_command_callback(REG_COMMON_PRESET_DELTA);
+            if (result == ESP_OK && err != ESP_ERR_NOT_SUPPORTED)
+            {
+                result = err; // Applying the values is enough without a handler
+            }
+        }
+        return result;
+    }
+
+    case REG_COMMON_GET_PARAM:
+    {
+        const ParamDescriptor_t *desc = i2c_proto_param_find(i2c_proto_rd_le16(payload));
+        if (!desc)
+        {
+            return ESP_ERR_NOT_FOUND;
+        }
+        uint8_t wire[sizeof(uint32_t)];
+        param_to_wire(desc, (const uint8_t *)&i2c_proto_param_values + desc->offset, wire);
+        return respond(resp, resp_cap, resp_used, wire, desc->width);
+    }
+
+    case REG_COMMON_GET_PARAM_RANGE:
+    {
+        i2c_proto_get_param_range_view_t view;
+        if (!i2c_proto_view_get_param_range(payload, payload_len, &view))
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        return respond_param_range(i2c_proto_get_param_range_view_first(view), i2c_proto_get_param_range_view_last(view),
+                                   resp, resp_cap, resp_used);
+    }
+
+    case REG_COMMON_GROUP_CONFIG:
+        s_proto.group_mask = payload[0];
+        return ESP_OK;
+
+    case REG_COMMON_GROUP_WRITE:
+    {
+        // i2c_proto_msg_len has checked the inner message; payload[0] is the mask
+        const uint8_t mask = payload[0];
+        if (mask != I2C_PROTO_GROUP_ALL && (mask & s_proto.group_mask) == 0)
+        {
+            return ESP_OK; // Not for this module's groups
+        }
+        return process_msg(payload + 1, payload_len - 1, NULL, 0, resp_used);
+    }
+
+    case REG_COMMON_CRC_FRAME:
+    {
+        // i2c_proto_msg_len has checked that payload[0] bytes follow the CRC
+        const uint8_t *frame = payload + 2;
+        const size_t frame_len = payload[0];
+        if (i2c_proto_crc8(i2c_proto_crc8(0, payload, 1), frame, frame_len) != payload[1])
+        {
+            atomic_fetch_or(&s_proto.status, STATUS_CRC_ERROR);
+            stats_record(REG_COMMON_CRC_FRAME, msg_len, ESP_ERR_INVALID_CRC, stats_now()); // See process_frame
+            return ESP_ERR_INVALID_CRC; // Error: Corrupted on the bus, nothing applied
+        }
+        return process_frame(frame, frame_len, resp, resp_cap, resp_used);
+    }
+
+    case CMD_COMMON_SAVE_SETTINGS:
+    case CMD_COMMON_LOAD_SETTINGS:
+        // Runs in the background; STATUS_BUSY is set until it is done
+        atomic_fetch_or(&s_settings.request, msg[0] == CMD_COMMON_SAVE_SETTINGS ? SETTINGS_SAVE : SETTINGS_LOAD);
+        atomic_fetch_or(&s_proto.status, STATUS_BUSY);
+        i2c_proto_port_worker_notify();
+        return ESP_OK;
+
+    case CMD_COMMON_RESET:
+        return run_command_callback(msg[0]);
+
+    default:
+        return ESP_ERR_NOT_SUPPORTED; // Unreachable: i2c_proto_msg_len rejects unknown commands
+    }
+}
+
+// Copy the current values into the spare block and make it the newest
+static void dispatch_publish(void)
+{
+    dispatch_block_t *block = &s_dispatch.blocks[s_dispatch.back];
+    // Read before copying: every audio-side commit counted here is already in live storage
+    block->audio_seq = atomic_load_explicit(&s_dispatch.audio_seq, memory_order_acquire);
+    for (size_t i = 0; i < I2C_PROTO_PARAM_COUNT; i++)
+    {
+        const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[i];
+        field_load(desc, (uint8_t *)&block->params + desc->offset, (const uint8_t *)&i2c_proto_param_values + desc->offset);
+    }
+    const unsigned prev = atomic_exchange_explicit(&s_dispatch.middle, s_dispatch.back | DISPATCH_FRESH, memory_order_acq_rel);
+    s_dispatch.back = (uint8_t)(prev & ~DISPATCH_FRESH);
+}
+
+// Dispatch task body: decode every committed frame, then publish once
+static void dispatch_job(void)
+{
+    for (;;)
+    {
+        size_t resp_cap = 0;
+        uint8_t *resp = s_dispatch.response_callback ? module_i2c_proto_resp_acquire(&resp_cap) : NULL;
+        size_t resp_len = resp_cap;
+        esp_err_t err = module_i2c_proto_rx_process(resp, &resp_len);
+        if (resp && err != ESP_ERR_NOT_FOUND && resp_len > 0)
+        {
+            s_dispatch.response_callback(s_dispatch.response_user_data, resp, resp_len); // Released by the application
+        }
+        else if (resp)
+        {
+            module_i2c_proto_resp_release(resp);
+        }
+        if (err == ESP_ERR_NOT_FOUND || err == ESP_ERR_INVALID_STATE)
+        {
+            break; // Arena drained
+        }
+    }
+    dispatch_publish();
+}
+
+esp_err_t module_i2c_proto_init(uint8_t module_type, uint8_t default_address)
+{
+    const module_i2c_proto_config_t config = MODULE_I2C_PROTO_CONFIG_DEFAULT(module_type, default_address);
+    return module_i2c_proto_init_with_config(&config);
+}
+
+esp_err_t module_i2c_proto_init_with_config(const module_i2c_proto_config_t *config)
+{
+    if (!config || config->default_address > 0x7F)
+    {
+        return ESP_ERR_INVALID_ARG; // Error: Missing config or not a 7-bit address
+    }
+    if (config->rx_buffer_count > MODULE_I2C_PROTO_RX_BUFFERS || config->rx_buffer_len > MODULE_I2C_PROTO_RX_BUF_LEN ||
+        (config->rx_buffer_count && config->rx_buffer_len == 0))
+    {
+        return ESP_ERR_INVALID_ARG; // Error: Receive arena larger than the static buffers
+    }
+    if (config->dispatch_core >= 0 && config->rx_buffer_count == 0)
+    {
+        return ESP_ERR_INVALID_ARG; // Error: The dispatch task decodes from the receive arena
+    }
+
+    if (config->attention_gpio >= 0)
+    {
+        esp_err_t err = i2c_proto_port_attention_init(config->attention_gpio);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+    }
+
+    esp_err_t err = i2c_proto_port_worker_start(settings_job);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    s_dispatch.enabled = false; // Not woken while the state below is reset
+    if (config->dispatch_core >= 0)
+    {
+        err = i2c_proto_port_dispatch_start(config->dispatch_core, dispatch_job);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+    }
+
+    memset(&s_proto, 0, sizeof(s_proto));
+    memset(&i2c_proto_param_values, 0, sizeof(i2c_proto_param_values));
+    s_proto.module_type = config->module_type;
+    s_proto.address = config->default_address;
+    s_proto.deferred_apply = config->deferred_apply;
+    s_proto.attention_gpio = config->attention_gpio;
+    s_proto.capabilities = (I2C_PROTO_CAPS_RUNTIME | (MODULE_I2C_PROTO_STATS ? I2C_PROTO_CAP_DIAG : 0)) & ~config->disabled_caps;
+    if (config->attention_gpio >= 0)
+    {
+        s_proto.capabilities |= I2C_PROTO_CAP_ATTENTION;
+    }
+    module_i2c_proto_stats_reset();
+    s_proto.i2s_config.tdm_slot_in = I2S_SLOT_NONE;
+    s_proto.i2s_config.tdm_slot_out = I2S_SLOT_NONE;
+    s_proto.i2s_staged_valid = false;
+    s_i2s_switch.pending = false;
+    atomic_init(&s_proto.status, STATUS_INITIALIZED);
+    for (size_t w = 0; w < I2C_PROTO_PARAM_BITMAP_WORDS; w++)
+    {
+        atomic_init(&s_proto.dirty[w], 0);
+    }
+    atomic_init(&s_settings.request, 0);
+    for (size_t w = 0; w < I2C_PROTO_PARAM_BITMAP_WORDS; w++)
+    {
+        atomic_init(&s_settings.unsaved[w], UINT32_MAX); // Storage contents unknown: the first save writes everything
+    }
+    atomic_init(&s_queue.head, 0);
+    atomic_init(&s_queue.tail, 0);
+    atomic_init(&s_load_queue.head, 0);
+    atomic_init(&s_load_queue.tail, 0);
+    atomic_init(&s_local_queue.head, 0);
+    atomic_init(&s_local_queue.tail, 0);
+    s_timed.count = 0;
+    atomic_init(&s_timed_pending, 0);
+    for (size_t i = 0; i < I2C_PROTO_PARAM_COUNT; i++)
+    {
+        s_ramps[i].active = false;
+        atomic_init(&s_ramp_refs[i], 0);
+    }
+    memset(s_proto.callback_head, CALLBACK_NONE, sizeof(s_proto.callback_head));
+    for (size_t i = 0; i < MODULE_I2C_PROTO_PARAM_CALLBACKS; i++)
+    {
+        s_callbacks.slots[i].next = (uint8_t)(i + 1 < MODULE_I2C_PROTO_PARAM_CALLBACKS ? i + 1 : CALLBACK_NONE);
+    }
+    s_callbacks.free = 0;
+    atomic_init(&s_resp_in_use, 0);
+    s_rx.count = config->rx_buffer_count;
+    s_rx.buf_len = config->rx_buffer_len;
+    atomic_init(&s_rx.head, 0);
+    atomic_init(&s_rx.tail, 0);
+    atomic_init(&s_rx.overruns, 0);
+    for (size_t i = 0; i < 3; i++)
+    {
+        s_dispatch.blocks[i].params = i2c_proto_param_values;
+        s_dispatch.blocks[i].audio_seq = 0;
+    }
+    atomic_init(&s_dispatch.audio_seq, 0);
+    memset(s_dispatch.audio_pending, 0, sizeof(s_dispatch.audio_pending));
+    s_dispatch.front = 0;
+    atomic_init(&s_dispatch.middle, 1);
+    s_dispatch.back = 2;
+    s_dispatch.enabled = config->dispatch_core >= 0;
+    s_proto.initialized = true;
+    return ESP_OK;
+}
+
+// A frame may carry several messages back to back (see i2c_proto_frame_builder_t).
+// Returns the first error; messages after a failed one are still processed.
+static esp_err_t process_frame(const uint8_t *frame, size_t frame_len, uint8_t *resp, size_t resp_cap, size_t *resp_used)
+{
+    esp_err_t result = ESP_OK;
+    size_t offset = 0;
+    while (offset < frame_len)
+    {
+        const uint32_t start = stats_now();
+        const size_t msg_len = i2c_proto_msg_len(frame + offset, frame_len - offset);
+        if (msg_len == 0)
+        {
+            stats_record(I2C_PROTO_DIAG_UNPARSED, frame_len - offset, ESP_ERR_INVALID_SIZE, start);
+            return ESP_ERR_INVALID_SIZE; // Unknown command or truncated message, drop the rest
+        }
+
+        esp_err_t err = process_msg(frame + offset, msg_len, resp, resp_cap, resp_used);
+        // A CRC envelope is counted only when it is dropped; otherwise its
+        // inner messages are, and counting both would double the traffic
+        if (frame[offset] != REG_COMMON_CRC_FRAME || !(s_proto.capabilities & I2C_PROTO_CAP_CRC))
+        {
+            stats_record(frame[offset], msg_len, err, start);
+        }
+        if (result == ESP_OK)
+        {
+            result = err;
+        }
+        offset += msg_len;
+    }
+    return result;
+}
+
+esp_err_t module_i2c_proto_process_command(const uint8_t *cmd_buffer, size_t cmd_len,
+                                          uint8_t *resp_buffer, size_t *resp_len)
+{
+    if (!cmd_buffer || cmd_len == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_proto.initialized)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const size_t resp_cap = (resp_buffer && resp_len) ? *resp_len : 0;
+    size_t resp_used = 0;
+    const esp_err_t result = process_frame(cmd_buffer, cmd_len, resp_buffer, resp_cap, &resp_used);
+
+    if (resp_len)
+    {
+        *resp_len = resp_used;
+    }
+    return result;
+}
+
+uint8_t *module_i2c_proto_rx_acquire(size_t *buf_len)
+{
+    if (s_rx.count == 0)
+    {
+        return NULL; // Error: Arena disabled
+    }
+
+    const unsigned head = atomic_load_explicit(&s_rx.head, memory_order_relaxed);
+    const unsigned tail = atomic_load_explicit(&s_rx.tail, memory_order_acquire);
+    if (head - tail >= s_rx.count)
+    {
+        atomic_fetch_add_explicit(&s_rx.overruns, 1, memory_order_relaxed);
+        return NULL; // Error: Decoder has not caught up yet
+    }
+
+    if (buf_len)
+    {
+        *buf_len = s_rx.buf_len;
+    }
+    return s_rx_buffers[head % s_rx.count];
+}
+
+esp_err_t module_i2c_proto_rx_commit(size_t len)
+{
+    const unsigned head = atomic_load_explicit(&s_rx.head, memory_order_relaxed);
+    const unsigned tail = atomic_load_explicit(&s_rx.tail, memory_order_acquire);
+    if (s_rx.count == 0 || head - tail >= s_rx.count)
+    {
+        return ESP_ERR_INVALID_STATE; // Error: No buffer acquired
+    }
+    if (len > s_rx.buf_len)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (len == 0)
+    {
+        return ESP_OK; // Nothing to decode, keep the buffer
+    }
+
+    s_rx.len[head % s_rx.count] = (uint16_t)len;
+    atomic_store_explicit(&s_rx.head, head + 1, memory_order_release);
+    dispatch_wake();
+    return ESP_OK;
+}
+
+esp_err_t module_i2c_proto_rx_process(uint8_t *resp_buffer, size_t *resp_len)
+{
+    if (s_rx.count == 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const unsigned tail = atomic_load_explicit(&s_rx.tail, memory_order_relaxed);
+    const unsigned head = atomic_load_explicit(&s_rx.head, memory_order_acquire);
+    if (tail == head)
+    {
+        if (resp_len)
+        {
+            *resp_len = 0;
+        }
+        return ESP_ERR_NOT_FOUND; // Nothing committed
+    }
+
+    // Decoded in place; the buffer only goes back to the driver afterwards
+    const size_t slot = tail % s_rx.count;
+    esp_err_t err = module_i2c_proto_process_command(s_rx_buffers[slot], s_rx.len[slot], resp_buffer, resp_len);
+    atomic_store_explicit(&s_rx.tail, tail + 1, memory_order_release);
+    return err;
+}
+
+uint32_t module_i2c_proto_rx_overruns(void)
+{
+    return atomic_load_explicit(&s_rx.overruns, memory_order_relaxed);
+}
+
+esp_err_t module_i2c_proto_stats_get(uint8_t cmd, DiagStats_t *stats)
+{
+#if MODULE_I2C_PROTO_STATS
+    if (!stats)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    stats_read(cmd, stats);
+    return ESP_OK;
+#else
+    (void)cmd;
+    (void)stats;
+    return ESP_ERR_NOT_SUPPORTED; // Error: Built without CONFIG_I2C_PROTO_STATS
+#endif
+}
+
+void module_i2c_proto_stats_reset(void)
+{
+#if MODULE_I2C_PROTO_STATS
+    for (size_t i = 0; i < STATS_SLOTS; i++)
+    {
+        stats_clear(i);
+    }
+#endif
+}
+
+// Apply a change made by the module itself. Like a write from the master it
+// goes through the audio task in deferred mode and behind a ramp, and is
+// flagged for the master once it has been applied. With a dispatch task it is
+// committed there too (commit_audio()), so the audio task's snapshot has it
+// without waiting for the next publish.
+static esp_err_t local_param(const ParamDescriptor_t *desc, const void *value)
+{
+    const size_t index = (size_t)(desc - i2c_proto_param_descriptors);
+    const bool ramping = atomic_load_explicit(&s_ramp_refs[index], memory_order_relaxed) != 0;
+    if (!s_proto.deferred_apply && !ramping && !s_dispatch.enabled)
+    {
+        commit_param(desc, value);
+        mark_dirty(desc);
+        dispatch_wake();
+        return ESP_OK;
+    }
+
+    pending_param_t *item = queue_slot(&s_local_queue);
+    if (!item)
+    {
+        return ESP_ERR_NO_MEM; // Error: Audio task is not draining fast enough
+    }
+    item->index = (uint8_t)index;
+    item->kind = PENDING_LOCAL;
+    item->frame = 0;
+    item->value.u32 = 0;
+    memcpy(&item->value, value, desc->width);
+    queue_publish(&s_local_queue);
+    return ESP_OK;
+}
+
+esp_err_t module_i2c_proto_set_param(uint8_t param_id, const void *value, size_t value_len)
+{
+    const ParamDescriptor_t *desc = i2c_proto_param_find(param_id);
+    if (!desc)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (!value || value_len != desc->width)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = check_param(desc, value);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    return local_param(desc, value);
+}
+
+esp_err_t module_i2c_proto_set_param_index(size_t index, int64_t value)
+{
+    if (index >= I2C_PROTO_PARAM_COUNT)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[index];
+    if (value < desc->min || value > desc->max)
+    {
+        return ESP_ERR_INVALID_ARG; // Error: Value out of range
+    }
+
+    const ParamValue_t native = param_from_int(desc, value);
+    return local_param(desc, &native);
+}
+
+esp_err_t module_i2c_proto_get_param(uint8_t param_id, void *value, size_t *value_len)
+{
+    const ParamDescriptor_t *desc = i2c_proto_param_find(param_id);
+    if (!desc)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (!value || !value_len)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (*value_len < desc->width)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy(value, (const uint8_t *)&i2c_proto_param_values + desc->offset, desc->width);
+    *value_len = desc->width;
+    return ESP_OK;
+}
+
+esp_err_t module_i2c_proto_register_param_callback(uint8_t param_id,
+                                                 void (*callback)(void *user_data, const void *value, size_t value_len),
+                                                 void *user_data)
+{
+    const ParamDescriptor_t *desc = i2c_proto_param_find(param_id);
+    if (!desc)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint8_t *link = &s_proto.callback_head[desc - i2c_proto_param_descriptors];
+    if (!callback)
+    {
+        // Drop every subscriber, returning the slots to the free list
+        while (*link != CALLBACK_NONE)
+        {
+            const uint8_t i = *link;
+            *link = s_callbacks.slots[i].next;
+            s_callbacks.slots[i].next = s_callbacks.free;
+            s_callbacks.free = i;
+        }
+        return ESP_OK;
+    }
+
+    for (; *link != CALLBACK_NONE; link = &s_callbacks.slots[*link].next)
+    {
+        const param_callback_t *cb = &s_callbacks.slots[*link];
+        if (cb->callback == callback && cb->user_data == user_data)
+        {
+            return ESP_OK; // Already subscribed
+        }
+    }
+
+    const uint8_t i = s_callbacks.free;
+    if (i == CALLBACK_NONE)
+    {
+        return ESP_ERR_NO_MEM; // Error: CONFIG_I2C_PROTO_PARAM_CALLBACKS exhausted
+    }
+    s_callbacks.free = s_callbacks.slots[i].next;
+
+    // Fill the slot before linking it, so a concurrent walk never sees it half set up
+    s_callbacks.slots[i].callback = callback;
+    s_callbacks.slots[i].user_data = user_data;
+    s_callbacks.slots[i].next = CALLBACK_NONE;
+    *link = i;
+    return ESP_OK;
+}
+
+esp_err_t module_i2c_proto_unregister_param_callback(uint8_t param_id, module_i2c_proto_param_cb_t callback, void *user_data)
+{
+    const ParamDescriptor_t *desc = i2c_proto_param_find(param_id);
+    if (!desc)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    for (uint8_t *link = &s_proto.callback_head[desc - i2c_proto_param_descriptors]; *link != CALLBACK_NONE;
+         link = &s_callbacks.slots[*link].next)
+    {
+        const uint8_t i = *link;
+        if (s_callbacks.slots[i].callback == callback && s_callbacks.slots[i].user_data == user_data)
+        {
+            *link = s_callbacks.slots[i].next;
+            s_callbacks.slots[i].next = s_callbacks.free;
+            s_callbacks.free = i;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+uint8_t *module_i2c_proto_resp_acquire(size_t *buf_len)
+{
+    unsigned in_use = atomic_load(&s_resp_in_use);
+    for (;;)
+    {
+        size_t i = 0;
+        while (i < MODULE_I2C_PROTO_RESP_BUFFERS && (in_use & (1U << i)))
+        {
+            i++;
+        }
+        if (i == MODULE_I2C_PROTO_RESP_BUFFERS)
+        {
+            return NULL; // Error: Pool exhausted
+        }
+        if (atomic_compare_exchange_weak(&s_resp_in_use, &in_use, in_use | (1U << i)))
+        {
+            if (buf_len)
+            {
+                *buf_len = MODULE_I2C_PROTO_RESP_BUF_LEN;
+            }
+            return s_resp_buffers[i];
+        }
+        // Lost a race with another acquire or a release; in_use was reloaded
+    }
+}
+
+esp_err_t module_i2c_proto_resp_release(uint8_t *buf)
+{
+    const uintptr_t offset = (uintptr_t)buf - (uintptr_t)s_resp_buffers;
+    if (!buf || offset >= sizeof(s_resp_buffers) || offset % MODULE_I2C_PROTO_RESP_BUF_LEN != 0)
+    {
+        return ESP_ERR_INVALID_ARG; // Error: Not a pool buffer
+    }
+
+    const unsigned bit = 1U << (offset / MODULE_I2C_PROTO_RESP_BUF_LEN);
+    if (!(atomic_fetch_and(&s_resp_in_use, ~bit) & bit))
+    {
+        return ESP_ERR_INVALID_STATE; // Error: Released twice
+    }
+    return ESP_OK;
+}
+
+esp_err_t module_i2c_proto_register_command_callback(module_i2c_proto_command_cb_t callback, void *user_data)
+{
+    s_proto.command_callback = callback;
+    s_proto.command_user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t module_i2c_proto_register_response_callback(module_i2c_proto_response_cb_t callback, void *user_data)
+{
+    s_dispatch.response_callback = callback;
+    s_dispatch.response_user_data = user_data;
+    return ESP_OK;
+}
+
+const module_i2c_proto_params_t *module_i2c_proto_params_snapshot(void)
+{
+    if (!s_dispatch.enabled)
+    {
+        return &i2c_proto_param_values;
+    }
+    if (atomic_load_explicit(&s_dispatch.middle, memory_order_relaxed) & DISPATCH_FRESH)
+    {
+        const unsigned prev = atomic_exchange_explicit(&s_dispatch.middle, s_dispatch.front, memory_order_acq_rel);
+        s_dispatch.front = (uint8_t)(prev & ~DISPATCH_FRESH);
+    }
+
+    // Bring in audio-side commits the block was copied before. Blocks are
+    // published in audio_seq order, so once one has a commit every later one does.
+    dispatch_block_t *block = &s_dispatch.blocks[s_dispatch.front];
+    for (size_t i = 0; i < I2C_PROTO_PARAM_COUNT; i++)
+    {
+        const uint32_t bit = 1U << (i % 32);
+        if (!(s_dispatch.audio_pending[i / 32] & bit))
+        {
+            continue;
+        }
+        if ((int32_t)(s_dispatch.audio_stamp[i] - block->audio_seq) <= 0)
+        {
+            s_dispatch.audio_pending[i / 32] &= ~bit; // Already in this and every later block
+            continue;
+        }
+        const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[i];
+        memcpy((uint8_t *)&block->params + desc->offset, (const uint8_t *)&s_dispatch.audio_values + desc->offset, desc->width);
+    }
+    return &block->params;
+}
+
+esp_err_t module_i2c_proto_get_i2s_config(I2sConfig_t *config)
+{
+    if (!config)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *config = s_proto.i2s_config;
+    return ESP_OK;
+}
+
+uint8_t module_i2c_proto_get_address(void)
+{
+    return s_proto.address;
+}
+
+size_t module_i2c_proto_apply_pending(void)
+{
+    return drain_queue();
+}
+
+bool module_i2c_proto_next_timed_event(uint32_t block_start, uint32_t block_frames, module_i2c_proto_timed_event_t *event)
+{
+    if (!event)
+    {
+        return false;
+    }
+
+    drain_queue();
+    if (s_timed.count == 0)
+    {
+        return false;
+    }
+
+    const pending_param_t item = s_timed.items[0];
+    const int32_t rel = (int32_t)(item.frame - block_start);
+    if (rel >= 0 && (uint32_t)rel >= block_frames)
+    {
+        return false; // Earliest change is for a later block
+    }
+
+    s_timed.count--;
+    memmove(&s_timed.items[0], &s_timed.items[1], s_timed.count * sizeof(pending_param_t));
+    atomic_fetch_sub(&s_timed_pending, 1);
+
+    const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[item.index];
+    commit_queued(&item);
+
+    event->param_id = desc->id;
+    event->offset = rel < 0 ? 0 : (uint32_t)rel; // Late changes land on the first sample
+    event->value.u32 = (uint32_t)param_value_as_int(desc, &item.value); // s32 for signed parameters, like the wire
+    return true;
+}
+
+bool module_i2c_proto_next_i2s_switch(uint32_t block_start, uint32_t block_frames, module_i2c_proto_i2s_switch_t *sw)
+{
+    if (!sw)
+    {
+        return false;
+    }
+
+    drain_queue();
+    if (!s_i2s_switch.pending)
+    {
+        return false;
+    }
+
+    const int32_t rel = (int32_t)(s_i2s_switch.frame - block_start);
+    if (rel >= 0 && (uint32_t)rel >= block_frames)
+    {
+        return false; // Due in a later block
+    }
+
+    s_i2s_switch.pending = false;
+    s_proto.i2s_config = s_i2s_switch.config;
+
+    sw->offset = rel < 0 ? 0 : (uint32_t)rel; // Late switches land on the first sample
+    sw->config = s_i2s_switch.config;
+    return true;
+}
+
+size_t module_i2c_proto_ramp_process(uint32_t frames)
+{
+    drain_queue();
+
+    size_t active = 0;
+    for (size_t i = 0; i < I2C_PROTO_PARAM_COUNT; i++)
+    {
+        param_ramp_t *ramp = &s_ramps[i];
+        if (!ramp->active)
+        {
+            continue;
+        }
+
+        const ParamDescriptor_t *desc = &i2c_proto_param_descriptors[i];
+        if (frames >= ramp->total - ramp->elapsed)
+        {
+            ramp_stop(i);
+            commit_ramp_value(desc, ramp->target); // Land exactly on the target
+            continue;
+        }
+
+        ramp->elapsed += frames;
+        // Q16 position along the ramp; both products fit in 64 bits
+        const int64_t pos = ((int64_t)ramp->elapsed << 16) / ramp->total;
+        commit_ramp_value(desc, ramp->start + (((ramp->target - ramp->start) * pos) >> 16));
+        active++;
+    }
+    return active;
+}
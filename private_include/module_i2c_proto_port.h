@@ -0,0 +1,115 @@
+#ifndef MODULE_I2C_PROTO_PORT_H
+#define MODULE_I2C_PROTO_PORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @file module_i2c_proto_port.h
+ * @brief Platform hooks used by the slave runtime
+ *
+ * module_i2c_proto_port.c implements these on ESP-IDF. Keeping them behind
+ * this header lets the protocol core build for other targets.
+ */
+
+/**
+ * @brief Configure the attention output as open-drain and release it
+ *
+ * @param gpio GPIO number
+ * @return ESP_OK on success, error code from the GPIO driver otherwise
+ */
+esp_err_t i2c_proto_port_attention_init(int gpio);
+
+/**
+ * @brief Drive the attention output
+ *
+ * Safe to call from the I2C receive path.
+ *
+ * @param gpio GPIO number passed to i2c_proto_port_attention_init()
+ * @param asserted true to pull the line low, false to release it
+ */
+void i2c_proto_port_attention_set(int gpio, bool asserted);
+
+/**
+ * @brief Store a parameter value in non-volatile storage
+ *
+ * The value is staged; it is durable only after i2c_proto_port_nvs_commit().
+ *
+ * @param param_id Parameter the value belongs to
+ * @param value Value bytes
+ * @param len Number of bytes (the parameter's width)
+ * @return ESP_OK on success, error code from the storage driver otherwise
+ */
+esp_err_t i2c_proto_port_nvs_write(uint16_t param_id, const void *value, size_t len);
+
+/**
+ * @brief Read a parameter value back from non-volatile storage
+ *
+ * @param param_id Parameter to read
+ * @param[out] value Receives len bytes
+ * @param len Expected number of bytes
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no value of that length
+ *         was saved, error code from the storage driver otherwise
+ */
+esp_err_t i2c_proto_port_nvs_read(uint16_t param_id, void *value, size_t len);
+
+/**
+ * @brief Make the values written so far durable
+ *
+ * @return ESP_OK on success, error code from the storage driver otherwise
+ */
+esp_err_t i2c_proto_port_nvs_commit(void);
+
+/**
+ * @brief Start the background worker that runs job on every notification
+ *
+ * Called once from module_i2c_proto_init_with_config(); later calls are
+ * no-ops. The worker runs at low priority so storage access never delays
+ * the I2C or audio tasks.
+ *
+ * @param job Function run by the worker, once per (coalesced) notification
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the task cannot be created
+ */
+esp_err_t i2c_proto_port_worker_start(void (*job)(void));
+
+/**
+ * @brief Wake the worker started by i2c_proto_port_worker_start()
+ *
+ * Safe to call from the I2C receive path.
+ */
+void i2c_proto_port_worker_notify(void);
+
+/**
+ * @brief Start the decode task that runs job on every notification, pinned to a core
+ *
+ * Called from module_i2c_proto_init_with_config() when dispatch_core is set;
+ * later calls are no-ops. The task runs above the worker so I2C frames are
+ * decoded promptly, away from the audio core.
+ *
+ * @param core Core to pin the task to
+ * @param job Function run by the task, once per (coalesced) notification
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for a core that does not
+ *         exist, ESP_ERR_NO_MEM if the task cannot be created
+ */
+esp_err_t i2c_proto_port_dispatch_start(int core, void (*job)(void));
+
+/**
+ * @brief Wake the task started by i2c_proto_port_dispatch_start()
+ *
+ * Safe to call from an ISR (module_i2c_proto_rx_commit()).
+ */
+void i2c_proto_port_dispatch_notify(void);
+
+/**
+ * @brief Free-running cycle counter for the protocol statistics
+ *
+ * Only differences are used, so the 32-bit wrap is harmless. Safe to call
+ * from the I2C receive path.
+ *
+ * @return CPU cycle count (nanoseconds in host builds)
+ */
+uint32_t i2c_proto_port_cycles(void);
+
+#endif /* MODULE_I2C_PROTO_PORT_H */